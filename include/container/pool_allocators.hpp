@@ -0,0 +1,72 @@
+/*
+ * poolAllocators.h
+ * Defines allocators for pointer containers which recycle their memory
+ * through thread safe pools instead of going back to the heap for every
+ * element.
+ */
+
+#ifndef POOL_ALLOCATORS_H_
+#define POOL_ALLOCATORS_H_
+
+#include <new>
+
+// Don't listen to warnings about boost on msvc
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(push, 0)
+#endif
+#include <boost/pool/pool_alloc.hpp>
+#include <boost/pool/singleton_pool.hpp>
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(pop)
+#endif
+
+namespace core { namespace container {
+
+/* Tag which separates the clone pools from other singleton pools */
+struct PooledCloneAllocatorTag {};
+
+/*
+ * A CloneAllocator for boost pointer containers (and UniquePtrList)
+ * which takes element storage from a process wide pool per element
+ * size. Freed elements go back to their pool, so a container with
+ * steady churn stops calling malloc once the pool has grown to its
+ * working size.
+ *
+ * Elements must be cloned and deallocated as the same static type,
+ * so containers using this allocator should not hold derived types.
+ */
+struct PooledCloneAllocator {
+    template<class U>
+    static U *allocate_clone(const U& r) {
+        typedef boost::singleton_pool<PooledCloneAllocatorTag, sizeof(U)> Pool;
+        void *storage = Pool::malloc();
+        if (storage == NULL) {
+            throw std::bad_alloc();
+        }
+        try {
+            return new (storage) U(r);
+        } catch (...) {
+            Pool::free(storage);
+            throw;
+        }
+    }
+
+    template<class U>
+    static void deallocate_clone(const U *r) {
+        typedef boost::singleton_pool<PooledCloneAllocatorTag, sizeof(U)> Pool;
+        if (r != NULL) {
+            r->~U();
+            Pool::free(const_cast<U *>(r));
+        }
+    }
+};
+
+/*
+ * An Allocator for the nodes of list based pointer containers which
+ * recycles nodes through a thread safe pool.
+ */
+typedef boost::fast_pool_allocator<void *> PooledNodeAllocator;
+
+}}
+
+#endif /* POOL_ALLOCATORS_H_ */
@@ -44,7 +44,9 @@ protected:
 
 public:
 
-    typedef typename ::core::pointers::detail::smartBoost<T>::UniquePtr UniquePtr;
+    // Released elements are freed through the CloneAllocator
+    typedef typename ::core::pointers::detail::smartBoost<T,
+            ::core::pointers::detail::CloneAllocatorDeleter<T, CloneAllocator> >::UniquePtr UniquePtr;
 
     UniquePtrList() {}
     explicit UniquePtrList(const Allocator& a) : PtrListType(a) {}
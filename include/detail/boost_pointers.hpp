@@ -27,6 +27,14 @@ template<typename T> struct DefaultDeleter {
     void operator()(T *p) { delete p; }
 };
 
+/*
+ * Deletes through a pointer container's clone allocator so pointers
+ * released from a container are freed the same way they were made.
+ */
+template<typename T, typename CloneAllocator> struct CloneAllocatorDeleter {
+    void operator()(T *p) { CloneAllocator::deallocate_clone(p); }
+};
+
 /*
  * This allows for remapping the names of pointers as well
  * as give unique_ptr a default deleter. C++ doesn't allow
@@ -118,9 +118,6 @@ protected:
     MessageQueue msgQueue;
     threading::ThreadTrackerPtr msgThread;
 
-    typedef threading::container::TSWrapper<bool> ConditionLockable;
-    ConditionLockable condLock;
-
     /*
      * Checks if the application is alive still.
      */
@@ -129,9 +126,9 @@ protected:
     /*
      * Performs all of the work required to process msgQueues
      * for incoming messages. Each such message is passed to
-     * processMessage for final processing. Sink workers check
-     * periodically to see if the app is still alive if no
-     * messages have arrived.
+     * processMessage for final processing. Sink workers block
+     * on the queue and check periodically to see if the app is
+     * still alive if no messages have arrived.
      */
     void sinkWorker();
     /*
@@ -155,10 +152,9 @@ public:
     virtual void flush() {}
 
     // Sinks are always defined by pushing the message into process
+    // The queue wakes the sink thread if it is waiting
     void sinkMessage(LogLevel level, const std::string& msg) {
         msgQueue.enqueue(new TimeLevelString(level, msg));
-        // Tell the sleeping thread to wake up
-        condLock.notifyOne();
     }
 
     virtual void processMessage(TimeLevelString& msg) = 0;
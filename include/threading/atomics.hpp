@@ -0,0 +1,88 @@
+/*
+ * atomics.hpp
+ * Consolidates the atomic primitives and cache helpers used by the
+ * lock-free containers and spinning locks.
+ */
+
+#ifndef CORE_ATOMICS_HPP_
+#define CORE_ATOMICS_HPP_
+
+#include <cstddef>
+
+// Don't listen to warnings about boost on msvc
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(push, 0)
+#endif
+#include <boost/atomic.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/thread/thread.hpp>
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(pop)
+#endif
+
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#   include <intrin.h>
+#endif
+
+/*
+ * The assumed size of a cache line. Objects which are written by
+ * different threads should be at least this far apart to avoid
+ * false sharing.
+ */
+#ifndef CORE_CACHE_LINE_SIZE
+#   define CORE_CACHE_LINE_SIZE 64
+#endif
+
+namespace core { namespace threading {
+
+/*
+ * Tells the processor that we are inside a spin-wait loop. This
+ * reduces power usage and the memory-order penalty paid when the
+ * loop finally exits.
+ */
+inline void cpuRelax() {
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+    _mm_pause();
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__i386__) || defined(__x86_64__))
+    __asm__ __volatile__("pause" ::: "memory");
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__arm__) || defined(__aarch64__))
+    __asm__ __volatile__("yield" ::: "memory");
+#endif
+}
+
+/*
+ * Returns a hash of the calling thread's id, mixed so that it can be
+ * taken modulo a small count to spread threads over padded slots.
+ */
+inline std::size_t threadHash() {
+    std::size_t hash = boost::hash<boost::thread::id>()(boost::this_thread::get_id());
+    // Thread ids are often aligned addresses, so mix the low bits
+    hash ^= hash >> 16;
+    hash *= 0x45d9f3b;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+/*
+ * Wraps a value such that no other object can share a cache
+ * line with it, regardless of how the wrapper itself is aligned.
+ */
+template<typename T>
+struct CacheLinePadded {
+private:
+    char leadingPad[CORE_CACHE_LINE_SIZE];
+
+public:
+    T value;
+
+private:
+    char trailingPad[CORE_CACHE_LINE_SIZE - (sizeof(T) % CORE_CACHE_LINE_SIZE)];
+
+public:
+    CacheLinePadded() : value() {}
+    explicit CacheLinePadded(const T& init) : value(init) {}
+};
+
+}}
+
+#endif /* CORE_ATOMICS_HPP_ */
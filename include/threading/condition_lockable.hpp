@@ -6,6 +6,10 @@
 #define CONDITIONLOCKABLE_H_
 
 #include "lockable.hpp"
+#include "spin_lock.hpp"
+#include "distributed_lock.hpp"
+#include "queue_lock.hpp"
+#include "atomics.hpp"
 
 // Don't listen to warnings about boost on msvc
 #if defined(_MSC_VER) && (_MSC_VER >= 1500)
@@ -60,51 +64,70 @@ public:
      * Wrappers on the condition calls with the lock component
      * written into each method. This prevents accidental mismatches
      * between what's locked and what' being conditioned on.
+     *
+     * Implementing classes may override the untemplated calls to use
+     * a faster condition variable; the rest are built on top of them.
      */
-    void notifyOne() {
+    virtual void notifyOne() {
         getConditionVariable().notify_one();
     }
-    void notifyAll() {
+    virtual void notifyAll() {
         getConditionVariable().notify_all();
     }
 
-    void wait() {
+    virtual void wait() {
         getConditionVariable().wait(*this);
     }
 
     template<typename predicate_type>
     void wait(predicate_type predicate) {
-        getConditionVariable().wait(*this, predicate);
+        while (!predicate()) {
+            wait();
+        }
     }
 
-    bool timedWait(boost::system_time const& abs_time) {
+    virtual bool timedWait(boost::system_time const& abs_time) {
         return getConditionVariable().timed_wait(*this, abs_time);
     }
 
     template<typename duration_type>
     bool timedWait(duration_type const& rel_time) {
-        return getConditionVariable().timed_wait(*this, rel_time);
+        return timedWait(boost::get_system_time() + rel_time);
     }
 
     template<typename predicate_type>
     bool timedWait(boost::system_time const& abs_time,predicate_type predicate) {
-        return getConditionVariable().timed_wait(*this, abs_time, predicate);
+        while (!predicate()) {
+            if (!timedWait(abs_time)) {
+                return predicate();
+            }
+        }
+        return true;
     }
 
     template<typename duration_type,typename predicate_type>
     bool timedWait(duration_type const& rel_time, predicate_type predicate) {
-        return getConditionVariable().timed_wait(*this, rel_time, predicate);
+        return timedWait(boost::get_system_time() + rel_time, predicate);
     }
 
     // backwards compatibility
     bool timedWait(boost::xtime const& abs_time) {
-        return getConditionVariable().timed_wait(*this, abs_time);
+        return timedWait(boost::system_time(abs_time));
     }
 
     template<typename predicate_type>
     bool timedWait(boost::xtime const& abs_time,predicate_type predicate) {
-        return getConditionVariable().timed_wait(*this, abs_time, predicate);
+        return timedWait(boost::system_time(abs_time), predicate);
     }
+
+protected:
+    /*
+     * Called by conditions which release and reacquire their lock
+     * inside a wait without going through unlock and lock, so that
+     * lock wrappers such as ProfiledLock can still follow the hold.
+     */
+    virtual void waitReleased() {}
+    virtual void waitReacquired() {}
 };
 
 /*
@@ -113,22 +136,27 @@ public:
  */
 template<typename Ref>
 class LockedConditionReferencePtr : public LockedReferencePtr<Ref> {
+private:
+    Condition *condition;
+
 public:
     typedef ConditionLock LockType;
 
     LockedConditionReferencePtr(boost::shared_ptr<Ref> reference,
-            boost::shared_ptr<LockType> lockPtr) :
-        LockedReferencePtr<Ref>(reference, lockPtr){}
+            boost::shared_ptr<LockType> lockPtr);
+
+    /*
+     * Used for any other lock which is also a Condition, such as a
+     * SpinConditionLock. The condition must outlive the reference.
+     */
+    LockedConditionReferencePtr(boost::shared_ptr<Ref> reference,
+            LockablePtr lockPtr, Condition& cond) :
+        LockedReferencePtr<Ref>(reference, lockPtr), condition(&cond) {}
 
     virtual ~LockedConditionReferencePtr() {}
 
     Condition& getCondition() {
-        /*
-         * We know this will always be a ConditionLock, because it had
-         * to be so in the constructor. Thus it's safe to static cast
-         * this to a Condition.
-         */
-        return *(boost::static_pointer_cast<LockType, Lockable>(this->getLockablePtr()));
+        return *condition;
     }
 };
 
@@ -138,22 +166,61 @@ public:
  */
 template<typename Ref>
 class LockedConditionReadableReferencePtr : public LockedReferencePtr<Ref> {
+private:
+    Condition *condition;
+
 public:
     typedef ReadWriteConditionLock LockType;
 
     LockedConditionReadableReferencePtr(boost::shared_ptr<Ref> reference,
-            boost::shared_ptr<LockType> lockPtr) :
-        LockedReferencePtr<Ref>(reference, lockPtr){}
+            boost::shared_ptr<LockType> lockPtr);
+
+    /*
+     * Used for any other read/write lock which is also a Condition,
+     * such as a ReadWriteSpinConditionLock. The condition must
+     * outlive the reference.
+     */
+    LockedConditionReadableReferencePtr(boost::shared_ptr<Ref> reference,
+            LockablePtr lockPtr, Condition& cond) :
+        LockedReferencePtr<Ref>(reference, lockPtr), condition(&cond) {}
 
     virtual ~LockedConditionReadableReferencePtr() {}
 
     Condition& getCondition() {
-        /*
-         * We know this will always be a ConditionLock, because it had
-         * to be so in the constructor. Thus it's safe to static cast
-         * this to a Condition.
-         */
-        return *(boost::static_pointer_cast<LockType, Lockable>(this->getLockablePtr()));
+        return *condition;
+    }
+};
+
+/*
+ * A ScopedLockedReference which also gives access to the condition
+ * associated with the lock, matching LockedConditionReferencePtr
+ * without any heap allocation. The condition must outlive the
+ * reference.
+ */
+template<typename Ref, typename LockType = Lockable>
+class ScopedLockedConditionReference : public ScopedLockedReference<Ref, LockType> {
+    BOOST_MOVABLE_BUT_NOT_COPYABLE(ScopedLockedConditionReference)
+
+private:
+    typedef ScopedLockedReference<Ref, LockType> Base;
+
+    Condition *condition;
+
+public:
+    ScopedLockedConditionReference(Ref& reference, LockType& lock, Condition& cond) :
+        Base(reference, lock), condition(&cond) {}
+
+    ScopedLockedConditionReference(BOOST_RV_REF(ScopedLockedConditionReference) other) :
+        Base(boost::move(static_cast<Base&>(other))), condition(other.condition) {}
+
+    ScopedLockedConditionReference& operator =(BOOST_RV_REF(ScopedLockedConditionReference) other) {
+        Base::operator =(boost::move(static_cast<Base&>(other)));
+        condition = other.condition;
+        return *this;
+    }
+
+    Condition& getCondition() const {
+        return *condition;
     }
 };
 
@@ -161,8 +228,46 @@ public:
  * Wraps a condition variable with a lock. This allows for lock ownership
  * of conditions and creates an easy way to get a locked object with quick
  * access to it's associated condition variable.
+ *
+ * Waits use a boost::condition_variable on the lock's own mutex, which
+ * avoids the internal mutex of condition_variable_any, and notifies are
+ * skipped entirely while nobody is waiting. The condition_variable_any
+ * returned by getConditionVariable is only signalled once it has been
+ * asked for, so direct users of it still get notified.
  */
 class ConditionLock : public WriteLock, public Condition {
+private:
+    typedef boost::condition_variable NativeConditionVariable;
+
+    /*
+     * Adopts the held mutex for the duration of a native wait, and
+     * leaves it held even if the wait is interrupted.
+     */
+    class NativeWait : private boost::noncopyable {
+    private:
+        ConditionLock& owner;
+
+    public:
+        boost::unique_lock<boost::mutex> held;
+
+        explicit NativeWait(ConditionLock& lock) :
+            owner(lock), held(lock.getMutex(), boost::adopt_lock) {
+            owner.waitReleased();
+            // The mutex orders this against notifiers which changed
+            // state under the lock, so relaxed is enough
+            owner.waiters.fetch_add(1, boost::memory_order_relaxed);
+        }
+        ~NativeWait() {
+            owner.waiters.fetch_sub(1, boost::memory_order_relaxed);
+            held.release();
+            owner.waitReacquired();
+        }
+    };
+
+    NativeConditionVariable nativeCondition;
+    boost::atomic<int> waiters;
+    boost::atomic<bool> conditionExposed;
+
 protected:
     ConditionVariable condition;
 
@@ -177,20 +282,55 @@ protected:
 
 public:
     /*
-     * Used to retrieve the condition variable directly.
+     * Used to retrieve the condition variable directly. From then on
+     * every notify also signals this condition variable.
      */
     ConditionVariable& getConditionVariable() {
+        conditionExposed.store(true, boost::memory_order_relaxed);
         return condition;
     }
 
     explicit ConditionLock(int priority = 0) :
-        WriteLock(priority), Condition() {}
+        WriteLock(priority), Condition(), nativeCondition(), condition() {
+        waiters.store(0, boost::memory_order_relaxed);
+        conditionExposed.store(false, boost::memory_order_relaxed);
+    }
 
     virtual ~ConditionLock() {}
 
     void lock() { WriteLock::lock(); }
     bool tryLock() { return WriteLock::tryLock(); }
     void unlock() { WriteLock::unlock(); }
+
+    using Condition::wait;
+    using Condition::timedWait;
+
+    void notifyOne() {
+        if (waiters.load(boost::memory_order_relaxed) > 0) {
+            nativeCondition.notify_one();
+        }
+        if (conditionExposed.load(boost::memory_order_relaxed)) {
+            condition.notify_one();
+        }
+    }
+    void notifyAll() {
+        if (waiters.load(boost::memory_order_relaxed) > 0) {
+            nativeCondition.notify_all();
+        }
+        if (conditionExposed.load(boost::memory_order_relaxed)) {
+            condition.notify_all();
+        }
+    }
+
+    void wait() {
+        NativeWait waiting(*this);
+        nativeCondition.wait(waiting.held);
+    }
+
+    bool timedWait(boost::system_time const& abs_time) {
+        NativeWait waiting(*this);
+        return nativeCondition.timed_wait(waiting.held, abs_time);
+    }
 };
 
 /*
@@ -200,6 +340,9 @@ public:
  * locking protocol.
  */
 class ConditionLockProxy : public LockableProxy, public Condition {
+private:
+    Condition *condition;
+
 protected:
     /*
      * Creates a locked reference for which this lockable is locked
@@ -207,7 +350,7 @@ protected:
      */
     template<typename Ref> LockedConditionReferencePtr<Ref>
     generateLockedConditionReference(boost::shared_ptr<Ref> reference) {
-        return LockedConditionReferencePtr<Ref>(reference, castLock<ConditionLock>());
+        return LockedConditionReferencePtr<Ref>(reference, getLockablePtr(), *condition);
     }
 
 public:
@@ -215,17 +358,88 @@ public:
      * Used to retrieve the condition variable directly.
      */
     ConditionVariable& getConditionVariable() {
-        return castLock<ConditionLock>()->getConditionVariable();
+        return condition->getConditionVariable();
     }
 
-    explicit ConditionLockProxy(boost::shared_ptr<ConditionLock> lReference) :
-        LockableProxy(lReference), Condition() {}
+    /*
+     * Proxies any Lockable which is also a Condition, such as a
+     * ConditionLock or SpinConditionLock.
+     */
+    template<typename LockType>
+    explicit ConditionLockProxy(boost::shared_ptr<LockType> lReference) :
+        LockableProxy(lReference), Condition(), condition(lReference.get()) {}
 
     virtual ~ConditionLockProxy() {}
 
     void lock() { LockableProxy::lock(); }
     bool tryLock() { return LockableProxy::tryLock(); }
     void unlock() { LockableProxy::unlock(); }
+
+    using Condition::wait;
+    using Condition::timedWait;
+
+    /*
+     * Forward to the proxied condition, which may not signal
+     * waiters on its condition variable directly.
+     */
+    void notifyOne() { condition->notifyOne(); }
+    void notifyAll() { condition->notifyAll(); }
+    void wait() { condition->wait(); }
+    bool timedWait(boost::system_time const& abs_time) { return condition->timedWait(abs_time); }
+};
+
+/*
+ * A ConditionLock which uses an adaptive SpinLock rather than a
+ * boost::mutex, for wrapped objects whose critical sections are only
+ * a handful of instructions long.
+ */
+class SpinConditionLock : public SpinLock, public Condition {
+protected:
+    ConditionVariable condition;
+
+public:
+    /*
+     * Used to retrieve the condition variable directly.
+     */
+    ConditionVariable& getConditionVariable() {
+        return condition;
+    }
+
+    explicit SpinConditionLock(int priority = 0) :
+        SpinLock(priority), Condition() {}
+
+    virtual ~SpinConditionLock() {}
+
+    void lock() { SpinLock::lock(); }
+    bool tryLock() { return SpinLock::tryLock(); }
+    void unlock() { SpinLock::unlock(); }
+};
+
+/*
+ * A ConditionLock which uses a fair QueueLock rather than a
+ * boost::mutex, for heavily contended wrapped objects where lock
+ * barging causes latency spikes.
+ */
+class QueueConditionLock : public QueueLock, public Condition {
+protected:
+    ConditionVariable condition;
+
+public:
+    /*
+     * Used to retrieve the condition variable directly.
+     */
+    ConditionVariable& getConditionVariable() {
+        return condition;
+    }
+
+    explicit QueueConditionLock(int priority = 0) :
+        QueueLock(priority), Condition() {}
+
+    virtual ~QueueConditionLock() {}
+
+    void lock() { QueueLock::lock(); }
+    bool tryLock() { return QueueLock::tryLock(); }
+    void unlock() { QueueLock::unlock(); }
 };
 
 /*
@@ -271,6 +485,9 @@ public:
  * without needing to implement it's locking protocol.
  */
 class ReadWriteConditionLockProxy : public ReadWriteLockableProxy, public Condition {
+private:
+    Condition *condition;
+
 protected:
     /*
      * Creates a locked reference for which this lockable is locked
@@ -278,7 +495,7 @@ protected:
      */
     template<typename Ref> LockedConditionReadableReferencePtr<Ref>
     generateLockedConditionReference(boost::shared_ptr<Ref> reference) {
-        return LockedConditionReadableReferencePtr<Ref>(reference, castLock<ReadWriteConditionLock>());
+        return LockedConditionReadableReferencePtr<Ref>(reference, getLockablePtr(), *condition);
     }
 
 public:
@@ -286,18 +503,103 @@ public:
      * Used to retrieve the condition variable directly.
      */
     ConditionVariable& getConditionVariable() {
-        return castLock<ReadWriteConditionLock>()->getConditionVariable();
+        return condition->getConditionVariable();
     }
 
-    explicit ReadWriteConditionLockProxy(boost::shared_ptr<ReadWriteConditionLock> lReference) :
-        ReadWriteLockableProxy(lReference), Condition() {}
+    /*
+     * Proxies any ReadWriteLockable which is also a Condition, such
+     * as a ReadWriteConditionLock or ReadWriteSpinConditionLock.
+     */
+    template<typename LockType>
+    explicit ReadWriteConditionLockProxy(boost::shared_ptr<LockType> lReference) :
+        ReadWriteLockableProxy(lReference), Condition(), condition(lReference.get()) {}
 
     virtual ~ReadWriteConditionLockProxy() {}
 
     void lock() { ReadWriteLockableProxy::lock(); }
     bool tryLock() { return ReadWriteLockableProxy::tryLock(); }
     void unlock() { ReadWriteLockableProxy::unlock(); }
+
+    using Condition::wait;
+    using Condition::timedWait;
+
+    /*
+     * Forward to the proxied condition, which may not signal
+     * waiters on its condition variable directly.
+     */
+    void notifyOne() { condition->notifyOne(); }
+    void notifyAll() { condition->notifyAll(); }
+    void wait() { condition->wait(); }
+    bool timedWait(boost::system_time const& abs_time) { return condition->timedWait(abs_time); }
+};
+
+/*
+ * A ReadWriteConditionLock which uses an adaptive ReadWriteSpinLock
+ * rather than a boost::shared_mutex.
+ */
+class ReadWriteSpinConditionLock : public ReadWriteSpinLock, public Condition {
+protected:
+    ConditionVariable condition;
+
+public:
+    /*
+     * Used to retrieve the condition variable directly.
+     */
+    ConditionVariable& getConditionVariable() {
+        return condition;
+    }
+
+    explicit ReadWriteSpinConditionLock(int priority = 0) :
+            ReadWriteSpinLock(priority), Condition() {}
+
+    virtual ~ReadWriteSpinConditionLock() {}
+
+    void lock() { ReadWriteSpinLock::lock(); }
+    bool tryLock() { return ReadWriteSpinLock::tryLock(); }
+    void unlock() { ReadWriteSpinLock::unlock(); }
 };
 
+/*
+ * A ReadWriteConditionLock which uses a DistributedReadWriteLock, for
+ * wrapped objects which are read from many cores at once. Writers
+ * are preferred unless told otherwise.
+ */
+class DistributedReadWriteConditionLock : public DistributedReadWriteLock, public Condition {
+protected:
+    ConditionVariable condition;
+
+public:
+    /*
+     * Used to retrieve the condition variable directly.
+     */
+    ConditionVariable& getConditionVariable() {
+        return condition;
+    }
+
+    explicit DistributedReadWriteConditionLock(int priority = 0,
+            LockPreference preference = PREFER_WRITERS) :
+        DistributedReadWriteLock(priority, preference), Condition() {}
+
+    virtual ~DistributedReadWriteConditionLock() {}
+
+    void lock() { DistributedReadWriteLock::lock(); }
+    bool tryLock() { return DistributedReadWriteLock::tryLock(); }
+    void unlock() { DistributedReadWriteLock::unlock(); }
+};
+
+/*
+ * Define the ConditionLock specific constructors after the lock types
+ * have been defined, since the pointer conversions need complete types.
+ */
+template<typename Ref>
+LockedConditionReferencePtr<Ref>::LockedConditionReferencePtr(boost::shared_ptr<Ref> reference,
+        boost::shared_ptr<LockType> lockPtr) :
+    LockedReferencePtr<Ref>(reference, lockPtr), condition(lockPtr.get()) {}
+
+template<typename Ref>
+LockedConditionReadableReferencePtr<Ref>::LockedConditionReadableReferencePtr(boost::shared_ptr<Ref> reference,
+        boost::shared_ptr<LockType> lockPtr) :
+    LockedReferencePtr<Ref>(reference, lockPtr), condition(lockPtr.get()) {}
+
 }}
 #endif /* CONDITIONLOCKABLE_H_ */
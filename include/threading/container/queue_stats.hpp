@@ -0,0 +1,163 @@
+/*
+ * queue_stats.hpp
+ * Defines the statistics policies which can be compiled into the
+ * thread safe queues.
+ */
+
+#ifndef QUEUE_STATS_H_
+#define QUEUE_STATS_H_
+
+#include <cstddef>
+#include <deque>
+#include <algorithm>
+#include "threading/atomics.hpp"
+#include "threading/latency_histogram.hpp"
+
+// Don't listen to warnings about boost on msvc
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(push, 0)
+#endif
+#include <boost/noncopyable.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/thread/thread_time.hpp>
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(pop)
+#endif
+
+namespace core { namespace threading { namespace container {
+
+/*
+ * The default queue statistics policy, which records nothing. Every
+ * hook is an empty inline call, so a queue built with it compiles to
+ * the same code as one without any statistics support.
+ *
+ * A statistics policy must provide the same members. The record
+ * calls are always made while the queue mutex is held.
+ */
+struct NoQueueStats {
+    /* Locks the queue mutex, returning it so it can be adopted */
+    template<typename Mutex>
+    Mutex& acquire(Mutex& mutex) {
+        mutex.lock();
+        return mutex;
+    }
+
+    /* Called after count elements were added, leaving depth queued */
+    void recordEnqueue(std::size_t, std::size_t) {}
+    /* Called after count elements were handed to consumers */
+    void recordDequeue(std::size_t) {}
+    /* Called after count elements were removed without a consumer */
+    void recordDiscard(std::size_t) {}
+};
+
+/*
+ * A queue statistics policy which records element counts, the
+ * high-water depth, how long contended lock acquisitions waited and
+ * how long each element sat in the queue. An uncontended acquisition
+ * costs one extra tryLock, and each element costs one clock read on
+ * enqueue and on dequeue.
+ *
+ * All readouts are relaxed atomic loads, so they never block the
+ * queue and may be slightly out of step with each other.
+ */
+class QueueStats : private boost::noncopyable {
+private:
+    boost::atomic<boost::uint64_t> enqueued;
+    boost::atomic<boost::uint64_t> dequeued;
+    boost::atomic<boost::uint64_t> discarded;
+    boost::atomic<std::size_t> highWater;
+    boost::atomic<boost::uint64_t> contended;
+    LatencyHistogram lockWaits;
+    LatencyHistogram residency;
+    // Enqueue time of each queued element (guarded by the queue mutex)
+    std::deque<boost::system_time> enqueueTimes;
+
+public:
+    QueueStats() {
+        enqueued.store(0, boost::memory_order_relaxed);
+        dequeued.store(0, boost::memory_order_relaxed);
+        discarded.store(0, boost::memory_order_relaxed);
+        highWater.store(0, boost::memory_order_relaxed);
+        contended.store(0, boost::memory_order_relaxed);
+    }
+
+    template<typename Mutex>
+    Mutex& acquire(Mutex& mutex) {
+        if (!mutex.tryLock()) {
+            const boost::system_time start = boost::get_system_time();
+            mutex.lock();
+            contended.fetch_add(1, boost::memory_order_relaxed);
+            lockWaits.record(boost::get_system_time() - start);
+        }
+        return mutex;
+    }
+
+    void recordEnqueue(std::size_t count, std::size_t depth) {
+        enqueued.fetch_add(count, boost::memory_order_relaxed);
+        if (depth > highWater.load(boost::memory_order_relaxed)) {
+            highWater.store(depth, boost::memory_order_relaxed);
+        }
+        enqueueTimes.insert(enqueueTimes.end(), count, boost::get_system_time());
+    }
+
+    /*
+     * Elements added through the queue's locked references were
+     * never timed, so residency is only recorded for as many
+     * elements as have enqueue times.
+     */
+    void recordDequeue(std::size_t count) {
+        dequeued.fetch_add(count, boost::memory_order_relaxed);
+        const boost::system_time now = boost::get_system_time();
+        const std::size_t timed = std::min(count, enqueueTimes.size());
+        for (std::size_t i = 0; i < timed; i++) {
+            residency.record(now - enqueueTimes.front());
+            enqueueTimes.pop_front();
+        }
+    }
+
+    void recordDiscard(std::size_t count) {
+        discarded.fetch_add(count, boost::memory_order_relaxed);
+        const std::size_t timed = std::min(count, enqueueTimes.size());
+        enqueueTimes.erase(enqueueTimes.begin(), enqueueTimes.begin() + timed);
+    }
+
+    /* Returns the number of elements added to the queue */
+    boost::uint64_t enqueueCount() const {
+        return enqueued.load(boost::memory_order_relaxed);
+    }
+
+    /* Returns the number of elements handed to consumers */
+    boost::uint64_t dequeueCount() const {
+        return dequeued.load(boost::memory_order_relaxed);
+    }
+
+    /* Returns the number of elements cleared or dropped from the queue */
+    boost::uint64_t discardCount() const {
+        return discarded.load(boost::memory_order_relaxed);
+    }
+
+    /* Returns the largest number of elements the queue has held */
+    std::size_t highWaterDepth() const {
+        return highWater.load(boost::memory_order_relaxed);
+    }
+
+    /* Returns the number of lock acquisitions which had to wait */
+    boost::uint64_t contendedLocks() const {
+        return contended.load(boost::memory_order_relaxed);
+    }
+
+    /* Returns how long contended lock acquisitions waited */
+    const LatencyHistogram& lockWaitTimes() const {
+        return lockWaits;
+    }
+
+    /* Returns how long dequeued elements sat in the queue */
+    const LatencyHistogram& residencyTimes() const {
+        return residency;
+    }
+};
+
+}}}
+
+#endif /* QUEUE_STATS_H_ */
@@ -0,0 +1,221 @@
+/*
+ * tschunkedvector.h
+ * This class creates a thread safe, append only vector whose elements
+ * never move, so that it can be read without any locking.
+ */
+
+#ifndef TS_CHUNKED_VECTOR_H_
+#define TS_CHUNKED_VECTOR_H_
+
+#include <cstddef>
+#include <new>
+#include "threading/atomics.hpp"
+
+// Don't listen to warnings about boost on msvc
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(push, 0)
+#endif
+#include <boost/noncopyable.hpp>
+#include <boost/static_assert.hpp>
+#include <boost/type_traits/alignment_of.hpp>
+#include <boost/type_traits/aligned_storage.hpp>
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(pop)
+#endif
+
+namespace core { namespace threading { namespace container {
+
+/*
+ * TSChunkedVector implements a boost::thread safe vector which can
+ * only grow. Elements live in chunks which double in size and are
+ * never moved or freed until the vector is destroyed, so references
+ * to elements stay valid and growth never copies anything.
+ *
+ * push_back is lock free: the writer reserves an index with one
+ * atomic increment, allocates the chunk if it is the first to reach
+ * it, and constructs the element in place. Readers index published
+ * elements without locking; an element is published once it and
+ * every element before it have been constructed, so size() always
+ * covers a gap free prefix.
+ *
+ * The vector does not synchronize changes to the elements themselves,
+ * which is why only const access is given. If T's copy constructor
+ * or a chunk allocation throws, the reserved element is never built
+ * and no later element is ever published. push_back rethrows, and
+ * the vector can still be read and destroyed safely, but it should
+ * be treated as broken.
+ */
+template <typename T, std::size_t FirstChunk = 32>
+class TSChunkedVector : private boost::noncopyable {
+private:
+    BOOST_STATIC_ASSERT(FirstChunk > 0);
+
+    struct Cell {
+        boost::atomic<bool> ready;
+        typename boost::aligned_storage<sizeof(T), boost::alignment_of<T>::value>::type storage;
+
+        Cell() {
+            ready.store(false, boost::memory_order_relaxed);
+        }
+
+        T *element() {
+            return static_cast<T *>(static_cast<void *>(&storage));
+        }
+        const T *element() const {
+            return static_cast<const T *>(static_cast<const void *>(&storage));
+        }
+    };
+
+    // Enough chunks to address every std::size_t index
+    static const std::size_t MAX_CHUNKS = sizeof(std::size_t) * 8;
+
+    boost::atomic<Cell *> chunks[MAX_CHUNKS];
+    // Indices handed out to writers
+    CacheLinePadded<boost::atomic<std::size_t> > reserved;
+    // Length of the prefix which readers may see
+    CacheLinePadded<boost::atomic<std::size_t> > published;
+
+    /*
+     * Chunk k holds FirstChunk << k elements, starting at index
+     * FirstChunk * (2^k - 1).
+     */
+    static std::size_t chunkOf(std::size_t index, std::size_t& offset) {
+        std::size_t blocks = index / FirstChunk + 1;
+        std::size_t chunk = 0;
+        while (blocks >>= 1) {
+            chunk++;
+        }
+        offset = index - FirstChunk * (((std::size_t)1 << chunk) - 1);
+        return chunk;
+    }
+
+    /* Returns the chunk, allocating it if no other writer has yet */
+    Cell *chunkFor(std::size_t chunk) {
+        Cell *cells = chunks[chunk].load(boost::memory_order_acquire);
+        if (cells != NULL) {
+            return cells;
+        }
+        Cell *allocated = new Cell[FirstChunk << chunk];
+        // Sequentially consistent to order it before our element is
+        // marked ready, for publish
+        if (chunks[chunk].compare_exchange_strong(cells, allocated, boost::memory_order_seq_cst)) {
+            return allocated;
+        }
+        // Another writer got there first
+        delete[] allocated;
+        return cells;
+    }
+
+    Cell& cellAt(std::size_t index) const {
+        std::size_t offset;
+        std::size_t chunk = chunkOf(index, offset);
+        return chunks[chunk].load(boost::memory_order_acquire)[offset];
+    }
+
+    /* Returns true if the element at index has been constructed */
+    bool isReady(std::size_t index) const {
+        std::size_t offset;
+        std::size_t chunk = chunkOf(index, offset);
+        // The writer may not have allocated the chunk yet
+        Cell *cells = chunks[chunk].load(boost::memory_order_seq_cst);
+        return cells != NULL && cells[offset].ready.load(boost::memory_order_seq_cst);
+    }
+
+    /*
+     * Moves the published length past every ready element. Each
+     * writer calls this after marking its element ready, and either
+     * it sees the elements before it ready or their writers see its
+     * element ready, so no element is left unpublished.
+     */
+    void publish() {
+        std::size_t current = published.value.load(boost::memory_order_seq_cst);
+        while (isReady(current)) {
+            if (published.value.compare_exchange_weak(current, current + 1, boost::memory_order_seq_cst)) {
+                current++;
+            }
+        }
+    }
+
+public:
+    typedef T ElemType;
+
+    TSChunkedVector() {
+        for (std::size_t i = 0; i < MAX_CHUNKS; i++) {
+            chunks[i].store(NULL, boost::memory_order_relaxed);
+        }
+        reserved.value.store(0, boost::memory_order_relaxed);
+        published.value.store(0, boost::memory_order_release);
+    }
+
+    /*
+     * Destroys every element which was built. No other thread may be
+     * using the vector by this point. Chunks and elements left out by
+     * a failed push_back are skipped.
+     */
+    ~TSChunkedVector() {
+        for (std::size_t i = 0; i < MAX_CHUNKS; i++) {
+            Cell *cells = chunks[i].load(boost::memory_order_acquire);
+            if (cells == NULL) {
+                continue;
+            }
+            for (std::size_t offset = 0; offset < (FirstChunk << i); offset++) {
+                if (cells[offset].ready.load(boost::memory_order_relaxed)) {
+                    cells[offset].element()->~T();
+                }
+            }
+            delete[] cells;
+        }
+    }
+
+    /*
+     * Appends a copy of elem and returns its index. The element may
+     * not be visible to readers until the writers of any earlier
+     * elements have finished too.
+     */
+    std::size_t push_back(const T& elem) {
+        std::size_t index = reserved.value.fetch_add(1, boost::memory_order_seq_cst);
+        std::size_t offset;
+        std::size_t chunk = chunkOf(index, offset);
+        Cell& cell = chunkFor(chunk)[offset];
+        new (cell.element()) T(elem);
+        cell.ready.store(true, boost::memory_order_seq_cst);
+        publish();
+        return index;
+    }
+
+    /*
+     * Returns the number of published elements. Every index below
+     * this may be read without locking.
+     */
+    std::size_t size() const {
+        return published.value.load(boost::memory_order_acquire);
+    }
+
+    /* Returns true if no elements have been published */
+    bool empty() const {
+        return size() == 0;
+    }
+
+    /*
+     * Returns a published element. Indexing at or past size() is
+     * undefined, as with std::vector.
+     */
+    const T& operator [](std::size_t index) const {
+        return *cellAt(index).element();
+    }
+
+    /*
+     * Copies the element at index into elem. Returns false, leaving
+     * elem alone, if the element isn't published yet.
+     */
+    bool get(std::size_t index, T& elem) const {
+        if (index >= size()) {
+            return false;
+        }
+        elem = (*this)[index];
+        return true;
+    }
+};
+
+}}}
+#endif /* TS_CHUNKED_VECTOR_H_ */
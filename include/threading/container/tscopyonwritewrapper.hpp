@@ -0,0 +1,175 @@
+/*
+ * tscopyonwritewrapper.h
+ * This class creates a copy-on-write wrapper whose readers never block.
+ */
+
+#ifndef TS_COPY_ON_WRITE_WRAPPER_H_
+#define TS_COPY_ON_WRITE_WRAPPER_H_
+
+#include "pointers.hpp"
+#include "threading/atomics.hpp"
+
+// Don't listen to warnings about boost on msvc
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(push, 0)
+#endif
+#include <boost/noncopyable.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(pop)
+#endif
+
+namespace core { namespace threading { namespace container {
+
+/*
+ * TSCopyOnWriteWrapper holds an immutable snapshot of the wrapped
+ * object behind an atomically swapped shared pointer. Readers load the
+ * current snapshot and work on it without taking any lock, so they
+ * never block each other or writers, and a snapshot stays valid for as
+ * long as the reader holds on to it.
+ *
+ * Writers serialize on a mutex, modify a private copy and publish it
+ * as the new snapshot. A Writer can make any number of changes to one
+ * copy before publishing them together, so batching writes costs a
+ * single copy. This suits read-dominated objects whose copies are
+ * cheap compared to how often they are read.
+ */
+template<typename Wrapped>
+class TSCopyOnWriteWrapper : private boost::noncopyable {
+public:
+    // For public use in identifying the underlying wrapped class
+    typedef Wrapped WrapperType;
+    typedef typename pointers::smart<const Wrapped>::SharedPtr SnapshotPtr;
+    typedef boost::uint64_t VersionType;
+
+private:
+    typedef typename pointers::smart<Wrapped>::SharedPtr WrappedPtr;
+
+    SnapshotPtr current;
+    boost::mutex writeMutex;
+    boost::atomic<VersionType> published;
+
+    /*
+     * Makes update the current snapshot. Must be called while the
+     * write mutex is held.
+     */
+    void publish(const WrappedPtr& update) {
+        boost::atomic_store(&current, SnapshotPtr(update));
+        published.fetch_add(1, boost::memory_order_release);
+    }
+
+public:
+    /*
+     * Holds the write mutex and a private copy of the wrapped object
+     * for the lifetime of the Writer. Changes made through the Writer
+     * are published as one new snapshot by calling publish. They are
+     * discarded if the Writer goes out of scope without publishing,
+     * so an exception part way through a change is never seen by
+     * readers.
+     */
+    class Writer : private boost::noncopyable {
+    private:
+        TSCopyOnWriteWrapper& owner;
+        boost::unique_lock<boost::mutex> lock;
+        WrappedPtr copy;
+
+    public:
+        explicit Writer(TSCopyOnWriteWrapper& wrapper) :
+            owner(wrapper), lock(wrapper.writeMutex),
+            copy(new Wrapped(*boost::atomic_load(&wrapper.current))) {}
+
+        ~Writer() {
+            discard();
+        }
+
+        Wrapped& operator *() const {
+            return *copy;
+        }
+
+        Wrapped *operator ->() const {
+            return copy.get();
+        }
+
+        Wrapped *get() const {
+            return copy.get();
+        }
+
+        /*
+         * Publishes the changes now and releases the write mutex.
+         * Does nothing if the changes were already published or
+         * discarded.
+         */
+        void publish() {
+            if (copy) {
+                owner.publish(copy);
+                copy.reset();
+                lock.unlock();
+            }
+        }
+
+        /* Drops the changes without publishing and releases the write mutex */
+        void discard() {
+            if (copy) {
+                copy.reset();
+                lock.unlock();
+            }
+        }
+    };
+
+    TSCopyOnWriteWrapper() : current(new Wrapped()), writeMutex() {
+        published.store(0, boost::memory_order_release);
+    }
+    explicit TSCopyOnWriteWrapper(const Wrapped& init) :
+        current(new Wrapped(init)), writeMutex() {
+        published.store(0, boost::memory_order_release);
+    }
+
+    /*
+     * Returns the current snapshot. It never changes, even if writers
+     * publish newer snapshots while it is held.
+     */
+    SnapshotPtr snapshot() const {
+        return boost::atomic_load(&current);
+    }
+
+    /* Calls functor(const Wrapped&) on the current snapshot */
+    template<typename Functor>
+    void read(Functor functor) const {
+        SnapshotPtr view(snapshot());
+        functor(*view);
+    }
+
+    /*
+     * Calls functor(Wrapped&) on a private copy of the wrapped object,
+     * then publishes the copy. Nothing is published if the functor
+     * throws.
+     */
+    template<typename Functor>
+    void write(Functor functor) {
+        Writer writer(*this);
+        functor(*writer);
+        writer.publish();
+    }
+
+    /* Publishes a copy of the update as the new snapshot */
+    void store(const Wrapped& update) {
+        boost::lock_guard<boost::mutex> lock(writeMutex);
+        publish(WrappedPtr(new Wrapped(update)));
+    }
+
+    /*
+     * Returns the number of snapshots published since construction.
+     * A reader can compare versions to tell whether its snapshot is
+     * out of date.
+     */
+    VersionType version() const {
+        return published.load(boost::memory_order_acquire);
+    }
+};
+
+}}}
+
+#endif /* TS_COPY_ON_WRITE_WRAPPER_H_ */
@@ -0,0 +1,409 @@
+/*
+ * tshashmap.h
+ * This class creates a thread safe hash map implementation which
+ * spreads its keys over several independently locked tables.
+ */
+
+#ifndef TS_HASH_MAP_H_
+#define TS_HASH_MAP_H_
+
+#include <cstddef>
+#include <vector>
+#include <utility>
+#include <functional>
+#include "threading/atomics.hpp"
+#include "threading/spin_lock.hpp"
+
+// Don't listen to warnings about boost on msvc
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(push, 0)
+#endif
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/optional.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/interprocess/sync/scoped_lock.hpp>
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(pop)
+#endif
+
+namespace core { namespace threading { namespace container {
+
+/*
+ * TSHashMap implements a boost::thread safe hash map which is split
+ * into several stripes, each an open addressing (linear probing)
+ * table with its own mutex on its own cache line. A key only ever
+ * locks the stripe it hashes to, so threads working on different
+ * stripes never contend, and lookups take the stripe lock shared.
+ *
+ * Each slot keeps its key's hash next to the entry, so probing only
+ * compares keys whose hashes match. When a stripe fills up it moves
+ * to a table twice the size incrementally: every later write to that
+ * stripe moves a few entries across, and lookups check both tables
+ * until the move is done. A resize so never locks more than one
+ * stripe, and only rehashes a whole stripe at once if the stripe
+ * fills up again before the last resize finished.
+ *
+ * Values are returned by copy, as a reference would outlive the
+ * stripe lock. Use update to change a value in place.
+ *
+ * By default there are four stripes per hardware thread.
+ */
+template <typename Key, typename Value,
+          typename Hash = boost::hash<Key>,
+          typename Pred = std::equal_to<Key>,
+          typename Mutex = SharedSpinMutex>
+class TSHashMap : private boost::noncopyable {
+public:
+    typedef Key KeyType;
+    typedef Value ValueType;
+    typedef std::pair<Key, Value> EntryType;
+
+private:
+    typedef boost::interprocess::scoped_lock<Mutex> ScopedLock;
+    typedef boost::shared_lock<Mutex> SharedScopedLock;
+
+    enum SlotState {
+        EMPTY,
+        FULL,
+        DELETED
+    };
+
+    struct Slot {
+        std::size_t hash;
+        SlotState state;
+        boost::optional<EntryType> entry;
+
+        Slot() : hash(0), state(EMPTY), entry() {}
+    };
+    typedef std::vector<Slot> Table;
+
+    // The smallest table a stripe allocates
+    static const std::size_t MIN_CAPACITY = 8;
+    // How many old slots each write moves during a resize
+    static const std::size_t MIGRATION_STEP = 8;
+
+    struct Stripe {
+        mutable Mutex mutex;
+        Table table;
+        // The table being moved out of by a resize, if any
+        Table oldTable;
+        // Next slot of oldTable to move
+        std::size_t migrated;
+        // Live entries across both tables
+        std::size_t count;
+        // FULL or DELETED slots in table
+        std::size_t used;
+
+        Stripe() : mutex(), table(), oldTable(), migrated(0), count(0), used(0) {}
+    };
+    typedef CacheLinePadded<Stripe> PaddedStripe;
+
+    const std::size_t numStripes;
+    boost::scoped_array<PaddedStripe> stripes;
+    Hash hasher;
+    Pred equals;
+
+    static std::size_t defaultStripeCount() {
+        std::size_t count = boost::thread::hardware_concurrency();
+        return count > 0 ? count * 4 : 4;
+    }
+
+    /*
+     * Splits a key's hash into its stripe and the hash used inside
+     * that stripe, so the two don't share the same low bits.
+     */
+    Stripe& stripeFor(const Key& key, std::size_t& slotHash) const {
+        std::size_t hash = hasher(key);
+        slotHash = hash / numStripes;
+        return stripes[hash % numStripes].value;
+    }
+
+    /* Returns the slot holding key, or -1 if it isn't in the table */
+    long findSlot(const Table& table, std::size_t hash, const Key& key) const {
+        if (table.empty()) {
+            return -1;
+        }
+        const std::size_t mask = table.size() - 1;
+        std::size_t index = hash & mask;
+        for (std::size_t probes = 0; probes < table.size(); probes++) {
+            const Slot& slot = table[index];
+            if (slot.state == EMPTY) {
+                return -1;
+            }
+            if (slot.state == FULL && slot.hash == hash && equals(slot.entry->first, key)) {
+                return (long)index;
+            }
+            index = (index + 1) & mask;
+        }
+        return -1;
+    }
+
+    /*
+     * Puts an entry which isn't in the table yet into the first free
+     * slot of its probe sequence, counting the slot in used. The
+     * table must have a free slot. The slot is only marked FULL once
+     * the entry is copied in, so a throwing copy leaves it free.
+     */
+    static void placeEntry(Table& table, std::size_t& used, std::size_t hash, const EntryType& entry) {
+        const std::size_t mask = table.size() - 1;
+        std::size_t index = hash & mask;
+        while (table[index].state == FULL) {
+            index = (index + 1) & mask;
+        }
+        Slot& slot = table[index];
+        slot.entry = entry;
+        slot.hash = hash;
+        if (slot.state == EMPTY) {
+            used++;
+        }
+        slot.state = FULL;
+    }
+
+    /*
+     * Moves up to limit slots out of the old table. Old slots are
+     * left as DELETED rather than EMPTY so that probes for entries
+     * further along still find them.
+     */
+    void migrate(Stripe& stripe, std::size_t limit) {
+        for (std::size_t moved = 0; moved < limit && stripe.migrated < stripe.oldTable.size(); moved++) {
+            Slot& slot = stripe.oldTable[stripe.migrated];
+            if (slot.state == FULL) {
+                placeEntry(stripe.table, stripe.used, slot.hash, *slot.entry);
+                slot.state = DELETED;
+                slot.entry = boost::none;
+            }
+            // Only move on once the entry is safely in the new table
+            stripe.migrated++;
+        }
+        if (!stripe.oldTable.empty() && stripe.migrated == stripe.oldTable.size()) {
+            Table().swap(stripe.oldTable);
+            stripe.migrated = 0;
+        }
+    }
+
+    /*
+     * Makes room for one more entry, starting a resize when the table
+     * is three quarters used. Must be called with the stripe locked.
+     */
+    void reserveSlot(Stripe& stripe) {
+        if ((stripe.used + 1) * 4 <= stripe.table.size() * 3) {
+            return;
+        }
+        std::size_t capacity = MIN_CAPACITY;
+        while (capacity < (stripe.count + 1) * 2) {
+            capacity *= 2;
+        }
+        Table next(capacity);
+        std::size_t nextUsed = 0;
+        // Only one resize runs at a time, so a resize which is still
+        // running (in a stripe full of erased slots) is finished first.
+        // Its entries are copied before the stripe changes, so a
+        // throwing copy leaves the stripe as it was.
+        for (std::size_t index = stripe.migrated; index < stripe.oldTable.size(); index++) {
+            const Slot& slot = stripe.oldTable[index];
+            if (slot.state == FULL) {
+                placeEntry(next, nextUsed, slot.hash, *slot.entry);
+            }
+        }
+        next.swap(stripe.table);
+        stripe.oldTable.swap(next);
+        stripe.used = nextUsed;
+        stripe.migrated = 0;
+        migrate(stripe, MIGRATION_STEP);
+    }
+
+    /*
+     * Finds key in either table of a stripe, returning its slot or
+     * NULL. Must be called with the stripe locked.
+     */
+    Slot *lookup(Stripe& stripe, std::size_t hash, const Key& key) const {
+        long index = findSlot(stripe.table, hash, key);
+        if (index >= 0) {
+            return &stripe.table[index];
+        }
+        index = findSlot(stripe.oldTable, hash, key);
+        if (index >= 0) {
+            return &stripe.oldTable[index];
+        }
+        return NULL;
+    }
+    const Slot *lookup(const Stripe& stripe, std::size_t hash, const Key& key) const {
+        return lookup(const_cast<Stripe&>(stripe), hash, key);
+    }
+
+    /* Adds an entry which isn't in the stripe yet */
+    void insertNew(Stripe& stripe, std::size_t hash, const Key& key, const Value& value) {
+        reserveSlot(stripe);
+        placeEntry(stripe.table, stripe.used, hash, EntryType(key, value));
+        stripe.count++;
+    }
+
+public:
+    explicit TSHashMap(std::size_t stripeCount = defaultStripeCount(),
+                       const Hash& hash = Hash(), const Pred& pred = Pred()) :
+        numStripes(stripeCount > 0 ? stripeCount : 1),
+        stripes(new PaddedStripe[stripeCount > 0 ? stripeCount : 1]),
+        hasher(hash), equals(pred) {}
+
+    /* Returns the number of independently locked stripes */
+    std::size_t stripeCount() const {
+        return numStripes;
+    }
+
+    /*
+     * Copies the value for key into value. Returns false, leaving
+     * value alone, if the key isn't in the map.
+     */
+    bool find(const Key& key, Value& value) const {
+        std::size_t hash;
+        const Stripe& stripe = stripeFor(key, hash);
+        SharedScopedLock lock(stripe.mutex);
+        const Slot *slot = lookup(stripe, hash, key);
+        if (slot == NULL) {
+            return false;
+        }
+        value = slot->entry->second;
+        return true;
+    }
+
+    /* Returns true if the key is in the map */
+    bool contains(const Key& key) const {
+        std::size_t hash;
+        const Stripe& stripe = stripeFor(key, hash);
+        SharedScopedLock lock(stripe.mutex);
+        return lookup(stripe, hash, key) != NULL;
+    }
+
+    /*
+     * Adds the key with the given value. Returns false, leaving the
+     * existing value alone, if the key was already in the map.
+     */
+    bool insert(const Key& key, const Value& value) {
+        std::size_t hash;
+        Stripe& stripe = stripeFor(key, hash);
+        ScopedLock lock(stripe.mutex);
+        migrate(stripe, MIGRATION_STEP);
+        if (lookup(stripe, hash, key) != NULL) {
+            return false;
+        }
+        insertNew(stripe, hash, key, value);
+        return true;
+    }
+
+    /*
+     * Sets the value for the key, adding it if needed. Returns true
+     * if the key was added rather than assigned.
+     */
+    bool insertOrAssign(const Key& key, const Value& value) {
+        std::size_t hash;
+        Stripe& stripe = stripeFor(key, hash);
+        ScopedLock lock(stripe.mutex);
+        migrate(stripe, MIGRATION_STEP);
+        Slot *slot = lookup(stripe, hash, key);
+        if (slot != NULL) {
+            slot->entry->second = value;
+            return false;
+        }
+        insertNew(stripe, hash, key, value);
+        return true;
+    }
+
+    /*
+     * Returns a copy of the value for key. If the key is missing,
+     * builder() is called to make its value, which is added first.
+     * The builder runs with the key's stripe locked, so it is called
+     * at most once per key but must not use this map.
+     */
+    template<typename Builder>
+    Value getOrInsert(const Key& key, Builder builder) {
+        std::size_t hash;
+        Stripe& stripe = stripeFor(key, hash);
+        {
+            // Most calls find the key, so try a shared lookup first
+            SharedScopedLock lock(stripe.mutex);
+            const Slot *slot = lookup(stripe, hash, key);
+            if (slot != NULL) {
+                return slot->entry->second;
+            }
+        }
+        ScopedLock lock(stripe.mutex);
+        migrate(stripe, MIGRATION_STEP);
+        Slot *slot = lookup(stripe, hash, key);
+        if (slot != NULL) {
+            return slot->entry->second;
+        }
+        Value value = builder();
+        insertNew(stripe, hash, key, value);
+        return value;
+    }
+
+    /*
+     * Calls updater(value) on the value for key, with the key's
+     * stripe locked. Returns false if the key isn't in the map.
+     */
+    template<typename Updater>
+    bool update(const Key& key, Updater updater) {
+        std::size_t hash;
+        Stripe& stripe = stripeFor(key, hash);
+        ScopedLock lock(stripe.mutex);
+        Slot *slot = lookup(stripe, hash, key);
+        if (slot == NULL) {
+            return false;
+        }
+        updater(slot->entry->second);
+        return true;
+    }
+
+    /* Removes the key. Returns false if it wasn't in the map. */
+    bool erase(const Key& key) {
+        std::size_t hash;
+        Stripe& stripe = stripeFor(key, hash);
+        ScopedLock lock(stripe.mutex);
+        migrate(stripe, MIGRATION_STEP);
+        Slot *slot = lookup(stripe, hash, key);
+        if (slot == NULL) {
+            return false;
+        }
+        slot->state = DELETED;
+        slot->entry = boost::none;
+        stripe.count--;
+        return true;
+    }
+
+    /*
+     * Returns the number of entries. Stripes are counted one at a
+     * time, so the result may be stale under concurrent writes.
+     */
+    std::size_t size() const {
+        std::size_t total = 0;
+        for (std::size_t i = 0; i < numStripes; i++) {
+            SharedScopedLock lock(stripes[i].value.mutex);
+            total += stripes[i].value.count;
+        }
+        return total;
+    }
+
+    /* Returns true if the map is empty */
+    bool empty() const {
+        return size() == 0;
+    }
+
+    /* Removes every entry, one stripe at a time */
+    void clear() {
+        for (std::size_t i = 0; i < numStripes; i++) {
+            Stripe& stripe = stripes[i].value;
+            ScopedLock lock(stripe.mutex);
+            Table().swap(stripe.table);
+            Table().swap(stripe.oldTable);
+            stripe.migrated = 0;
+            stripe.count = 0;
+            stripe.used = 0;
+        }
+    }
+};
+
+}}}
+#endif /* TS_HASH_MAP_H_ */
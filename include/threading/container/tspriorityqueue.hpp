@@ -0,0 +1,315 @@
+/*
+ * tspriorityqueue.h
+ * This class creates a thread safe priority queue implementation.
+ */
+
+#ifndef TS_PRIORITY_QUEUE_H_
+#define TS_PRIORITY_QUEUE_H_
+
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include "tswrapper.hpp"
+
+// Don't listen to warnings about boost on msvc
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(push, 0)
+#endif
+#include <boost/thread/thread_time.hpp>
+#include <boost/move/move.hpp>
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(pop)
+#endif
+
+namespace core { namespace threading { namespace container {
+
+/*
+ * TSPriorityQueue implements a boost::thread safe priority queue
+ * with the same locking and wait semantics as TSQueue. Elements are
+ * stored by value in a 4-ary heap laid out in a single vector, so a
+ * sift touches far fewer cache lines than a binary or node based
+ * heap would.
+ *
+ * The element which compares greatest is dequeued first (as with
+ * std::priority_queue), and elements which compare equal come out in
+ * no particular order.
+ *
+ * The heap and its Mutex are held inline by a TSStaticWrapper, so
+ * queue operations lock the mutex directly.
+ */
+template <typename T, typename Compare = std::less<T>, typename Mutex = boost::mutex>
+class TSPriorityQueue : public TSStaticWrapper<std::vector<T>, Mutex> {
+private:
+    // Class renaming for readability
+    typedef TSStaticWrapper<std::vector<T>, Mutex> Queue;
+    typedef typename Queue::ScopedLock ScopedLock;
+
+    // Number of children per heap node
+    static const std::size_t arity = 4;
+
+public:
+    typedef T ElemType;
+    typedef std::vector<T> HeapType;
+
+protected:
+    Compare compare;
+    // Number of consumers parked on the condition (guarded by the mutex)
+    std::size_t waitingConsumers;
+
+    /*
+     * Moves the element at index up the heap until its parent does
+     * not compare less. Must be called while the queue mutex is held.
+     */
+    void siftUp(std::size_t index) {
+        HeapType& heap = this->wrapped;
+        T elem(boost::move(heap[index]));
+        while (index > 0) {
+            std::size_t parent = (index - 1) / arity;
+            if (!compare(heap[parent], elem)) {
+                break;
+            }
+            heap[index] = boost::move(heap[parent]);
+            index = parent;
+        }
+        heap[index] = boost::move(elem);
+    }
+
+    /*
+     * Drops the (already moved from) top element, refilling the hole
+     * from the back of the heap. Must be called while the queue mutex
+     * is held and the queue is not empty.
+     */
+    void removeTop() {
+        HeapType& heap = this->wrapped;
+        std::size_t size = heap.size() - 1;
+        if (size > 0) {
+            T elem(boost::move(heap.back()));
+            std::size_t index = 0;
+            for (;;) {
+                std::size_t first = index * arity + 1;
+                if (first >= size) {
+                    break;
+                }
+                std::size_t last = std::min(first + arity, size);
+                std::size_t largest = first;
+                for (std::size_t child = first + 1; child < last; child++) {
+                    if (compare(heap[largest], heap[child])) {
+                        largest = child;
+                    }
+                }
+                if (!compare(elem, heap[largest])) {
+                    break;
+                }
+                heap[index] = boost::move(heap[largest]);
+                index = largest;
+            }
+            heap[index] = boost::move(elem);
+        }
+        heap.pop_back();
+    }
+
+    /*
+     * Removes the top element into deq. Must be called while the queue
+     * mutex is held and the queue is not empty.
+     */
+    void popTop(T& deq) {
+        deq = boost::move(this->wrapped.front());
+        removeTop();
+    }
+
+    /*
+     * Moves up to the N highest priority elements to the output
+     * iterator. Must be called while the queue mutex is held.
+     */
+    template<typename OutputIterator>
+    std::size_t takeTop(OutputIterator out, std::size_t numDequeue) {
+        HeapType& heap = this->wrapped;
+        std::size_t count = std::min(numDequeue, heap.size());
+        if (count == heap.size()) {
+            // Taking everything, a single sort beats repeated sifts
+            std::sort(heap.begin(), heap.end(), compare);
+            for (typename HeapType::reverse_iterator iter = heap.rbegin();
+                    iter != heap.rend(); ++iter) {
+                *out = boost::move(*iter);
+                ++out;
+            }
+            heap.clear();
+        } else {
+            // Straight from the heap, so T needn't be default constructible
+            for (std::size_t i = 0; i < count; i++) {
+                *out = boost::move(heap.front());
+                ++out;
+                removeTop();
+            }
+        }
+        return count;
+    }
+
+    /*
+     * Wakes parked consumers after numAdded elements arrived. Must be
+     * called while the queue mutex is held.
+     */
+    void notifyConsumers(std::size_t numAdded) {
+        if (waitingConsumers > 0 && numAdded > 0) {
+            if (numAdded == 1) {
+                this->condition.notify_one();
+            } else {
+                this->condition.notify_all();
+            }
+        }
+    }
+
+    /*
+     * Blocks until the queue has an element. Must be called with
+     * the queue mutex held by lock.
+     */
+    void waitForElement(ScopedLock& lock) {
+        while (this->wrapped.empty()) {
+            hidden::ParkedWaiter parked(waitingConsumers);
+            this->condition.wait(lock);
+        }
+    }
+
+    /*
+     * Blocks until the queue has an element or the deadline passes.
+     * Returns false if the queue is still empty. Must be called with
+     * the queue mutex held by lock.
+     */
+    bool waitForElement(ScopedLock& lock, const boost::system_time& deadline) {
+        while (this->wrapped.empty()) {
+            hidden::ParkedWaiter parked(waitingConsumers);
+            if (!this->condition.timed_wait(lock, deadline)) {
+                return !this->wrapped.empty();
+            }
+        }
+        return true;
+    }
+
+public:
+    explicit TSPriorityQueue(int priority = 0) :
+        Queue(priority), compare(), waitingConsumers(0) {}
+    explicit TSPriorityQueue(const Compare& comp, int priority = 0) :
+        Queue(priority), compare(comp), waitingConsumers(0) {}
+
+    /* Returns true if the queue is empty */
+    bool empty() {
+        ScopedLock lock(this->getMutex());
+        return this->wrapped.empty();
+    }
+
+    /* Returns the size of the queue */
+    std::size_t size() {
+        ScopedLock lock(this->getMutex());
+        return this->wrapped.size();
+    }
+
+    /* Reserves heap storage so enqueues up to count never reallocate */
+    void reserve(std::size_t count) {
+        ScopedLock lock(this->getMutex());
+        this->wrapped.reserve(count);
+    }
+
+    /* Clears all queue elements from the queue */
+    void clear() {
+        ScopedLock lock(this->getMutex());
+        this->wrapped.clear();
+    }
+
+    /* Enqueues a copy of the element into the queue */
+    void enqueue(const T& enq) {
+        ScopedLock lock(this->getMutex());
+        this->wrapped.push_back(enq);
+        siftUp(this->wrapped.size() - 1);
+        notifyConsumers(1);
+    }
+
+    /*
+     * Enqueues copies of every element in the input range under a
+     * single lock acquisition.
+     */
+    template<typename InputIterator>
+    void enqueueN(InputIterator first, InputIterator last) {
+        ScopedLock lock(this->getMutex());
+        std::size_t oldSize = this->wrapped.size();
+        for (; first != last; ++first) {
+            this->wrapped.push_back(*first);
+            siftUp(this->wrapped.size() - 1);
+        }
+        notifyConsumers(this->wrapped.size() - oldSize);
+    }
+
+    /*
+     * Dequeues the highest priority element into deq. Returns false
+     * without blocking if the queue is empty.
+     */
+    bool dequeue(T& deq) {
+        ScopedLock lock(this->getMutex());
+        if (this->wrapped.empty()) {
+            return false;
+        }
+        popTop(deq);
+        return true;
+    }
+
+    /*
+     * Dequeues the highest priority element into deq, blocking until
+     * one is available.
+     */
+    void dequeueWait(T& deq) {
+        ScopedLock lock(this->getMutex());
+        waitForElement(lock);
+        popTop(deq);
+    }
+
+    /*
+     * Dequeues the highest priority element into deq, blocking for
+     * up to the given duration. Returns false if the queue stayed
+     * empty.
+     */
+    template<typename DurationType>
+    bool dequeueWaitFor(T& deq, const DurationType& duration) {
+        const boost::system_time deadline = boost::get_system_time() + duration;
+        ScopedLock lock(this->getMutex());
+        if (!waitForElement(lock, deadline)) {
+            return false;
+        }
+        popTop(deq);
+        return true;
+    }
+
+    /*
+     * Dequeues up to the N highest priority elements under a single
+     * lock acquisition, writing them to the output iterator from the
+     * highest priority down. Returns the number dequeued.
+     */
+    template<typename OutputIterator>
+    std::size_t dequeueN(OutputIterator out, std::size_t numDequeue) {
+        ScopedLock lock(this->getMutex());
+        return takeTop(out, numDequeue);
+    }
+
+    /*
+     * Dequeues every element under a single lock acquisition, writing
+     * them to the output iterator from the highest priority down.
+     * Returns the number dequeued.
+     */
+    template<typename OutputIterator>
+    std::size_t dequeueAll(OutputIterator out) {
+        return dequeueN(out, (std::size_t)-1);
+    }
+
+    /*
+     * Blocks until the queue has an element, then dequeues up to the
+     * N highest priority elements as dequeueN does.
+     */
+    template<typename OutputIterator>
+    std::size_t dequeueNWait(OutputIterator out, std::size_t numDequeue) {
+        ScopedLock lock(this->getMutex());
+        waitForElement(lock);
+        return takeTop(out, numDequeue);
+    }
+};
+
+}}}
+
+#endif /* TS_PRIORITY_QUEUE_H_ */
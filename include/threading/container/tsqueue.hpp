@@ -6,33 +6,379 @@
 #ifndef TS_QUEUE_H_
 #define TS_QUEUE_H_
 
+#include <algorithm>
+#include <iterator>
 #include "tswrapper.hpp"
 #include "pointers.hpp"
+#include "exceptions.hpp"
+#include "container/pool_allocators.hpp"
+#include "queue_stats.hpp"
+
+// Don't listen to warnings about boost on msvc
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(push, 0)
+#endif
+#include <boost/thread/thread_time.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/static_assert.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/type_traits/is_same.hpp>
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(pop)
+#endif
 
 namespace core { namespace threading { namespace container {
 
+/*
+ * Selects how a bounded TSQueue handles an enqueue when it is full.
+ */
+enum OverflowPolicy {
+    // Wait for a consumer to make room
+    OVERFLOW_BLOCK,
+    // Wait up to the block timeout for room, then refuse the element
+    OVERFLOW_BLOCK_TIMEOUT,
+    // Discard the element being enqueued
+    OVERFLOW_DROP_NEWEST,
+    // Discard the element at the front of the queue to make room
+    OVERFLOW_DROP_OLDEST,
+    // Refuse the element
+    OVERFLOW_REJECT
+};
+
+/*
+ * Counts how often each overflow policy fired on a bounded TSQueue.
+ */
+struct OverflowCounters {
+    // Enqueues which had to wait for room (either blocking policy)
+    boost::uint64_t blocked;
+    // Blocking enqueues which gave up after the block timeout
+    boost::uint64_t timedOut;
+    // Elements discarded by OVERFLOW_DROP_NEWEST
+    boost::uint64_t droppedNewest;
+    // Elements discarded by OVERFLOW_DROP_OLDEST
+    boost::uint64_t droppedOldest;
+    // Elements refused by OVERFLOW_REJECT
+    boost::uint64_t rejected;
+
+    OverflowCounters() : blocked(0), timedOut(0), droppedNewest(0),
+                         droppedOldest(0), rejected(0) {}
+};
+
 /*
  * TSQueue implements a boost::thread safe version of a basic queue. 
  * The implementation uses linked lists to create an easy use queue.
+ *
+ * Element storage comes from the CloneAllocator and list nodes from
+ * the Allocator, so passing pooled allocators (see pooled<T>::Queue)
+ * lets a steady state queue run without touching the heap. Raw and
+ * auto pointers from new can only be enqueued onto heap allocated
+ * queues.
+ *
+ * Queues are unbounded by default. A bounded queue holds at most
+ * maxSize elements and applies its OverflowPolicy when full, in
+ * which case enqueue calls return false if the element was refused.
+ * The queue always takes ownership of pointers given to enqueue, so
+ * refused or dropped pointers are freed by the queue. Elements which
+ * batch calls could not add stay in the caller's list.
+ *
+ * The Stats policy decides what the queue records about itself (see
+ * queue_stats.hpp). The default NoQueueStats records nothing and adds
+ * no overhead, while QueueStats (see instrumented<T>::Queue) tracks
+ * counts, depth, lock waits and element residency.
  */
 template <typename T,
           typename CloneAllocator = boost::heap_clone_allocator,
-          typename Allocator = std::allocator<void*> >
+          typename Allocator = std::allocator<void*>,
+          typename Stats = NoQueueStats>
 class TSQueue : public TSWrapper<typename pointers::lists<T, CloneAllocator, Allocator>::UniquePtrList> {
 private:
     // Class renaming for readability
     typedef TSWrapper<typename pointers::lists<T, CloneAllocator, Allocator>::UniquePtrList> Queue;
-    typedef typename Queue::ScopedLock ScopedLock;
+    typedef typename Queue::ScopedLock BaseScopedLock;
 
-protected:
-    CloneAllocator cloner;
+    /*
+     * Scope locks the queue through the Stats policy, so the policy
+     * can time how long the acquisition waited.
+     */
+    class ScopedLock : public BaseScopedLock {
+    public:
+        ScopedLock(typename Queue::LockType& mutex, Stats& stats) :
+            BaseScopedLock(stats.acquire(mutex), boost::interprocess::accept_ownership) {}
+    };
 
 public:
     typedef T ElemType;
-    typedef typename pointers::smart<T>::UniquePtr PtrType;
+    typedef Stats StatsType;
     typedef typename pointers::lists<T, CloneAllocator, Allocator>::UniquePtrList QList;
+    // Frees through the CloneAllocator, so pooled elements return to their pool
+    typedef typename QList::UniquePtr PtrType;
     typedef typename pointers::smart<QList>::SharedPtr QListPtr;
-    explicit TSQueue(int priority = 0) : Queue(priority), cloner() {}
+
+protected:
+    CloneAllocator cloner;
+    // Number of consumers parked on the condition (guarded by the mutex)
+    std::size_t waitingConsumers;
+    // The last list handed out by a dequeue, kept for reuse once the
+    // consumer releases it (guarded by the mutex)
+    QListPtr recycledQueue;
+    // An emptied list ready to become the queue's storage, only
+    // accessed through the shared_ptr atomic functions
+    QListPtr spareQueue;
+
+    // Bounding configuration, maxSize of 0 is unbounded
+    const std::size_t maxSize;
+    const OverflowPolicy overflowPolicy;
+    const boost::posix_time::time_duration blockTimeout;
+    // Producers parked waiting for room (guarded by the mutex)
+    std::size_t waitingProducers;
+    boost::condition_variable_any roomAvailable;
+    OverflowCounters overflowCounters;
+    Stats stats;
+
+    /*
+     * Clears a released list and keeps it as the spare when it goes
+     * out of scope. Declared before the queue lock is taken, so the
+     * elements the consumer left in the list are destroyed after the
+     * lock is released.
+     */
+    class Recycler : private boost::noncopyable {
+    private:
+        QListPtr& spare;
+    public:
+        QListPtr reclaimed;
+
+        explicit Recycler(QListPtr& spareQueue) : spare(spareQueue), reclaimed() {}
+        ~Recycler() {
+            if (reclaimed) {
+                reclaimed->clear();
+                boost::atomic_store(&spare, reclaimed);
+            }
+        }
+    };
+
+    /* The possible outcomes of asking a bounded queue for room */
+    enum Admission {
+        ADMITTED,
+        DROPPED,
+        REFUSED
+    };
+
+    /*
+     * Wakes a parked consumer, if there is one. Must be called
+     * while the queue mutex is held so a consumer which is about
+     * to park cannot miss the notification.
+     */
+    void notifyConsumer() {
+        if (waitingConsumers > 0) {
+            this->getCondition().notifyOne();
+        }
+    }
+
+    /*
+     * Wakes as many parked consumers as there are new elements
+     * with a single notification. Must be called while the queue
+     * mutex is held.
+     */
+    void notifyConsumers(std::size_t numAdded) {
+        if (numAdded == 1) {
+            notifyConsumer();
+        } else if (numAdded > 1 && waitingConsumers > 0) {
+            this->getCondition().notifyAll();
+        }
+    }
+
+    /*
+     * Wakes parked producers after elements were removed. Must be
+     * called while the queue mutex is held.
+     */
+    void notifyProducers(std::size_t numRemoved) {
+        if (waitingProducers > 0 && numRemoved > 0) {
+            if (numRemoved == 1) {
+                roomAvailable.notify_one();
+            } else {
+                roomAvailable.notify_all();
+            }
+        }
+    }
+
+    /*
+     * Makes room for one more element according to the overflow
+     * policy. Returns whether the element should be added, silently
+     * dropped or refused. Must be called while the queue mutex is
+     * held, which blocking policies release while waiting.
+     */
+    Admission admitElement() {
+        if (maxSize == 0 || this->wrapped->size() < maxSize) {
+            return ADMITTED;
+        }
+        switch (overflowPolicy) {
+        case OVERFLOW_BLOCK:
+            overflowCounters.blocked++;
+            while (this->wrapped->size() >= maxSize) {
+                hidden::ParkedWaiter parked(waitingProducers);
+                roomAvailable.wait(this->getMutex());
+            }
+            return ADMITTED;
+        case OVERFLOW_BLOCK_TIMEOUT: {
+            overflowCounters.blocked++;
+            const boost::system_time deadline = boost::get_system_time() + blockTimeout;
+            while (this->wrapped->size() >= maxSize) {
+                hidden::ParkedWaiter parked(waitingProducers);
+                if (!roomAvailable.timed_wait(this->getMutex(), deadline) &&
+                        this->wrapped->size() >= maxSize) {
+                    overflowCounters.timedOut++;
+                    return REFUSED;
+                }
+            }
+            return ADMITTED;
+        }
+        case OVERFLOW_DROP_NEWEST:
+            overflowCounters.droppedNewest++;
+            return DROPPED;
+        case OVERFLOW_DROP_OLDEST:
+            overflowCounters.droppedOldest++;
+            this->wrapped->pop_front();
+            stats.recordDiscard(1);
+            return ADMITTED;
+        case OVERFLOW_REJECT:
+        default:
+            overflowCounters.rejected++;
+            return REFUSED;
+        }
+    }
+
+    /*
+     * Moves elements from the front of the list onto the back of the
+     * queue, applying the overflow policy to each. Returns false if
+     * an element was refused, in which case it and any remaining
+     * elements are left in the list. Must be called while the queue
+     * mutex is held.
+     */
+    bool transferBounded(QList& enq) {
+        while (!enq.empty()) {
+            Admission admit = admitElement();
+            if (admit == REFUSED) {
+                return false;
+            } else if (admit == DROPPED) {
+                enq.pop_front();
+            } else {
+                this->wrapped->transfer(this->wrapped->end(), enq.begin(), enq);
+                stats.recordEnqueue(1, this->wrapped->size());
+                notifyConsumer();
+            }
+        }
+        return true;
+    }
+
+    /*
+     * Pops the front element. Must be called while the queue mutex
+     * is held and the queue is not empty, so woken producers cannot
+     * observe the queue before the element is gone.
+     */
+    PtrType popFront() {
+        notifyProducers(1);
+        stats.recordDequeue(1);
+        return this->wrapped->pop_front();
+    }
+
+    /*
+     * Blocks until the queue has an element. Must be called while
+     * the queue mutex is held.
+     */
+    void waitForElement() {
+        while (this->wrapped->empty()) {
+            hidden::ParkedWaiter parked(waitingConsumers);
+            this->getCondition().wait();
+        }
+    }
+
+    /*
+     * Blocks until the queue has an element or the deadline passes.
+     * Returns false if the queue is still empty. Must be called while
+     * the queue mutex is held.
+     */
+    bool waitForElement(const boost::system_time& deadline) {
+        while (this->wrapped->empty()) {
+            hidden::ParkedWaiter parked(waitingConsumers);
+            if (!this->getCondition().timedWait(deadline)) {
+                return !this->wrapped->empty();
+            }
+        }
+        return true;
+    }
+
+    /*
+     * Returns an empty list, reusing the spare list if there is one.
+     * Must be called while the queue mutex is held.
+     */
+    QListPtr emptyQueue() {
+        QListPtr queue = boost::atomic_exchange(&spareQueue, QListPtr());
+        if (!queue) {
+            queue = QListPtr(new QList());
+        }
+        return queue;
+    }
+
+    /*
+     * Marks a list as handed out to a consumer, so it can be reused
+     * after the consumer releases it. If the consumer of the previous
+     * list has released it, the recycler clears it once the lock is
+     * dropped. Must be called while the queue mutex is held.
+     */
+    QListPtr handOut(QListPtr queue, Recycler& recycler) {
+        if (recycledQueue && recycledQueue.unique()) {
+            // Only we reference it, so no one else can be using it
+            recycler.reclaimed.swap(recycledQueue);
+        }
+        recycledQueue = queue;
+        return queue;
+    }
+
+    /*
+     * Swaps out the entire wrapped list for an empty one. Must be
+     * called while the queue mutex is held.
+     */
+    QListPtr swapOutQueue(Recycler& recycler) {
+        QListPtr oldQueue = this->wrapped;
+        this->wrapped = emptyQueue();
+        notifyProducers(oldQueue->size());
+        stats.recordDequeue(oldQueue->size());
+        return handOut(oldQueue, recycler);
+    }
+
+public:
+    /* Creates an unbounded queue */
+    explicit TSQueue(int priority = 0) :
+        Queue(priority), cloner(), waitingConsumers(0), recycledQueue(), spareQueue(),
+        maxSize(0), overflowPolicy(OVERFLOW_BLOCK), blockTimeout(),
+        waitingProducers(0), roomAvailable(), overflowCounters(), stats() {}
+
+    /*
+     * Creates a queue holding at most maxSize elements (0 is unbounded).
+     * OVERFLOW_BLOCK_TIMEOUT needs a timeout, so it can only be chosen
+     * through the timeout constructor and throws a ParameterException
+     * here.
+     */
+    TSQueue(std::size_t maxSize, OverflowPolicy policy, int priority = 0) :
+        Queue(priority), cloner(), waitingConsumers(0), recycledQueue(), spareQueue(),
+        maxSize(maxSize), overflowPolicy(policy), blockTimeout(),
+        waitingProducers(0), roomAvailable(), overflowCounters(), stats() {
+        if (policy == OVERFLOW_BLOCK_TIMEOUT) {
+            throwParameterException("OVERFLOW_BLOCK_TIMEOUT requires a block timeout");
+        }
+    }
+
+    /*
+     * Creates a queue holding at most maxSize elements (0 is unbounded)
+     * whose producers block for up to timeout when it is full.
+     */
+    TSQueue(std::size_t maxSize, const boost::posix_time::time_duration& timeout,
+            int priority = 0) :
+        Queue(priority), cloner(), waitingConsumers(0), recycledQueue(), spareQueue(),
+        maxSize(maxSize), overflowPolicy(OVERFLOW_BLOCK_TIMEOUT), blockTimeout(timeout),
+        waitingProducers(0), roomAvailable(), overflowCounters(), stats() {}
 
     /*
      * Ensure that all memory is deallocated and the appropiate
@@ -44,56 +390,199 @@ public:
 
     /* Returns true if the queue is empty */
     bool empty() {
-        ScopedLock lock(this->getMutex());
+        ScopedLock lock(this->getMutex(), stats);
         return this->wrapped->empty();
     }
 
     /* Returns the size of the queue */
     std::size_t size() {
-        ScopedLock lock(this->getMutex());
+        ScopedLock lock(this->getMutex(), stats);
         return this->wrapped->size();
     }
 
+    /* Returns the maximum size of the queue (0 if unbounded) */
+    std::size_t getMaxSize() const {
+        return maxSize;
+    }
+
+    /* Returns how the queue handles enqueues when full */
+    OverflowPolicy getOverflowPolicy() const {
+        return overflowPolicy;
+    }
+
+    /*
+     * Returns the statistics recorded by the Stats policy. Reading
+     * them does not lock the queue.
+     */
+    const Stats& getStats() const {
+        return stats;
+    }
+
+    /* Returns a snapshot of how often the overflow policy fired */
+    OverflowCounters getOverflowCounters() {
+        ScopedLock lock(this->getMutex(), stats);
+        return overflowCounters;
+    }
+
     /* Clears all queue elements from the queue */
     void clear() {
-        ScopedLock lock(this->getMutex());
+        ScopedLock lock(this->getMutex(), stats);
+        std::size_t numRemoved = this->wrapped->size();
         this->wrapped->clear();
+        stats.recordDiscard(numRemoved);
+        notifyProducers(numRemoved);
     }
 
     /*
      * Enqueues a new element into the queue. This element can
      * be pulled back out of the queue by dequeuing all of the
      * elements off the front of the queue.
+     *
+     * Returns false if a bounded queue refused the element.
      */
     template<typename U>
-    void enqueue(const U& enq) {
-        ScopedLock lock(this->getMutex());
-        this->wrapped->push_back(cloner.allocate_clone(enq));
+    bool enqueue(const U& enq) {
+        ScopedLock lock(this->getMutex(), stats);
+        Admission admit = admitElement();
+        if (admit == ADMITTED) {
+            this->wrapped->push_back(cloner.allocate_clone(enq));
+            stats.recordEnqueue(1, this->wrapped->size());
+            notifyConsumer();
+        }
+        return admit != REFUSED;
+    }
+
+    /*
+     * Takes ownership of a pointer from new. Only heap allocated
+     * queues accept these, since other clone allocators can't free
+     * them. Pooled queues must enqueue copies or PtrTypes instead.
+     */
+    bool enqueue(T *const enq) {
+        BOOST_STATIC_ASSERT((boost::is_same<CloneAllocator, boost::heap_clone_allocator>::value));
+        ScopedLock lock(this->getMutex(), stats);
+        Admission admit = admitElement();
+        if (admit == ADMITTED) {
+            this->wrapped->push_back(enq);
+            stats.recordEnqueue(1, this->wrapped->size());
+            notifyConsumer();
+        } else {
+            cloner.deallocate_clone(enq);
+        }
+        return admit != REFUSED;
+    }
+
+    /*
+     * Takes ownership of an element freed through the CloneAllocator,
+     * such as one dequeued from a queue of the same type.
+     */
+    bool enqueue(const PtrType enq) {
+        ScopedLock lock(this->getMutex(), stats);
+        Admission admit = admitElement();
+        if (admit == ADMITTED) {
+            this->wrapped->push_back(enq);
+            stats.recordEnqueue(1, this->wrapped->size());
+            notifyConsumer();
+        }
+        return admit != REFUSED;
+    }
+
+    /* As enqueue(T *), only accepted by heap allocated queues */
+    bool enqueue(const typename pointers::smart<T>::AutoPtr enq) {
+        BOOST_STATIC_ASSERT((boost::is_same<CloneAllocator, boost::heap_clone_allocator>::value));
+        ScopedLock lock(this->getMutex(), stats);
+        Admission admit = admitElement();
+        if (admit == ADMITTED) {
+            this->wrapped->push_back(enq);
+            stats.recordEnqueue(1, this->wrapped->size());
+            notifyConsumer();
+        }
+        return admit != REFUSED;
     }
 
-    void enqueue(T *const enq) {
-        ScopedLock lock(this->getMutex());
-        this->wrapped->push_back(enq);
+    /*
+     * Enqueues copies of every element in the input range under a
+     * single lock acquisition. The copies are made before the lock
+     * is taken, so the lock is only held to splice them in.
+     *
+     * Returns false if a bounded queue refused some of the elements.
+     */
+    template<typename InputIterator>
+    bool enqueueN(InputIterator first, InputIterator last) {
+        QList batch;
+        for (; first != last; ++first) {
+            batch.push_back(cloner.allocate_clone(*first));
+        }
+        return splice(batch);
     }
 
-    void enqueue(const PtrType enq) {
-        ScopedLock lock(this->getMutex());
-        this->wrapped->push_back(enq);
+    /*
+     * Moves every element of the list into the queue in O(1) under
+     * a single lock acquisition. The list is left empty unless a
+     * bounded queue refused some of the elements, in which case
+     * false is returned.
+     */
+    bool enqueueAll(QListPtr enq) {
+        if (enq) {
+            return splice(*enq);
+        }
+        return true;
     }
 
-    void enqueue(const typename pointers::smart<T>::AutoPtr enq) {
-        ScopedLock lock(this->getMutex());
-        this->wrapped->push_back(enq);
+    /*
+     * Splices every element of a caller owned list onto the back
+     * of the queue in O(1) under a single lock acquisition. The
+     * list is left empty unless a bounded queue refused some of
+     * the elements, in which case false is returned.
+     */
+    bool splice(QList& enq) {
+        if (enq.empty()) {
+            return true;
+        }
+        std::size_t numAdded = enq.size();
+        ScopedLock lock(this->getMutex(), stats);
+        if (maxSize != 0 && this->wrapped->size() + numAdded > maxSize) {
+            // Not enough room for the whole batch
+            return transferBounded(enq);
+        }
+        this->wrapped->transfer(this->wrapped->end(), enq);
+        stats.recordEnqueue(numAdded, this->wrapped->size());
+        notifyConsumers(numAdded);
+        return true;
     }
 
     /*
      * Dequeues an element off of the front of the queue.
      */
     PtrType dequeue() {
-        ScopedLock lock(this->getMutex());
+        ScopedLock lock(this->getMutex(), stats);
         // can't dequeue from an empty queue
         if (!this->wrapped->empty()) {
-            return this->wrapped->pop_front();
+            return popFront();
+        }
+        return PtrType();
+    }
+
+    /*
+     * Dequeues an element off of the front of the queue, blocking
+     * until one is available.
+     */
+    PtrType dequeueWait() {
+        ScopedLock lock(this->getMutex(), stats);
+        waitForElement();
+        return popFront();
+    }
+
+    /*
+     * Dequeues an element off of the front of the queue, blocking
+     * for up to the relative timeout for one to become available.
+     * Returns an empty pointer if the timeout expires first.
+     */
+    template<typename duration_type>
+    PtrType dequeueWaitFor(const duration_type& timeout) {
+        const boost::system_time deadline = boost::get_system_time() + timeout;
+        ScopedLock lock(this->getMutex(), stats);
+        if (waitForElement(deadline)) {
+            return popFront();
         }
         return PtrType();
     }
@@ -105,20 +594,24 @@ public:
     QListPtr dequeueN(std::size_t numDequeue) {
         QListPtr deq;
 
-        ScopedLock lock(this->getMutex());
+        Recycler recycler(spareQueue);
+        ScopedLock lock(this->getMutex(), stats);
         numDequeue = std::min(numDequeue, this->wrapped->size());
         // Taking all elements?
         if (numDequeue == this->wrapped->size()) {
             // Just give our whole QListPtr
-            deq = this->wrapped;
-            this->wrapped = QListPtr(new QList());
+            deq = swapOutQueue(recycler);
         }
         // Taking some of our elements
         else {
-            deq = QListPtr(new QList());
-            for (std::size_t i = 0; i < numDequeue; i++) {
-                deq->push_back(this->wrapped->pop_front());
-            }
+            deq = emptyQueue();
+            typename QList::iterator last = this->wrapped->begin();
+            std::advance(last, numDequeue);
+            // Splice the nodes across rather than reallocating them
+            deq->transfer(deq->end(), this->wrapped->begin(), last, *this->wrapped);
+            notifyProducers(numDequeue);
+            stats.recordDequeue(numDequeue);
+            handOut(deq, recycler);
         }
         return deq;
     }
@@ -129,12 +622,58 @@ public:
      * locking overhead.
      */
     QListPtr dequeueAll() {
-        ScopedLock lock(this->getMutex());
-        QListPtr oldQueue = this->wrapped;
-        this->wrapped = QListPtr(new QList());
-        return oldQueue;
+        Recycler recycler(spareQueue);
+        ScopedLock lock(this->getMutex(), stats);
+        return swapOutQueue(recycler);
+    }
+
+    /*
+     * Dequeues all items from the queue at once, blocking until
+     * at least one item is available.
+     */
+    QListPtr dequeueAllWait() {
+        Recycler recycler(spareQueue);
+        ScopedLock lock(this->getMutex(), stats);
+        waitForElement();
+        return swapOutQueue(recycler);
+    }
+
+    /*
+     * Dequeues all items from the queue at once, blocking for up
+     * to the relative timeout for at least one item to become
+     * available. Returns an empty list if the timeout expires first.
+     */
+    template<typename duration_type>
+    QListPtr dequeueAllWaitFor(const duration_type& timeout) {
+        const boost::system_time deadline = boost::get_system_time() + timeout;
+        Recycler recycler(spareQueue);
+        ScopedLock lock(this->getMutex(), stats);
+        waitForElement(deadline);
+        return swapOutQueue(recycler);
     }
 };
+
+/*
+ * Names the TSQueue configuration which recycles element storage
+ * and list nodes through pools. To use:
+ *  core::threading::container::pooled<T>::Queue
+ */
+template<typename T>
+struct pooled {
+    typedef TSQueue<T, ::core::container::PooledCloneAllocator,
+                    ::core::container::PooledNodeAllocator> Queue;
+};
+
+/*
+ * Names the TSQueue configuration which records QueueStats about
+ * its elements and lock contention. To use:
+ *  core::threading::container::instrumented<T>::Queue
+ */
+template<typename T>
+struct instrumented {
+    typedef TSQueue<T, boost::heap_clone_allocator, std::allocator<void*>,
+                    QueueStats> Queue;
+};
 }}}
 
 #endif
@@ -0,0 +1,392 @@
+/*
+ * tsringbuffer.h
+ * This class creates a lock-free multicast ring buffer implementation,
+ * in which every consumer sees every event.
+ */
+
+#ifndef TS_RING_BUFFER_H_
+#define TS_RING_BUFFER_H_
+
+#include <cstddef>
+#include <vector>
+#include "threading/atomics.hpp"
+
+// Don't listen to warnings about boost on msvc
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(push, 0)
+#endif
+#include <boost/noncopyable.hpp>
+#include <boost/static_assert.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/thread_time.hpp>
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(pop)
+#endif
+
+namespace core { namespace threading { namespace container {
+
+/*
+ * A cursor into a TSRingBuffer, marking the last sequence number a
+ * producer published or a consumer finished with. Each cursor sits on
+ * its own cache line since it is written by exactly one thread and
+ * read by many.
+ */
+class RingSequence : private boost::noncopyable {
+public:
+    typedef boost::int64_t SequenceType;
+    // The value of a cursor before anything has been processed
+    static const SequenceType INITIAL = -1;
+
+private:
+    CacheLinePadded<boost::atomic<SequenceType> > value;
+
+public:
+    explicit RingSequence(SequenceType initial = INITIAL) : value() {
+        value.value.store(initial, boost::memory_order_release);
+    }
+
+    SequenceType get() const {
+        return value.value.load(boost::memory_order_acquire);
+    }
+
+    void set(SequenceType sequence) {
+        value.value.store(sequence, boost::memory_order_release);
+    }
+};
+
+namespace hidden {
+/*
+ * Backs off a spin-wait loop, first with processor pauses and then
+ * by yielding the thread.
+ */
+inline void ringBackoff(std::size_t& spins) {
+    if (spins < 100) {
+        spins++;
+        cpuRelax();
+    } else {
+        boost::this_thread::yield();
+    }
+}
+}
+
+/*
+ * TSRingBuffer implements a preallocated multicast ring of events in
+ * the style of the LMAX Disruptor. Producers claim sequence numbers,
+ * write the events in place and publish them. Every consumer keeps its
+ * own RingSequence cursor and reads events directly out of the ring
+ * through a Barrier, so an event is written once and read by any
+ * number of consumers without copies or locks.
+ *
+ * A Barrier can depend on other consumers' cursors, which lets
+ * consumer stages be chained: a stage only sees an event once every
+ * stage it depends on has finished with it. The cursors of the final
+ * stages must be registered with addGatingSequence before production
+ * starts, so producers never overwrite events those consumers have
+ * not reached. Without any gating cursors producers never wait.
+ *
+ * Every claimed sequence must be published, even if writing the event
+ * fails, or consumers wait on it forever.
+ *
+ * Any number of producers may claim and publish concurrently. Waits
+ * spin briefly and then yield. Capacity must be a power of two.
+ */
+template <typename T, std::size_t Capacity>
+class TSRingBuffer : private boost::noncopyable {
+private:
+    BOOST_STATIC_ASSERT(Capacity >= 2);
+    BOOST_STATIC_ASSERT((Capacity & (Capacity - 1)) == 0);
+
+public:
+    typedef T ElemType;
+    typedef RingSequence::SequenceType SequenceType;
+
+private:
+    typedef boost::atomic<SequenceType> Published;
+
+    static const std::size_t mask = Capacity - 1;
+
+    boost::scoped_array<T> entries;
+    // The sequence most recently published into each slot
+    boost::scoped_array<Published> published;
+    // The highest sequence claimed by any producer
+    CacheLinePadded<boost::atomic<SequenceType> > claimCursor;
+    // The slowest gating cursor when last checked
+    RingSequence gatingCache;
+    std::vector<const RingSequence *> gatingSequences;
+
+    /*
+     * Returns the lowest gating cursor, or the default if there are
+     * no gating cursors.
+     */
+    SequenceType minimumGating(SequenceType defaultSequence) const {
+        SequenceType minimum = defaultSequence;
+        for (std::size_t i = 0; i < gatingSequences.size(); i++) {
+            SequenceType sequence = gatingSequences[i]->get();
+            if (sequence < minimum) {
+                minimum = sequence;
+            }
+        }
+        return minimum;
+    }
+
+    /* Blocks until no gating consumer is behind the wrap point */
+    void waitForRoom(SequenceType wrapPoint, SequenceType claimed) {
+        if (wrapPoint <= gatingCache.get()) {
+            return;
+        }
+        std::size_t spins = 0;
+        SequenceType minimum;
+        while (wrapPoint > (minimum = minimumGating(claimed))) {
+            hidden::ringBackoff(spins);
+        }
+        gatingCache.set(minimum);
+    }
+
+public:
+    /*
+     * Waits for events on behalf of one consumer, optionally behind
+     * the cursors of other consumers it depends on.
+     */
+    class Barrier {
+    private:
+        const TSRingBuffer *ring;
+        std::vector<const RingSequence *> dependents;
+
+        /* Returns the highest sequence which is ready right now */
+        SequenceType available(SequenceType sequence) const {
+            if (dependents.empty()) {
+                return ring->highestPublished(sequence, ring->getCursor());
+            }
+            SequenceType minimum = dependents[0]->get();
+            for (std::size_t i = 1; i < dependents.size(); i++) {
+                SequenceType dependent = dependents[i]->get();
+                if (dependent < minimum) {
+                    minimum = dependent;
+                }
+            }
+            return minimum;
+        }
+
+    public:
+        explicit Barrier(const TSRingBuffer& ringBuffer) : ring(&ringBuffer), dependents() {}
+        Barrier(const TSRingBuffer& ringBuffer, const std::vector<const RingSequence *>& deps) :
+            ring(&ringBuffer), dependents(deps) {}
+
+        /*
+         * Returns the highest sequence which is ready to be read.
+         * This is less than the requested sequence if it is not
+         * ready yet, and never blocks.
+         */
+        SequenceType tryWaitFor(SequenceType sequence) const {
+            return available(sequence);
+        }
+
+        /*
+         * Blocks until the requested sequence is ready, returning
+         * the highest sequence which is ready (possibly more than
+         * was requested).
+         */
+        SequenceType waitFor(SequenceType sequence) const {
+            std::size_t spins = 0;
+            SequenceType ready;
+            while ((ready = available(sequence)) < sequence) {
+                hidden::ringBackoff(spins);
+            }
+            return ready;
+        }
+
+        /*
+         * Blocks until the requested sequence is ready or the
+         * deadline passes, returning the highest sequence which is
+         * ready. This is less than the requested sequence on timeout.
+         */
+        SequenceType waitFor(SequenceType sequence, const boost::system_time& deadline) const {
+            std::size_t spins = 0;
+            SequenceType ready;
+            while ((ready = available(sequence)) < sequence) {
+                if (boost::get_system_time() >= deadline) {
+                    break;
+                }
+                hidden::ringBackoff(spins);
+            }
+            return ready;
+        }
+    };
+
+    TSRingBuffer() : entries(new T[Capacity]), published(new Published[Capacity]),
+                     claimCursor(), gatingCache(), gatingSequences() {
+        claimCursor.value.store(RingSequence::INITIAL, boost::memory_order_relaxed);
+        for (std::size_t i = 0; i < Capacity; i++) {
+            published[i].store(RingSequence::INITIAL, boost::memory_order_relaxed);
+        }
+        gatingCache.set(RingSequence::INITIAL);
+    }
+
+    /* Returns the number of events the ring holds */
+    static std::size_t capacity() {
+        return Capacity;
+    }
+
+    /*
+     * Stops producers from overwriting events which the consumer
+     * owning the cursor has not finished with. Must be called before
+     * any events are claimed.
+     */
+    void addGatingSequence(const RingSequence& sequence) {
+        gatingSequences.push_back(&sequence);
+    }
+
+    /* Creates a barrier which waits only on published events */
+    Barrier newBarrier() const {
+        return Barrier(*this);
+    }
+
+    /*
+     * Creates a barrier which also waits for the consumer owning the
+     * given cursor to finish with each event.
+     */
+    Barrier newBarrier(const RingSequence& dependent) const {
+        return Barrier(*this, std::vector<const RingSequence *>(1, &dependent));
+    }
+
+    /*
+     * Creates a barrier which also waits for every consumer owning
+     * one of the given cursors to finish with each event.
+     */
+    Barrier newBarrier(const std::vector<const RingSequence *>& dependents) const {
+        return Barrier(*this, dependents);
+    }
+
+    /* Returns the highest sequence claimed by any producer */
+    SequenceType getCursor() const {
+        return claimCursor.value.load(boost::memory_order_acquire);
+    }
+
+    /* Returns true if the event at sequence has been published */
+    bool isPublished(SequenceType sequence) const {
+        return published[sequence & mask].load(boost::memory_order_acquire) == sequence;
+    }
+
+    /*
+     * Returns the highest sequence in [lowest, highest] for which it
+     * and every sequence before it have been published, or lowest - 1
+     * if lowest has not been published.
+     */
+    SequenceType highestPublished(SequenceType lowest, SequenceType highest) const {
+        for (SequenceType sequence = lowest; sequence <= highest; sequence++) {
+            if (!isPublished(sequence)) {
+                return sequence - 1;
+            }
+        }
+        return highest;
+    }
+
+    /*
+     * Claims the next count sequences for a producer, blocking while
+     * the ring is full. Returns the highest claimed sequence, so the
+     * claimed range is [result - count + 1, result]. Count must not
+     * exceed the capacity.
+     */
+    SequenceType claim(std::size_t count = 1) {
+        SequenceType next = claimCursor.value.fetch_add(count, boost::memory_order_acq_rel) + count;
+        waitForRoom(next - (SequenceType)Capacity, next);
+        return next;
+    }
+
+    /*
+     * Claims the next count sequences for a producer if the ring has
+     * room for them. Returns false without blocking otherwise.
+     */
+    bool tryClaim(std::size_t count, SequenceType& highest) {
+        SequenceType current = claimCursor.value.load(boost::memory_order_acquire);
+        for (;;) {
+            SequenceType next = current + (SequenceType)count;
+            if (next - (SequenceType)Capacity > minimumGating(current)) {
+                return false;
+            }
+            if (claimCursor.value.compare_exchange_weak(current, next, boost::memory_order_acq_rel)) {
+                highest = next;
+                return true;
+            }
+        }
+    }
+
+    /* Returns the event slot for a claimed or published sequence */
+    T& get(SequenceType sequence) {
+        return entries[sequence & mask];
+    }
+    const T& get(SequenceType sequence) const {
+        return entries[sequence & mask];
+    }
+
+    /* Makes a claimed event visible to consumers */
+    void publish(SequenceType sequence) {
+        published[sequence & mask].store(sequence, boost::memory_order_release);
+    }
+
+    /* Makes a claimed range of events visible to consumers */
+    void publish(SequenceType lowest, SequenceType highest) {
+        for (SequenceType sequence = lowest; sequence <= highest; sequence++) {
+            publish(sequence);
+        }
+    }
+
+    /*
+     * Claims, writes and publishes a single event. If the assignment
+     * throws the sequence is still published, holding whatever the
+     * assignment left in the slot, so consumers aren't stalled.
+     */
+    void publishEvent(const T& event) {
+        SequenceType sequence = claim();
+        try {
+            get(sequence) = event;
+        } catch (...) {
+            publish(sequence);
+            throw;
+        }
+        publish(sequence);
+    }
+
+    /*
+     * Hands every event which is ready for the consumer to the
+     * handler, then advances the consumer's cursor past them. The
+     * handler is called as handler(event, sequence, endOfBatch).
+     * Returns the number of events handled without blocking.
+     */
+    template<typename Handler>
+    std::size_t consume(const Barrier& barrier, RingSequence& sequence, Handler handler) const {
+        SequenceType next = sequence.get() + 1;
+        return handleBatch(next, barrier.tryWaitFor(next), sequence, handler);
+    }
+
+    /*
+     * As consume, but blocks until at least one event is ready or
+     * the deadline passes.
+     */
+    template<typename Handler>
+    std::size_t consumeWait(const Barrier& barrier, RingSequence& sequence, Handler handler,
+                            const boost::system_time& deadline) const {
+        SequenceType next = sequence.get() + 1;
+        return handleBatch(next, barrier.waitFor(next, deadline), sequence, handler);
+    }
+
+private:
+    template<typename Handler>
+    std::size_t handleBatch(SequenceType first, SequenceType last,
+                            RingSequence& sequence, Handler& handler) const {
+        for (SequenceType current = first; current <= last; current++) {
+            handler(get(current), current, current == last);
+        }
+        if (last >= first) {
+            sequence.set(last);
+            return (std::size_t)(last - first + 1);
+        }
+        return 0;
+    }
+};
+
+}}}
+
+#endif /* TS_RING_BUFFER_H_ */
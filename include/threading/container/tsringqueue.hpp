@@ -0,0 +1,265 @@
+/*
+ * tsringqueue.h
+ * This class creates a lock-free bounded thread safe queue implementation.
+ */
+
+#ifndef TS_RING_QUEUE_H_
+#define TS_RING_QUEUE_H_
+
+#include <cstddef>
+#include "threading/atomics.hpp"
+
+// Don't listen to warnings about boost on msvc
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(push, 0)
+#endif
+#include <boost/noncopyable.hpp>
+#include <boost/static_assert.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/type_traits/aligned_storage.hpp>
+#include <boost/type_traits/alignment_of.hpp>
+#include <boost/move/move.hpp>
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(pop)
+#endif
+
+namespace core { namespace threading { namespace container {
+
+/*
+ * TSRingQueue implements a bounded multi-producer/multi-consumer
+ * queue on top of a preallocated ring of cells. Each cell carries
+ * its own sequence number so producers and consumers only ever
+ * contend on a single compare-and-swap of their respective index,
+ * and no locks or per-element allocations are made after the queue
+ * is constructed.
+ *
+ * Elements are stored by value, so unlike TSQueue the dequeue calls
+ * copy into caller provided storage instead of returning pointers.
+ * Capacity must be a power of two.
+ *
+ * A cell is claimed before its element is built, so a copy which
+ * throws leaves an empty cell behind. It is still published, marked
+ * as empty, and consumers skip it. A move which throws during a
+ * dequeue loses that element, but the cell is still released.
+ */
+template <typename T, std::size_t Capacity>
+class TSRingQueue : private boost::noncopyable {
+private:
+    BOOST_STATIC_ASSERT(Capacity >= 2);
+    BOOST_STATIC_ASSERT((Capacity & (Capacity - 1)) == 0);
+
+    typedef boost::atomic<std::size_t> Sequence;
+    typedef typename boost::aligned_storage<sizeof(T), boost::alignment_of<T>::value>::type Storage;
+
+    struct Cell {
+        Sequence sequence;
+        // False if building the element threw, so there is none
+        bool constructed;
+        Storage storage;
+
+        T *element() {
+            return static_cast<T *>(static_cast<void *>(&storage));
+        }
+    };
+
+    static const std::size_t mask = Capacity - 1;
+
+    boost::scoped_array<Cell> cells;
+    CacheLinePadded<Sequence> enqueuePos;
+    CacheLinePadded<Sequence> dequeuePos;
+
+    /* Releases a claimed read cell when it goes out of scope */
+    class ReadRelease : private boost::noncopyable {
+    private:
+        Cell *const cell;
+        const std::size_t pos;
+    public:
+        ReadRelease(Cell *readCell, std::size_t readPos) : cell(readCell), pos(readPos) {}
+        ~ReadRelease() {
+            releaseCell(cell, pos);
+        }
+    };
+
+    /*
+     * Claims the next readable cell, or returns NULL if the queue
+     * is empty. Cells left empty by a failed enqueue are skipped.
+     * The cell must be released with releaseCell.
+     */
+    Cell *claimReadCell(std::size_t& pos) {
+        pos = dequeuePos.value.load(boost::memory_order_relaxed);
+        for (;;) {
+            Cell *cell = &cells[pos & mask];
+            std::size_t seq = cell->sequence.load(boost::memory_order_acquire);
+            std::ptrdiff_t diff = (std::ptrdiff_t)seq - (std::ptrdiff_t)(pos + 1);
+            if (diff == 0) {
+                if (dequeuePos.value.compare_exchange_weak(pos, pos + 1, boost::memory_order_relaxed)) {
+                    if (cell->constructed) {
+                        return cell;
+                    }
+                    releaseCell(cell, pos);
+                    pos = dequeuePos.value.load(boost::memory_order_relaxed);
+                }
+            } else if (diff < 0) {
+                return NULL;
+            } else {
+                pos = dequeuePos.value.load(boost::memory_order_relaxed);
+            }
+        }
+    }
+
+    static void releaseCell(Cell *cell, std::size_t pos) {
+        if (cell->constructed) {
+            cell->element()->~T();
+        }
+        cell->sequence.store(pos + mask + 1, boost::memory_order_release);
+    }
+
+public:
+    typedef T ElemType;
+
+    TSRingQueue() : cells(new Cell[Capacity]), enqueuePos(), dequeuePos() {
+        for (std::size_t i = 0; i < Capacity; i++) {
+            cells[i].sequence.store(i, boost::memory_order_relaxed);
+            cells[i].constructed = false;
+        }
+        enqueuePos.value.store(0, boost::memory_order_relaxed);
+        dequeuePos.value.store(0, boost::memory_order_release);
+    }
+
+    /*
+     * Ensure that all remaining elements have their destructors
+     * called.
+     */
+    ~TSRingQueue() {
+        clear();
+    }
+
+    /* Returns the maximum number of elements the queue can hold */
+    static std::size_t capacity() {
+        return Capacity;
+    }
+
+    /*
+     * Returns the size of the queue. This is only a snapshot when
+     * other threads are actively using the queue.
+     */
+    std::size_t size() const {
+        std::size_t deq = dequeuePos.value.load(boost::memory_order_acquire);
+        std::size_t enq = enqueuePos.value.load(boost::memory_order_acquire);
+        return enq > deq ? enq - deq : 0;
+    }
+
+    /* Returns true if the queue is (momentarily) empty */
+    bool empty() const {
+        return size() == 0;
+    }
+
+    /* Returns true if the queue is (momentarily) full */
+    bool full() const {
+        return size() >= Capacity;
+    }
+
+    /* Clears all queue elements from the queue */
+    void clear() {
+        std::size_t pos;
+        Cell *cell;
+        while ((cell = claimReadCell(pos)) != NULL) {
+            releaseCell(cell, pos);
+        }
+    }
+
+    /*
+     * Enqueues a copy of the element into the queue. Returns false
+     * without blocking if the queue is full.
+     */
+    bool enqueue(const T& enq) {
+        std::size_t pos = enqueuePos.value.load(boost::memory_order_relaxed);
+        Cell *cell;
+        for (;;) {
+            cell = &cells[pos & mask];
+            std::size_t seq = cell->sequence.load(boost::memory_order_acquire);
+            std::ptrdiff_t diff = (std::ptrdiff_t)seq - (std::ptrdiff_t)pos;
+            if (diff == 0) {
+                if (enqueuePos.value.compare_exchange_weak(pos, pos + 1, boost::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueuePos.value.load(boost::memory_order_relaxed);
+            }
+        }
+        try {
+            new (cell->element()) T(enq);
+            cell->constructed = true;
+        } catch (...) {
+            // Publish the cell anyway, so consumers can skip past it
+            cell->constructed = false;
+            cell->sequence.store(pos + 1, boost::memory_order_release);
+            throw;
+        }
+        cell->sequence.store(pos + 1, boost::memory_order_release);
+        return true;
+    }
+
+    /*
+     * Enqueues elements from the input range until the range is
+     * exhausted or the queue fills. Returns the number enqueued.
+     */
+    template<typename InputIterator>
+    std::size_t enqueueN(InputIterator first, InputIterator last) {
+        std::size_t count = 0;
+        for (; first != last && enqueue(*first); ++first) {
+            count++;
+        }
+        return count;
+    }
+
+    /*
+     * Dequeues an element off of the front of the queue into deq.
+     * Returns false without blocking if the queue is empty.
+     */
+    bool dequeue(T& deq) {
+        std::size_t pos;
+        Cell *cell = claimReadCell(pos);
+        if (cell == NULL) {
+            return false;
+        }
+        ReadRelease release(cell, pos);
+        deq = boost::move(*cell->element());
+        return true;
+    }
+
+    /*
+     * Dequeues up to N items from the queue at once, writing them
+     * to the output iterator. Returns the number dequeued.
+     */
+    template<typename OutputIterator>
+    std::size_t dequeueN(OutputIterator out, std::size_t numDequeue) {
+        std::size_t count = 0;
+        std::size_t pos;
+        Cell *cell;
+        while (count < numDequeue && (cell = claimReadCell(pos)) != NULL) {
+            ReadRelease release(cell, pos);
+            *out = boost::move(*cell->element());
+            ++out;
+            count++;
+        }
+        return count;
+    }
+
+    /*
+     * Dequeues all items currently visible in the queue, writing
+     * them to the output iterator. At most Capacity items are taken
+     * so producers cannot keep a consumer draining forever. Returns
+     * the number dequeued.
+     */
+    template<typename OutputIterator>
+    std::size_t dequeueAll(OutputIterator out) {
+        return dequeueN(out, Capacity);
+    }
+};
+
+}}}
+
+#endif /* TS_RING_QUEUE_H_ */
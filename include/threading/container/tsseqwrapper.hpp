@@ -0,0 +1,168 @@
+/*
+ * tsseqwrapper.h
+ * This class creates a sequence locked wrapper for small values which
+ * are read far more often than they are written.
+ */
+
+#ifndef TS_SEQ_WRAPPER_H_
+#define TS_SEQ_WRAPPER_H_
+
+#include "threading/atomics.hpp"
+#include "threading/spin_lock.hpp"
+
+// Don't listen to warnings about boost on msvc
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(push, 0)
+#endif
+#include <boost/noncopyable.hpp>
+#include <boost/static_assert.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/type_traits/has_trivial_copy.hpp>
+#include <boost/thread/locks.hpp>
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(pop)
+#endif
+
+namespace core { namespace threading { namespace container {
+
+/*
+ * TSSeqWrapper guards a small value with a sequence lock. Writers
+ * serialize on a spin mutex and make the sequence odd for the length
+ * of the write. Readers never write shared memory: they copy the value
+ * and retry if the sequence was odd or changed during the copy, so any
+ * number of readers proceed in parallel without bouncing a cache line
+ * between them.
+ *
+ * Readers only ever see a consistent copy, never the live value, so T
+ * must be trivially copyable. Readers can be starved by a constant
+ * stream of writes, so this suits configuration-like values which
+ * change rarely.
+ */
+template<typename T>
+class TSSeqWrapper : private boost::noncopyable {
+private:
+    BOOST_STATIC_ASSERT(boost::has_trivial_copy<T>::value);
+
+public:
+    typedef T WrapperType;
+    typedef boost::uint64_t VersionType;
+
+private:
+    // Odd while a write is in progress, and bumped twice per write
+    boost::atomic<VersionType> sequence;
+    T value;
+    SpinMutex writeMutex;
+
+    /* Waits out any write in progress, returning the even sequence */
+    VersionType beginRead() const {
+        VersionType start;
+        while ((start = sequence.load(boost::memory_order_acquire)) & 1) {
+            cpuRelax();
+        }
+        return start;
+    }
+
+    /* Returns true if no write happened since beginRead */
+    bool validateRead(VersionType start) const {
+        boost::atomic_thread_fence(boost::memory_order_acquire);
+        return sequence.load(boost::memory_order_relaxed) == start;
+    }
+
+    /*
+     * Holds the write mutex and keeps the sequence odd for its
+     * lifetime. The sequence is made even again even if the write
+     * throws, so readers are never left spinning.
+     */
+    class WriteSection : private boost::noncopyable {
+    private:
+        boost::lock_guard<SpinMutex> lock;
+        boost::atomic<VersionType>& sequence;
+        const VersionType start;
+    public:
+        explicit WriteSection(TSSeqWrapper& wrapper) :
+            lock(wrapper.writeMutex), sequence(wrapper.sequence),
+            start(wrapper.sequence.load(boost::memory_order_relaxed)) {
+            sequence.store(start + 1, boost::memory_order_relaxed);
+            boost::atomic_thread_fence(boost::memory_order_release);
+        }
+        ~WriteSection() {
+            sequence.store(start + 2, boost::memory_order_release);
+        }
+    };
+
+public:
+    TSSeqWrapper() : value(), writeMutex() {
+        sequence.store(0, boost::memory_order_release);
+    }
+    explicit TSSeqWrapper(const T& init) : value(init), writeMutex() {
+        sequence.store(0, boost::memory_order_release);
+    }
+
+    /* Returns a consistent copy of the value */
+    T read() const {
+        for (;;) {
+            VersionType start = beginRead();
+            T copy(value);
+            if (validateRead(start)) {
+                return copy;
+            }
+        }
+    }
+
+    /*
+     * Calls functor(const T&) with a consistent copy of the value.
+     * The functor runs once, after the copy has been validated.
+     */
+    template<typename Functor>
+    void read(Functor functor) const {
+        const T copy(read());
+        functor(copy);
+    }
+
+    /*
+     * Copies the value into out if no write is in progress. Returns
+     * false without retrying otherwise.
+     */
+    bool tryRead(T& out) const {
+        VersionType start = sequence.load(boost::memory_order_acquire);
+        if (start & 1) {
+            return false;
+        }
+        T copy(value);
+        if (!validateRead(start)) {
+            return false;
+        }
+        out = copy;
+        return true;
+    }
+
+    /*
+     * Calls functor(T&) on the live value while holding off readers.
+     * Keep the functor short, since readers spin until it returns.
+     * If the functor throws, readers see whatever changes it made
+     * before throwing.
+     */
+    template<typename Functor>
+    void write(Functor functor) {
+        WriteSection section(*this);
+        functor(value);
+    }
+
+    /* Replaces the value */
+    void store(const T& update) {
+        WriteSection section(*this);
+        value = update;
+    }
+
+    /*
+     * Returns the number of writes which have completed. A reader can
+     * compare versions to cheaply tell whether the value has changed.
+     */
+    VersionType version() const {
+        return beginRead() / 2;
+    }
+};
+
+}}}
+
+#endif /* TS_SEQ_WRAPPER_H_ */
@@ -0,0 +1,372 @@
+/*
+ * tsshardedqueue.h
+ * This class creates a thread safe queue implementation which spreads
+ * producers over several independently locked sub-queues.
+ */
+
+#ifndef TS_SHARDED_QUEUE_H_
+#define TS_SHARDED_QUEUE_H_
+
+#include <cstddef>
+#include <deque>
+#include "pointers.hpp"
+#include "threading/atomics.hpp"
+
+// Don't listen to warnings about boost on msvc
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(push, 0)
+#endif
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/static_assert.hpp>
+#include <boost/type_traits/is_same.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(pop)
+#endif
+
+namespace core { namespace threading { namespace container {
+
+/*
+ * Selects the ordering guarantee of a TSShardedQueue.
+ */
+enum ShardOrdering {
+    // Elements from one producer thread are dequeued in the order
+    // that thread enqueued them. No order is kept between producers.
+    PER_PRODUCER_FIFO,
+    // An element is dequeued before every element whose enqueue
+    // started after its enqueue finished. Consumers pay for this by
+    // locking every shard on each dequeue.
+    GLOBAL_FIFO
+};
+
+/*
+ * TSShardedQueue implements a boost::thread safe queue which is split
+ * into several sub-queues (shards), each with its own mutex on its own
+ * cache line. Producer threads hash to a fixed shard, so producers on
+ * different shards never contend with each other. Consumers drain the
+ * shards round-robin, and dequeueAll merges the shard lists by splicing
+ * rather than copying.
+ *
+ * By default there is one shard per hardware thread.
+ *
+ * std::list::size may walk the whole list, so nothing here calls it
+ * while a shard is locked except size() itself.
+ */
+template <typename T,
+          typename CloneAllocator = boost::heap_clone_allocator,
+          typename Allocator = std::allocator<void*> >
+class TSShardedQueue : private boost::noncopyable {
+public:
+    typedef T ElemType;
+    typedef typename pointers::lists<T, CloneAllocator, Allocator>::UniquePtrList QList;
+    typedef typename QList::UniquePtr PtrType;
+    typedef typename pointers::smart<QList>::SharedPtr QListPtr;
+
+private:
+    typedef boost::mutex::scoped_lock ScopedLock;
+
+    // Passed as numDequeue to take everything
+    static const std::size_t DEQUEUE_ALL = (std::size_t)-1;
+
+    struct Shard {
+        boost::mutex mutex;
+        QList queue;
+        // Global enqueue order of each queue element (GLOBAL_FIFO only)
+        std::deque<boost::uint64_t> sequences;
+    };
+    typedef CacheLinePadded<Shard> PaddedShard;
+
+    const std::size_t numShards;
+    const ShardOrdering ordering;
+    boost::scoped_array<PaddedShard> shards;
+    CloneAllocator cloner;
+    // Next enqueue sequence number (GLOBAL_FIFO only)
+    CacheLinePadded<boost::atomic<boost::uint64_t> > nextSequence;
+    // Shard the next consumer starts draining from
+    CacheLinePadded<boost::atomic<std::size_t> > nextConsumerShard;
+
+    void initCounters() {
+        nextSequence.value.store(0, boost::memory_order_relaxed);
+        nextConsumerShard.value.store(0, boost::memory_order_release);
+    }
+
+    static std::size_t defaultShardCount() {
+        std::size_t count = boost::thread::hardware_concurrency();
+        return count > 0 ? count : 1;
+    }
+
+    /* Returns the shard owned by the calling producer thread */
+    Shard& producerShard() {
+        return shards[threadHash() % numShards].value;
+    }
+
+    /*
+     * Adds an element to the back of a shard. Must be called while
+     * the shard mutex is held.
+     */
+    void pushBack(Shard& shard, T *const enq) {
+        shard.queue.push_back(enq);
+        if (ordering == GLOBAL_FIFO) {
+            // Stamped under the shard lock, so each shard stays sorted
+            shard.sequences.push_back(nextSequence.value.fetch_add(1, boost::memory_order_relaxed));
+        }
+    }
+
+    /* Adds an element made by our clone allocator to this thread's shard */
+    void enqueueOwned(T *const enq) {
+        Shard& shard = producerShard();
+        ScopedLock lock(shard.mutex);
+        pushBack(shard, enq);
+    }
+
+    /*
+     * Moves every element of a list holding count elements onto the
+     * back of a shard. count is only used under GLOBAL_FIFO. Must be
+     * called while the shard mutex is held.
+     */
+    void spliceBack(Shard& shard, QList& enq, std::size_t count) {
+        if (ordering == GLOBAL_FIFO) {
+            boost::uint64_t first = nextSequence.value.fetch_add(count, boost::memory_order_relaxed);
+            for (std::size_t i = 0; i < count; i++) {
+                shard.sequences.push_back(first + i);
+            }
+        }
+        shard.queue.transfer(shard.queue.end(), enq);
+    }
+
+    /*
+     * Moves the front element of a shard onto the back of a list.
+     * Must be called while the shard mutex is held.
+     */
+    void transferFront(Shard& shard, QList& deq) {
+        deq.transfer(deq.end(), shard.queue.begin(), shard.queue);
+        if (ordering == GLOBAL_FIFO) {
+            shard.sequences.pop_front();
+        }
+    }
+
+    /*
+     * Returns the non-empty shard whose front element was enqueued
+     * first, or NULL if all shards are empty. Must be called while
+     * every shard mutex is held.
+     */
+    Shard *oldestShard() {
+        Shard *oldest = NULL;
+        for (std::size_t i = 0; i < numShards; i++) {
+            Shard& shard = shards[i].value;
+            if (!shard.queue.empty() &&
+                    (oldest == NULL || shard.sequences.front() < oldest->sequences.front())) {
+                oldest = &shard;
+            }
+        }
+        return oldest;
+    }
+
+    /*
+     * Locks every shard in index order, so that consumers taking a
+     * global view always acquire the mutexes in the same order.
+     */
+    class AllShardsLock : private boost::noncopyable {
+    private:
+        TSShardedQueue& queue;
+    public:
+        explicit AllShardsLock(TSShardedQueue& q) : queue(q) {
+            for (std::size_t i = 0; i < queue.numShards; i++) {
+                queue.shards[i].value.mutex.lock();
+            }
+        }
+        ~AllShardsLock() {
+            for (std::size_t i = queue.numShards; i > 0; i--) {
+                queue.shards[i - 1].value.mutex.unlock();
+            }
+        }
+    };
+
+    /* Moves up to numDequeue elements into deq in global order */
+    void dequeueGlobal(QList& deq, std::size_t numDequeue) {
+        AllShardsLock lock(*this);
+        Shard *oldest;
+        for (std::size_t taken = 0; taken < numDequeue && (oldest = oldestShard()) != NULL; taken++) {
+            transferFront(*oldest, deq);
+        }
+    }
+
+    /* Moves up to numDequeue elements into deq, draining round-robin */
+    void dequeueRoundRobin(QList& deq, std::size_t numDequeue) {
+        std::size_t start = nextConsumerShard.value.fetch_add(1, boost::memory_order_relaxed);
+        std::size_t taken = 0;
+        for (std::size_t i = 0; i < numShards && taken < numDequeue; i++) {
+            Shard& shard = shards[(start + i) % numShards].value;
+            ScopedLock lock(shard.mutex);
+            if (numDequeue == DEQUEUE_ALL) {
+                deq.transfer(deq.end(), shard.queue);
+                continue;
+            }
+            // Only walk as far as the elements we take
+            typename QList::iterator last = shard.queue.begin();
+            for (; last != shard.queue.end() && taken < numDequeue; ++last) {
+                taken++;
+            }
+            deq.transfer(deq.end(), shard.queue.begin(), last, shard.queue);
+        }
+    }
+
+public:
+    explicit TSShardedQueue(ShardOrdering order = PER_PRODUCER_FIFO) :
+        numShards(defaultShardCount()), ordering(order),
+        shards(new PaddedShard[numShards]), cloner(),
+        nextSequence(), nextConsumerShard() {
+        initCounters();
+    }
+    explicit TSShardedQueue(std::size_t shardCount, ShardOrdering order = PER_PRODUCER_FIFO) :
+        numShards(shardCount > 0 ? shardCount : 1), ordering(order),
+        shards(new PaddedShard[numShards]), cloner(),
+        nextSequence(), nextConsumerShard() {
+        initCounters();
+    }
+
+    /* Returns the number of sub-queues */
+    std::size_t shardCount() const {
+        return numShards;
+    }
+
+    /* Returns the ordering guarantee of the queue */
+    ShardOrdering getOrdering() const {
+        return ordering;
+    }
+
+    /*
+     * Returns the size of the queue. This is only a snapshot when
+     * other threads are actively using the queue.
+     */
+    std::size_t size() {
+        std::size_t total = 0;
+        for (std::size_t i = 0; i < numShards; i++) {
+            ScopedLock lock(shards[i].value.mutex);
+            total += shards[i].value.queue.size();
+        }
+        return total;
+    }
+
+    /* Returns true if the queue is (momentarily) empty */
+    bool empty() {
+        for (std::size_t i = 0; i < numShards; i++) {
+            ScopedLock lock(shards[i].value.mutex);
+            if (!shards[i].value.queue.empty()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /* Clears all queue elements from the queue */
+    void clear() {
+        for (std::size_t i = 0; i < numShards; i++) {
+            ScopedLock lock(shards[i].value.mutex);
+            shards[i].value.queue.clear();
+            shards[i].value.sequences.clear();
+        }
+    }
+
+    /*
+     * Enqueues a new element into the calling thread's shard. The
+     * copy is made before the shard lock is taken.
+     */
+    template<typename U>
+    void enqueue(const U& enq) {
+        enqueueOwned(cloner.allocate_clone(enq));
+    }
+
+    /*
+     * Enqueues a pointer, taking ownership of it. Only allowed with
+     * the heap clone allocator, which frees elements with delete.
+     */
+    void enqueue(T *const enq) {
+        BOOST_STATIC_ASSERT((boost::is_same<CloneAllocator, boost::heap_clone_allocator>::value));
+        enqueueOwned(enq);
+    }
+
+    /*
+     * Enqueues copies of every element in the input range into the
+     * calling thread's shard under a single lock acquisition.
+     */
+    template<typename InputIterator>
+    void enqueueN(InputIterator first, InputIterator last) {
+        QList batch;
+        for (; first != last; ++first) {
+            batch.push_back(cloner.allocate_clone(*first));
+        }
+        splice(batch);
+    }
+
+    /*
+     * Splices every element of a caller owned list onto the calling
+     * thread's shard under a single lock acquisition. The list is
+     * left empty.
+     */
+    void splice(QList& enq) {
+        if (enq.empty()) {
+            return;
+        }
+        // Counted before locking, since the list may have to be walked
+        std::size_t count = ordering == GLOBAL_FIFO ? enq.size() : 0;
+        Shard& shard = producerShard();
+        ScopedLock lock(shard.mutex);
+        spliceBack(shard, enq, count);
+    }
+
+    /*
+     * Dequeues an element off of the front of the queue. Returns an
+     * empty pointer if the queue is empty.
+     */
+    PtrType dequeue() {
+        if (ordering == GLOBAL_FIFO) {
+            AllShardsLock lock(*this);
+            Shard *oldest = oldestShard();
+            if (oldest == NULL) {
+                return PtrType();
+            }
+            oldest->sequences.pop_front();
+            return oldest->queue.pop_front();
+        }
+        std::size_t start = nextConsumerShard.value.fetch_add(1, boost::memory_order_relaxed);
+        for (std::size_t i = 0; i < numShards; i++) {
+            Shard& shard = shards[(start + i) % numShards].value;
+            ScopedLock lock(shard.mutex);
+            if (!shard.queue.empty()) {
+                return shard.queue.pop_front();
+            }
+        }
+        return PtrType();
+    }
+
+    /*
+     * Dequeues up to N items from the queue at once. Under
+     * PER_PRODUCER_FIFO whole runs are spliced out of each shard.
+     */
+    QListPtr dequeueN(std::size_t numDequeue) {
+        QListPtr deq(new QList());
+        if (ordering == GLOBAL_FIFO) {
+            dequeueGlobal(*deq, numDequeue);
+        } else {
+            dequeueRoundRobin(*deq, numDequeue);
+        }
+        return deq;
+    }
+
+    /*
+     * Dequeues all items in the queue at once. Under PER_PRODUCER_FIFO
+     * each shard list is spliced onto the result in O(1), and under
+     * GLOBAL_FIFO the shard lists are merged by sequence number.
+     */
+    QListPtr dequeueAll() {
+        return dequeueN(DEQUEUE_ALL);
+    }
+};
+
+}}}
+
+#endif /* TS_SHARDED_QUEUE_H_ */
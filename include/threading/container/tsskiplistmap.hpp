@@ -0,0 +1,495 @@
+/*
+ * tsskiplistmap.h
+ * This class creates a thread safe ordered map implementation whose
+ * lookups and range scans never lock.
+ */
+
+#ifndef TS_SKIP_LIST_MAP_H_
+#define TS_SKIP_LIST_MAP_H_
+
+#include <cstddef>
+#include <vector>
+#include <utility>
+#include <functional>
+#include "threading/atomics.hpp"
+
+// Don't listen to warnings about boost on msvc
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(push, 0)
+#endif
+#include <boost/noncopyable.hpp>
+#include <boost/optional.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/thread/mutex.hpp>
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(pop)
+#endif
+
+namespace core { namespace threading { namespace container {
+
+namespace hidden {
+/*
+ * Frees nodes which were unlinked from a lock free structure once no
+ * operation which might still be reading them is running.
+ *
+ * Operations are counted per epoch, in counters spread over cache
+ * lines by thread. A node retired during epoch E can only be reached
+ * by operations which entered in E or before, so it is deleted when
+ * the epoch moves on from E + 1, which needs every operation of E to
+ * have left.
+ *
+ * Not to be used outside of the container implementations.
+ */
+template<typename Node>
+class EpochReclaimer : private boost::noncopyable {
+private:
+    static const std::size_t SLOTS = 16;
+    typedef CacheLinePadded<boost::atomic<std::size_t> > Counter;
+
+    Counter active[2][SLOTS];
+    CacheLinePadded<boost::atomic<boost::uint64_t> > epoch;
+    boost::mutex retireMutex;
+    std::vector<Node *> retired[2];
+
+    static void deleteAll(std::vector<Node *>& nodes) {
+        for (std::size_t i = 0; i < nodes.size(); i++) {
+            delete nodes[i];
+        }
+        nodes.clear();
+    }
+
+    /*
+     * Moves to the next epoch if the previous epoch's operations have
+     * all left. Must be called with retireMutex held.
+     */
+    void tryAdvance() {
+        boost::uint64_t current = epoch.value.load(boost::memory_order_seq_cst);
+        std::size_t previous = (std::size_t)((current + 1) & 1);
+        for (std::size_t slot = 0; slot < SLOTS; slot++) {
+            if (active[previous][slot].value.load(boost::memory_order_seq_cst) != 0) {
+                return;
+            }
+        }
+        deleteAll(retired[previous]);
+        epoch.value.store(current + 1, boost::memory_order_seq_cst);
+    }
+
+public:
+    typedef boost::atomic<std::size_t> *Ticket;
+
+    EpochReclaimer() : retireMutex() {
+        for (std::size_t parity = 0; parity < 2; parity++) {
+            for (std::size_t slot = 0; slot < SLOTS; slot++) {
+                active[parity][slot].value.store(0, boost::memory_order_relaxed);
+            }
+        }
+        epoch.value.store(0, boost::memory_order_release);
+    }
+
+    /* Deletes every retired node. No operation may still be running. */
+    ~EpochReclaimer() {
+        deleteAll(retired[0]);
+        deleteAll(retired[1]);
+    }
+
+    /* Counts the calling thread as reading, until leave is called */
+    Ticket enter() {
+        const std::size_t slot = threadHash() % SLOTS;
+        for (;;) {
+            boost::uint64_t current = epoch.value.load(boost::memory_order_seq_cst);
+            Counter& counter = active[current & 1][slot];
+            counter.value.fetch_add(1, boost::memory_order_seq_cst);
+            // Compare whole epochs, as the parity repeats
+            if (epoch.value.load(boost::memory_order_seq_cst) == current) {
+                return &counter.value;
+            }
+            counter.value.fetch_sub(1, boost::memory_order_seq_cst);
+        }
+    }
+
+    void leave(Ticket ticket) {
+        ticket->fetch_sub(1, boost::memory_order_release);
+    }
+
+    /* Hands over a node which has been unlinked, to delete once safe */
+    void retire(Node *node) {
+        boost::mutex::scoped_lock lock(retireMutex);
+        retired[epoch.value.load(boost::memory_order_seq_cst) & 1].push_back(node);
+        tryAdvance();
+    }
+};
+}
+
+/*
+ * TSSkipListMap implements a boost::thread safe ordered map as a lazy
+ * skip list. Lookups, lowerBound and range scans never lock, and only
+ * write an operation counter which a few threads hash to, so they
+ * never block writers and writers never block them. Inserts and
+ * erases lock only the handful of nodes they relink.
+ *
+ * An entry is visible once it is linked on every level, and is gone
+ * as soon as an erase marks it. Scans are weakly consistent: entries
+ * inserted or erased during a scan may or may not be seen, but every
+ * entry present throughout the scan is seen exactly once, in order.
+ *
+ * Entries can't be changed once inserted, since lock free readers may
+ * be copying them; erase and insert again to replace one. Erased
+ * nodes are freed once no running operation can still reach them.
+ */
+template <typename Key, typename Value, typename Compare = std::less<Key> >
+class TSSkipListMap : private boost::noncopyable {
+public:
+    typedef Key KeyType;
+    typedef Value ValueType;
+    typedef std::pair<Key, Value> EntryType;
+
+private:
+    // Enough levels for tens of millions of entries
+    static const int MAX_LEVEL = 24;
+
+    struct Node {
+        // Empty for the head node only
+        const boost::optional<EntryType> entry;
+        const int topLevel;
+        boost::atomic<Node *> *next;
+        boost::atomic<bool> marked;
+        boost::atomic<bool> fullyLinked;
+        boost::mutex mutex;
+
+        Node(const boost::optional<EntryType>& nodeEntry, int level) :
+            entry(nodeEntry), topLevel(level), next(new boost::atomic<Node *>[level + 1]), mutex() {
+            for (int i = 0; i <= level; i++) {
+                next[i].store(NULL, boost::memory_order_relaxed);
+            }
+            marked.store(false, boost::memory_order_relaxed);
+            fullyLinked.store(false, boost::memory_order_relaxed);
+        }
+        ~Node() {
+            delete[] next;
+        }
+
+        const Key& key() const {
+            return entry->first;
+        }
+    };
+
+    typedef hidden::EpochReclaimer<Node> Reclaimer;
+
+    /* Counts the calling thread as reading for its lifetime */
+    class Operation : private boost::noncopyable {
+    private:
+        Reclaimer& reclaimer;
+        const typename Reclaimer::Ticket ticket;
+    public:
+        explicit Operation(Reclaimer& nodeReclaimer) :
+            reclaimer(nodeReclaimer), ticket(nodeReclaimer.enter()) {}
+        ~Operation() {
+            reclaimer.leave(ticket);
+        }
+    };
+
+    Node *const head;
+    Compare less;
+    CacheLinePadded<boost::atomic<std::size_t> > count;
+    CacheLinePadded<boost::atomic<boost::uint32_t> > randomState;
+    mutable Reclaimer reclaimer;
+
+    /* Returns a level with probability halving at each step up */
+    int randomLevel() {
+        boost::uint32_t x = randomState.value.load(boost::memory_order_relaxed);
+        // Races between inserters only repeat a level, so the state
+        // needn't be updated atomically
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        randomState.value.store(x, boost::memory_order_relaxed);
+        int level = 0;
+        while ((x & 1) != 0 && level < MAX_LEVEL - 1) {
+            level++;
+            x >>= 1;
+        }
+        return level;
+    }
+
+    /*
+     * Fills preds and succs with the nodes either side of key on each
+     * level, and returns the highest level key was found on, or -1.
+     */
+    int findNode(const Key& key, Node *preds[], Node *succs[]) const {
+        int found = -1;
+        Node *pred = head;
+        for (int level = MAX_LEVEL - 1; level >= 0; level--) {
+            Node *curr = pred->next[level].load(boost::memory_order_acquire);
+            while (curr != NULL && less(curr->key(), key)) {
+                pred = curr;
+                curr = pred->next[level].load(boost::memory_order_acquire);
+            }
+            if (found == -1 && curr != NULL && !less(key, curr->key())) {
+                found = level;
+            }
+            preds[level] = pred;
+            succs[level] = curr;
+        }
+        return found;
+    }
+
+    /* Returns the first node whose key isn't less than key, or NULL */
+    Node *lowerBoundNode(const Key& key) const {
+        Node *pred = head;
+        Node *curr = NULL;
+        for (int level = MAX_LEVEL - 1; level >= 0; level--) {
+            curr = pred->next[level].load(boost::memory_order_acquire);
+            while (curr != NULL && less(curr->key(), key)) {
+                pred = curr;
+                curr = pred->next[level].load(boost::memory_order_acquire);
+            }
+        }
+        return curr;
+    }
+
+    static bool isLive(const Node *node) {
+        return node->fullyLinked.load(boost::memory_order_acquire) &&
+               !node->marked.load(boost::memory_order_acquire);
+    }
+
+    /* Unlocks the distinct nodes among preds[0..highestLocked] */
+    static void unlockPreds(Node *preds[], int highestLocked) {
+        Node *prevPred = NULL;
+        for (int level = 0; level <= highestLocked; level++) {
+            if (preds[level] != prevPred) {
+                preds[level]->mutex.unlock();
+                prevPred = preds[level];
+            }
+        }
+    }
+
+public:
+    explicit TSSkipListMap(const Compare& compare = Compare()) :
+        head(new Node(boost::none, MAX_LEVEL - 1)), less(compare), reclaimer() {
+        count.value.store(0, boost::memory_order_relaxed);
+        randomState.value.store(0x9E3779B9u, boost::memory_order_relaxed);
+        head->fullyLinked.store(true, boost::memory_order_release);
+    }
+
+    /*
+     * Frees every node. No other thread may be using the map by this
+     * point.
+     */
+    ~TSSkipListMap() {
+        Node *node = head;
+        while (node != NULL) {
+            Node *next = node->next[0].load(boost::memory_order_relaxed);
+            delete node;
+            node = next;
+        }
+    }
+
+    /*
+     * Copies the value for key into value without locking. Returns
+     * false, leaving value alone, if the key isn't in the map.
+     */
+    bool find(const Key& key, Value& value) const {
+        Operation operation(reclaimer);
+        Node *node = lowerBoundNode(key);
+        if (node == NULL || less(key, node->key()) || !isLive(node)) {
+            return false;
+        }
+        value = node->entry->second;
+        return true;
+    }
+
+    /* Returns true if the key is in the map, without locking */
+    bool contains(const Key& key) const {
+        Operation operation(reclaimer);
+        Node *node = lowerBoundNode(key);
+        return node != NULL && !less(key, node->key()) && isLive(node);
+    }
+
+    /*
+     * Copies the first entry whose key isn't less than key into entry,
+     * without locking. Returns false if there is no such entry.
+     */
+    bool lowerBound(const Key& key, EntryType& entry) const {
+        Operation operation(reclaimer);
+        for (Node *node = lowerBoundNode(key); node != NULL;
+                node = node->next[0].load(boost::memory_order_acquire)) {
+            if (isLive(node)) {
+                entry = *node->entry;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /*
+     * Calls functor(const EntryType&) on every entry with a key in
+     * [from, to), in key order, without locking. Writers carry on
+     * while the scan runs.
+     */
+    template<typename Functor>
+    Functor forEachInRange(const Key& from, const Key& to, Functor functor) const {
+        Operation operation(reclaimer);
+        for (Node *node = lowerBoundNode(from); node != NULL && less(node->key(), to);
+                node = node->next[0].load(boost::memory_order_acquire)) {
+            if (isLive(node)) {
+                functor(*node->entry);
+            }
+        }
+        return functor;
+    }
+
+    /* As forEachInRange, over every entry in the map */
+    template<typename Functor>
+    Functor forEachEntry(Functor functor) const {
+        Operation operation(reclaimer);
+        for (Node *node = head->next[0].load(boost::memory_order_acquire); node != NULL;
+                node = node->next[0].load(boost::memory_order_acquire)) {
+            if (isLive(node)) {
+                functor(*node->entry);
+            }
+        }
+        return functor;
+    }
+
+    /*
+     * Adds the key with the given value. Returns false, leaving the
+     * existing value alone, if the key was already in the map.
+     */
+    bool insert(const Key& key, const Value& value) {
+        Operation operation(reclaimer);
+        const int topLevel = randomLevel();
+        // Built before any locks are taken, so a throwing copy can't
+        // leave predecessors locked
+        Node *node = new Node(EntryType(key, value), topLevel);
+        Node *preds[MAX_LEVEL];
+        Node *succs[MAX_LEVEL];
+        try {
+            for (;;) {
+                int found = findNode(key, preds, succs);
+                if (found != -1) {
+                    Node *existing = succs[found];
+                    if (!existing->marked.load(boost::memory_order_acquire)) {
+                        // Wait for a concurrent insert of the key to finish
+                        while (!existing->fullyLinked.load(boost::memory_order_acquire)) {
+                            cpuRelax();
+                        }
+                        delete node;
+                        return false;
+                    }
+                    // The key is being erased, so try again once it's gone
+                    continue;
+                }
+                // Lock the predecessors bottom up, and check nothing changed
+                int highestLocked = -1;
+                bool valid = true;
+                Node *prevPred = NULL;
+                for (int level = 0; valid && level <= topLevel; level++) {
+                    Node *pred = preds[level];
+                    Node *succ = succs[level];
+                    if (pred != prevPred) {
+                        pred->mutex.lock();
+                        highestLocked = level;
+                        prevPred = pred;
+                    }
+                    valid = !pred->marked.load(boost::memory_order_acquire) &&
+                            (succ == NULL || !succ->marked.load(boost::memory_order_acquire)) &&
+                            pred->next[level].load(boost::memory_order_acquire) == succ;
+                }
+                if (!valid) {
+                    unlockPreds(preds, highestLocked);
+                    continue;
+                }
+                for (int level = 0; level <= topLevel; level++) {
+                    node->next[level].store(succs[level], boost::memory_order_relaxed);
+                }
+                for (int level = 0; level <= topLevel; level++) {
+                    preds[level]->next[level].store(node, boost::memory_order_release);
+                }
+                node->fullyLinked.store(true, boost::memory_order_release);
+                unlockPreds(preds, highestLocked);
+                count.value.fetch_add(1, boost::memory_order_relaxed);
+                return true;
+            }
+        } catch (...) {
+            // Only the comparator can throw here, before anything is locked
+            delete node;
+            throw;
+        }
+    }
+
+    /* Removes the key. Returns false if it wasn't in the map. */
+    bool erase(const Key& key) {
+        Operation operation(reclaimer);
+        Node *preds[MAX_LEVEL];
+        Node *succs[MAX_LEVEL];
+        Node *victim = NULL;
+        for (;;) {
+            int found = findNode(key, preds, succs);
+            if (victim == NULL) {
+                if (found == -1) {
+                    return false;
+                }
+                Node *candidate = succs[found];
+                // Only erase nodes which are fully inserted, and found
+                // at their top level so preds covers every level
+                if (!candidate->fullyLinked.load(boost::memory_order_acquire) ||
+                        candidate->topLevel != found) {
+                    if (candidate->marked.load(boost::memory_order_acquire)) {
+                        return false;
+                    }
+                    continue;
+                }
+                candidate->mutex.lock();
+                if (candidate->marked.load(boost::memory_order_acquire)) {
+                    candidate->mutex.unlock();
+                    return false;
+                }
+                // Marking is the point the entry disappears
+                candidate->marked.store(true, boost::memory_order_release);
+                victim = candidate;
+            }
+            int highestLocked = -1;
+            bool valid = true;
+            Node *prevPred = NULL;
+            for (int level = 0; valid && level <= victim->topLevel; level++) {
+                Node *pred = preds[level];
+                if (pred != prevPred) {
+                    pred->mutex.lock();
+                    highestLocked = level;
+                    prevPred = pred;
+                }
+                valid = !pred->marked.load(boost::memory_order_acquire) &&
+                        pred->next[level].load(boost::memory_order_acquire) == victim;
+            }
+            if (!valid) {
+                unlockPreds(preds, highestLocked);
+                continue;
+            }
+            for (int level = victim->topLevel; level >= 0; level--) {
+                preds[level]->next[level].store(victim->next[level].load(boost::memory_order_acquire),
+                                                boost::memory_order_release);
+            }
+            victim->mutex.unlock();
+            unlockPreds(preds, highestLocked);
+            count.value.fetch_sub(1, boost::memory_order_relaxed);
+            reclaimer.retire(victim);
+            return true;
+        }
+    }
+
+    /*
+     * Returns the number of entries. Concurrent inserts and erases
+     * may or may not be counted yet.
+     */
+    std::size_t size() const {
+        return count.value.load(boost::memory_order_relaxed);
+    }
+
+    /* Returns true if the map has no entries */
+    bool empty() const {
+        return size() == 0;
+    }
+};
+
+}}}
+#endif /* TS_SKIP_LIST_MAP_H_ */
@@ -0,0 +1,252 @@
+/*
+ * tsspscqueue.h
+ * This class creates a wait-free single producer/single consumer queue
+ * implementation.
+ */
+
+#ifndef TS_SPSC_QUEUE_H_
+#define TS_SPSC_QUEUE_H_
+
+#include <cstddef>
+#include <algorithm>
+#include "threading/atomics.hpp"
+
+// Don't listen to warnings about boost on msvc
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(push, 0)
+#endif
+#include <boost/noncopyable.hpp>
+#include <boost/static_assert.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/type_traits/aligned_storage.hpp>
+#include <boost/type_traits/alignment_of.hpp>
+#include <boost/move/move.hpp>
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(pop)
+#endif
+
+namespace core { namespace threading { namespace container {
+
+/*
+ * TSSpscQueue implements a bounded queue for exactly one producer
+ * thread feeding exactly one consumer thread. Every call finishes
+ * in a bounded number of steps without locks or read-modify-write
+ * atomics: the producer only writes the tail index and the consumer
+ * only writes the head index. Each side keeps a private cached copy
+ * of the other side's index on its own cache line, so the shared
+ * indices are only reloaded when the cached copy says the queue
+ * looks full (or empty).
+ *
+ * enqueue/enqueueN may only be called from the producer thread and
+ * dequeue/dequeueN/dequeueAll/clear only from the consumer thread.
+ * Capacity must be a power of two.
+ */
+template <typename T, std::size_t Capacity>
+class TSSpscQueue : private boost::noncopyable {
+private:
+    BOOST_STATIC_ASSERT(Capacity >= 2);
+    BOOST_STATIC_ASSERT((Capacity & (Capacity - 1)) == 0);
+
+    typedef boost::atomic<std::size_t> Index;
+    typedef typename boost::aligned_storage<sizeof(T), boost::alignment_of<T>::value>::type Storage;
+
+    struct ProducerSide {
+        Index tail;
+        std::size_t cachedHead;
+    };
+    struct ConsumerSide {
+        Index head;
+        std::size_t cachedTail;
+    };
+
+    static const std::size_t mask = Capacity - 1;
+
+    boost::scoped_array<Storage> slots;
+    CacheLinePadded<ProducerSide> producer;
+    CacheLinePadded<ConsumerSide> consumer;
+
+    T *element(std::size_t index) {
+        return static_cast<T *>(static_cast<void *>(&slots[index & mask]));
+    }
+
+    /*
+     * Returns the number of free slots as seen by the producer,
+     * refreshing the cached head only when needed.
+     */
+    std::size_t producerFree(std::size_t tail, std::size_t wanted) {
+        std::size_t free = Capacity - (tail - producer.value.cachedHead);
+        if (free < wanted) {
+            producer.value.cachedHead = consumer.value.head.load(boost::memory_order_acquire);
+            free = Capacity - (tail - producer.value.cachedHead);
+        }
+        return free;
+    }
+
+    /*
+     * Returns the number of readable slots as seen by the consumer,
+     * refreshing the cached tail only when needed.
+     */
+    std::size_t consumerAvailable(std::size_t head, std::size_t wanted) {
+        std::size_t available = consumer.value.cachedTail - head;
+        if (available < wanted) {
+            consumer.value.cachedTail = producer.value.tail.load(boost::memory_order_acquire);
+            available = consumer.value.cachedTail - head;
+        }
+        return available;
+    }
+
+public:
+    typedef T ElemType;
+
+    TSSpscQueue() : slots(new Storage[Capacity]), producer(), consumer() {
+        producer.value.tail.store(0, boost::memory_order_relaxed);
+        producer.value.cachedHead = 0;
+        consumer.value.cachedTail = 0;
+        consumer.value.head.store(0, boost::memory_order_release);
+    }
+
+    /*
+     * Ensure that all remaining elements have their destructors
+     * called.
+     */
+    ~TSSpscQueue() {
+        clear();
+    }
+
+    /* Returns the maximum number of elements the queue can hold */
+    static std::size_t capacity() {
+        return Capacity;
+    }
+
+    /*
+     * Returns the size of the queue. This is only a snapshot when
+     * the other thread is actively using the queue.
+     */
+    std::size_t size() const {
+        std::size_t head = consumer.value.head.load(boost::memory_order_acquire);
+        std::size_t tail = producer.value.tail.load(boost::memory_order_acquire);
+        return tail - head;
+    }
+
+    /* Returns true if the queue is (momentarily) empty */
+    bool empty() const {
+        return size() == 0;
+    }
+
+    /* Clears all queue elements from the queue (consumer only) */
+    void clear() {
+        std::size_t head = consumer.value.head.load(boost::memory_order_relaxed);
+        std::size_t tail = producer.value.tail.load(boost::memory_order_acquire);
+        for (std::size_t index = head; index != tail; index++) {
+            element(index)->~T();
+        }
+        consumer.value.cachedTail = tail;
+        consumer.value.head.store(tail, boost::memory_order_release);
+    }
+
+    /*
+     * Enqueues a copy of the element into the queue (producer only).
+     * Returns false without blocking if the queue is full.
+     */
+    bool enqueue(const T& enq) {
+        std::size_t tail = producer.value.tail.load(boost::memory_order_relaxed);
+        if (producerFree(tail, 1) == 0) {
+            return false;
+        }
+        new (element(tail)) T(enq);
+        producer.value.tail.store(tail + 1, boost::memory_order_release);
+        return true;
+    }
+
+    /*
+     * Enqueues elements from the input range until the range is
+     * exhausted or the queue fills (producer only). All of the
+     * elements are published to the consumer at once. Returns the
+     * number enqueued. If a copy throws, the elements already built
+     * are destroyed and nothing is enqueued.
+     */
+    template<typename InputIterator>
+    std::size_t enqueueN(InputIterator first, InputIterator last) {
+        std::size_t tail = producer.value.tail.load(boost::memory_order_relaxed);
+        std::size_t free = producerFree(tail, Capacity);
+        std::size_t count = 0;
+        try {
+            for (; count < free && first != last; ++first) {
+                new (element(tail + count)) T(*first);
+                count++;
+            }
+        } catch (...) {
+            // None of these were published, so the consumer can't see them
+            while (count > 0) {
+                count--;
+                element(tail + count)->~T();
+            }
+            throw;
+        }
+        if (count > 0) {
+            producer.value.tail.store(tail + count, boost::memory_order_release);
+        }
+        return count;
+    }
+
+    /*
+     * Dequeues an element off of the front of the queue into deq
+     * (consumer only). Returns false without blocking if the queue
+     * is empty.
+     */
+    bool dequeue(T& deq) {
+        std::size_t head = consumer.value.head.load(boost::memory_order_relaxed);
+        if (consumerAvailable(head, 1) == 0) {
+            return false;
+        }
+        T *elem = element(head);
+        deq = boost::move(*elem);
+        elem->~T();
+        consumer.value.head.store(head + 1, boost::memory_order_release);
+        return true;
+    }
+
+    /*
+     * Dequeues up to N items from the queue at once, writing them
+     * to the output iterator (consumer only). The slots are handed
+     * back to the producer all at once. Returns the number dequeued.
+     * If writing an element throws, the elements before it stay
+     * dequeued and the rest stay in the queue.
+     */
+    template<typename OutputIterator>
+    std::size_t dequeueN(OutputIterator out, std::size_t numDequeue) {
+        std::size_t head = consumer.value.head.load(boost::memory_order_relaxed);
+        std::size_t count = std::min(numDequeue, consumerAvailable(head, numDequeue));
+        std::size_t index = head;
+        try {
+            for (; index != head + count; index++) {
+                T *elem = element(index);
+                *out = boost::move(*elem);
+                ++out;
+                elem->~T();
+            }
+        } catch (...) {
+            // Hand back only the slots whose elements were destroyed
+            consumer.value.head.store(index, boost::memory_order_release);
+            throw;
+        }
+        if (count > 0) {
+            consumer.value.head.store(head + count, boost::memory_order_release);
+        }
+        return count;
+    }
+
+    /*
+     * Dequeues all items currently in the queue at once, writing
+     * them to the output iterator (consumer only). Returns the number
+     * dequeued.
+     */
+    template<typename OutputIterator>
+    std::size_t dequeueAll(OutputIterator out) {
+        return dequeueN(out, Capacity);
+    }
+};
+
+}}}
+
+#endif /* TS_SPSC_QUEUE_H_ */
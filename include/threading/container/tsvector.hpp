@@ -7,13 +7,19 @@
 #define TSVECTOR_H_
 
 #include <vector>
+#include <algorithm>
 #include "tswrapper.hpp"
+#include "pointers.hpp"
+#include "threading/thread.hpp"
 
 // Don't listen to warnings about boost on msvc
 #if defined(_MSC_VER) && (_MSC_VER >= 1500)
 #   pragma warning(push, 0)
 #endif
 #include <boost/thread.hpp>
+#include <boost/bind.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/exception_ptr.hpp>
 #if defined(_MSC_VER) && (_MSC_VER >= 1500)
 #   pragma warning(pop)
 #endif
@@ -25,20 +31,156 @@ namespace core { namespace threading { namespace container {
  * The implementation uses a wrapped vector for all calls. A
  * limited number of base calls are available without retrieving
  * a locked reference of the vector.
+ *
+ * To work on every element, prefer forEachShared, snapshot and
+ * transformInPlace over a locked reference. Each takes the lock once,
+ * for no longer than the loop itself, and the parallel variants split
+ * the loop across worker threads to shorten the hold further. Their
+ * functors run while the vector is locked (except for
+ * forEachSharedParallel), so they must not call back into the vector,
+ * which can deadlock against a waiting writer.
+ *
+ * The Lock may be any lock accepted by TSReadWriteWrapper. Vectors
+ * which are read from many cores at once can use a
+ * DistributedReadWriteConditionLock.
  */
-template <typename T, typename Alloc = std::allocator<T> >
-class TSVector : public TSReadWriteWrapper<std::vector<T, Alloc> > {
+template <typename T, typename Alloc = std::allocator<T>,
+          typename Lock = CORE_PROFILED_READ_WRITE_LOCK(ReadWriteConditionLock)>
+class TSVector : public TSReadWriteWrapper<std::vector<T, Alloc>, Lock> {
 private:
     // Class renaming for readability
     typedef std::vector<T, Alloc> VectorType;
     typedef boost::shared_ptr<VectorType> VectorTypePtr;
-    typedef TSReadWriteWrapper<VectorType> Vector;
+    typedef TSReadWriteWrapper<VectorType, Lock> Vector;
     typedef typename Vector::ScopedLock ScopedLock;
     typedef typename Vector::SharedScopedLock SharedScopedLock;
 
     // Assignment operator is not made, because all lockable objects
     // are non-copyable.
 
+    /*
+     * Applies copies of a functor to ranges of elements on worker
+     * threads. The workers are started on construction and wait for
+     * run, so a caller can create them before taking the vector's
+     * lock and destroy them, joining the threads, after releasing it.
+     * Exceptions thrown by the functor are rethrown from run.
+     */
+    template<typename Iterator, typename Functor>
+    class ParallelApply : private boost::noncopyable {
+    private:
+        struct Task {
+            Iterator first;
+            Iterator last;
+            boost::exception_ptr error;
+        };
+
+        const Functor functor;
+        std::vector<Task> tasks;
+        boost::mutex mutex;
+        boost::condition_variable changed;
+        bool released;
+        bool cancelled;
+        std::size_t remaining;
+        pointers::lists<Thread>::PtrVector workers;
+
+        static void apply(Task& task, const Functor& functor) {
+            try {
+                std::for_each(task.first, task.last, functor);
+            } catch (...) {
+                task.error = boost::current_exception();
+            }
+        }
+
+        void work(std::size_t index) {
+            {
+                boost::unique_lock<boost::mutex> lock(mutex);
+                while (!released && !cancelled) {
+                    changed.wait(lock);
+                }
+                if (cancelled) {
+                    return;
+                }
+            }
+            apply(tasks[index], functor);
+            boost::lock_guard<boost::mutex> lock(mutex);
+            if (--remaining == 0) {
+                changed.notify_all();
+            }
+        }
+
+        void joinAll() {
+            {
+                boost::lock_guard<boost::mutex> lock(mutex);
+                if (!released) {
+                    cancelled = true;
+                }
+                changed.notify_all();
+            }
+            for (std::size_t i = 0; i < workers.size(); i++) {
+                workers[i].join();
+            }
+        }
+
+    public:
+        /* Starts numThreads - 1 workers, the caller being the last */
+        ParallelApply(const Functor& func, std::size_t numThreads) :
+            functor(func), tasks(numThreads), mutex(), changed(),
+            released(false), cancelled(false), remaining(0), workers() {
+            try {
+                for (std::size_t i = 0; i + 1 < numThreads; i++) {
+                    workers.push_back(new Thread(boost::bind(&ParallelApply::work, this, i)));
+                }
+            } catch (...) {
+                joinAll();
+                throw;
+            }
+        }
+
+        ~ParallelApply() {
+            joinAll();
+        }
+
+        /*
+         * Splits [first, last) between the workers and the calling
+         * thread, and returns once every range is done. May only be
+         * called once.
+         */
+        void run(Iterator first, Iterator last) {
+            std::size_t count = last - first;
+            std::size_t chunk = count / tasks.size();
+            std::size_t extra = count % tasks.size();
+            Iterator start = first;
+            for (std::size_t i = 0; i < tasks.size(); i++) {
+                tasks[i].first = start;
+                start += chunk + (i < extra ? 1 : 0);
+                tasks[i].last = start;
+            }
+            {
+                boost::lock_guard<boost::mutex> lock(mutex);
+                released = true;
+                remaining = workers.size();
+                changed.notify_all();
+            }
+            apply(tasks.back(), functor);
+            {
+                boost::unique_lock<boost::mutex> lock(mutex);
+                while (remaining > 0) {
+                    changed.wait(lock);
+                }
+            }
+            for (std::size_t i = 0; i < tasks.size(); i++) {
+                if (tasks[i].error) {
+                    boost::rethrow_exception(tasks[i].error);
+                }
+            }
+        }
+    };
+
+    static std::size_t defaultThreadCount() {
+        std::size_t count = boost::thread::hardware_concurrency();
+        return count > 0 ? count : 1;
+    }
+
 public:
     explicit TSVector(int priority = 0) : Vector(priority) {}
     explicit TSVector(VectorType& other, int priority = 0) : Vector(priority) {
@@ -67,6 +209,78 @@ public:
         clear();
     }
 
+    /*
+     * Calls functor(const T&) on every element under one read lock,
+     * and returns the functor as std::for_each does.
+     */
+    template<typename Functor>
+    Functor forEachShared(Functor functor) const {
+        SharedScopedLock lock(this->getMutex());
+        return std::for_each(this->wrapped->begin(), this->wrapped->end(), functor);
+    }
+
+    /*
+     * As forEachShared, but works on a snapshot of the elements, split
+     * across numThreads threads which each call their own copy of the
+     * functor. The read lock is only held to take the snapshot. The
+     * functor must be safe to run concurrently, and the first
+     * exception it throws is rethrown once every thread finishes.
+     */
+    template<typename Functor>
+    void forEachSharedParallel(Functor functor, std::size_t numThreads = defaultThreadCount()) const {
+        VectorType copy;
+        snapshot(copy);
+        if (numThreads > copy.size()) {
+            numThreads = copy.size();
+        }
+        if (numThreads <= 1) {
+            std::for_each(copy.begin(), copy.end(), functor);
+            return;
+        }
+        ParallelApply<typename VectorType::const_iterator, Functor> parallel(functor, numThreads);
+        parallel.run(copy.begin(), copy.end());
+    }
+
+    /*
+     * Copies every element into buffer under one short read lock.
+     * The buffer's contents are replaced, but its capacity is reused,
+     * so repeated snapshots into the same buffer don't allocate.
+     */
+    void snapshot(VectorType& buffer) const {
+        SharedScopedLock lock(this->getMutex());
+        buffer.assign(this->wrapped->begin(), this->wrapped->end());
+    }
+
+    /*
+     * Calls functor(T&) on every element under one write lock, so the
+     * elements can be changed in place.
+     */
+    template<typename Functor>
+    Functor transformInPlace(Functor functor) {
+        ScopedLock lock(this->getMutex());
+        return std::for_each(this->wrapped->begin(), this->wrapped->end(), functor);
+    }
+
+    /*
+     * As transformInPlace, but the elements are split across
+     * numThreads threads, each calling its own copy of the functor.
+     * The threads are started before the write lock is taken and
+     * joined after it is released, so only the work itself is done
+     * under the lock. The functor must be safe to run concurrently on
+     * different elements, and the first exception it throws is
+     * rethrown once every thread finishes.
+     */
+    template<typename Functor>
+    void transformInPlaceParallel(Functor functor, std::size_t numThreads = defaultThreadCount()) {
+        if (numThreads <= 1) {
+            transformInPlace(functor);
+            return;
+        }
+        ParallelApply<typename VectorType::iterator, Functor> parallel(functor, numThreads);
+        ScopedLock lock(this->getMutex());
+        parallel.run(this->wrapped->begin(), this->wrapped->end());
+    }
+
     /* Returns the total capacity of the vector */
     std::size_t capacity() const {
         SharedScopedLock lock(this->getMutex());
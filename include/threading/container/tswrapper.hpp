@@ -8,6 +8,7 @@
 
 #include "threading/lockable.hpp"
 #include "threading/condition_lockable.hpp"
+#include "threading/lock_profiler.hpp"
 #include "pointers.hpp"
 
 // Don't listen to warnings about boost on msvc
@@ -16,6 +17,7 @@
 #endif
 #include <boost/thread.hpp>
 #include <boost/smart_ptr.hpp>
+#include <boost/core/null_deleter.hpp>
 #include <boost/interprocess/sync/scoped_lock.hpp>
 #if defined(_MSC_VER) && (_MSC_VER >= 1500)
 #   pragma warning(pop)
@@ -42,6 +44,21 @@ public:
     explicit LockableWrappedContents(Wrapped& other, int priority) :
         wrapped(new Wrapped(other)), mutex(new Mutex(priority)) {}
 };
+
+/*
+ * Tracks a thread parked on a container condition for the lifetime
+ * of the object, so notifiers can skip waking when nobody waits.
+ * Must be used while the container mutex is held.
+ *
+ * Not to be used outside of the container implementations.
+ */
+class ParkedWaiter : private boost::noncopyable {
+private:
+    std::size_t& waiting;
+public:
+    explicit ParkedWaiter(std::size_t& waitCount) : waiting(waitCount) { waiting++; }
+    ~ParkedWaiter() { waiting--; }
+};
 }
 
 /*
@@ -51,10 +68,15 @@ public:
  * which is scope locked for the duration of the lockedReference
  * lifetime.
  *
+ * The Lock may be any Lockable which is also a Condition. Use a
+ * SpinConditionLock when the critical sections on the wrapped object
+ * are very short. The default lock is profiled when CORE_LOCK_PROFILING
+ * is defined.
+ *
  * Inheritance ordering matters here!
  */
-template<typename Wrapped>
-class TSWrapper : public hidden::LockableWrappedContents<Wrapped, ConditionLock>,
+template<typename Wrapped, typename Lock = CORE_PROFILED_LOCK(ConditionLock)>
+class TSWrapper : public hidden::LockableWrappedContents<Wrapped, Lock>,
     public ConditionLockProxy {
 private:
     /*
@@ -74,8 +96,9 @@ public:
     // For public use in identifying the underlying wrapped class
     typedef Wrapped WrapperType;
     typedef LockedConditionReferencePtr<Wrapped> LockedWrapper;
-    typedef ConditionLock LockType;
-    typedef ConditionLock Condition;
+    typedef Lock LockType;
+    typedef Lock Condition;
+    typedef ScopedLockedConditionReference<Wrapped, LockType> ScopedLockedWrapper;
     typedef boost::interprocess::scoped_lock<LockType> ScopedLock;
 
     explicit TSWrapper(int priority = 0) :
@@ -90,6 +113,15 @@ public:
         return ConditionLockProxy::generateLockedConditionReference(this->wrapped);
     }
 
+    /*
+     * As generateLockedConditionReference, but the reference lives on
+     * the stack and locks the wrapper's lock directly. It can be moved
+     * but not copied, and must not outlive the wrapper.
+     */
+    ScopedLockedWrapper generateScopedLockedReference() {
+        return ScopedLockedWrapper(*this->wrapped, *this->mutex, *this->mutex);
+    }
+
     /*
      * Gives the condition variable for this wrapper without any
      * lock or unlock calls.
@@ -112,9 +144,13 @@ public:
  * class use the locked reference from generateLockedReference()
  * which is scope locked for the duration of the lockedReference
  * lifetime. This Wrapper support read locked references.
+ *
+ * The Lock may be any ReadWriteLockable which is also a Condition,
+ * such as a ReadWriteSpinConditionLock. The default lock is profiled
+ * when CORE_LOCK_PROFILING is defined.
  */
-template <typename Wrapped>
-class TSReadWriteWrapper : public hidden::LockableWrappedContents<Wrapped, ReadWriteConditionLock>,
+template <typename Wrapped, typename Lock = CORE_PROFILED_READ_WRITE_LOCK(ReadWriteConditionLock)>
+class TSReadWriteWrapper : public hidden::LockableWrappedContents<Wrapped, Lock>,
     public ReadWriteConditionLockProxy {
 private:
     /*
@@ -124,7 +160,7 @@ private:
      * is fine though, because we know no objects are making other
      * calls during construction.
      */
-    TSReadWriteWrapper<Wrapped>& operator =(const TSReadWriteWrapper<Wrapped>& other) {
+    TSReadWriteWrapper& operator =(const TSReadWriteWrapper& other) {
         return *this;
     }
 
@@ -133,8 +169,10 @@ public:
     typedef Wrapped WrapperType;
     typedef LockedConditionReadableReferencePtr<Wrapped> LockedWrapper;
     typedef ReadLockedReferencePtr<Wrapped> ReadLockedWrapper;
-    typedef ReadWriteConditionLock LockType;
-    typedef ReadWriteConditionLock Condition;
+    typedef Lock LockType;
+    typedef Lock Condition;
+    typedef ScopedLockedConditionReference<Wrapped, LockType> ScopedLockedWrapper;
+    typedef ScopedReadLockedReference<Wrapped, LockType> ScopedReadLockedWrapper;
     typedef boost::interprocess::scoped_lock<LockType> ScopedLock;
     typedef boost::shared_lock<LockType> SharedScopedLock;
 
@@ -153,6 +191,24 @@ public:
     ReadLockedWrapper generateReadLockedReference() {
         return ReadWriteConditionLockProxy::generateReadLockedReference<Wrapped>(this->wrapped);
     }
+
+    /*
+     * As generateLockedReference, but the reference lives on the
+     * stack and locks the wrapper's lock directly. It can be moved
+     * but not copied, and must not outlive the wrapper.
+     */
+    ScopedLockedWrapper generateScopedLockedReference() {
+        return ScopedLockedWrapper(*this->wrapped, *this->mutex, *this->mutex);
+    }
+
+    /*
+     * As generateScopedLockedReference, but takes a shared (read) lock
+     * and only gives const access to the wrapped object.
+     */
+    ScopedReadLockedWrapper generateScopedReadLockedReference() {
+        return ScopedReadLockedWrapper(*this->wrapped, *this->mutex);
+    }
+
     /*
      * Gives the condition variable for this wrapper without any
      * lock or unlock calls.
@@ -169,6 +225,231 @@ public:
     }
 };
 
+/*
+ * A wrapper on a particular object whose mutex type is fixed at
+ * compile time. The object, the mutex, a condition variable and a
+ * Lockable adapter of the mutex are all stored inline, so building
+ * one doesn't allocate and every lock and unlock is a direct (and
+ * usually inlined) call rather than a virtual call through a shared
+ * Lockable pointer. The Mutex may be any boost Lockable, such as a
+ * boost::mutex or a SpinMutex.
+ *
+ * To work on the object construct a LockedWrapper on the wrapper,
+ * which holds the lock for the lifetime of the LockedWrapper.
+ *
+ * getLockablePtr gives a non-owning pointer to the adapter for use
+ * with a ResourceLocker. It doesn't keep the wrapper alive, so the
+ * locker must not outlive the wrapper.
+ */
+template<typename Wrapped, typename Mutex = boost::mutex>
+class TSStaticWrapper : private boost::noncopyable {
+public:
+    // For public use in identifying the underlying wrapped class
+    typedef Wrapped WrapperType;
+    typedef Mutex LockType;
+    typedef boost::condition_variable_any Condition;
+    typedef boost::interprocess::scoped_lock<LockType> ScopedLock;
+    typedef MutexLockableAdapter<LockType> Adapter;
+
+protected:
+    Wrapped wrapped;
+    mutable LockType mutex;
+    Condition condition;
+    mutable Adapter adapter;
+
+public:
+    /*
+     * Scope locks the wrapper and gives access to the wrapped
+     * object until it goes out of scope.
+     */
+    class LockedWrapper : private boost::noncopyable {
+    private:
+        TSStaticWrapper& owner;
+        ScopedLock lock;
+
+    public:
+        explicit LockedWrapper(TSStaticWrapper& wrapper) :
+            owner(wrapper), lock(wrapper.mutex) {}
+
+        Wrapped& operator *() const {
+            return owner.wrapped;
+        }
+
+        Wrapped *operator ->() const {
+            return &owner.wrapped;
+        }
+
+        Wrapped *get() const {
+            return &owner.wrapped;
+        }
+
+        /* Releases the lock until the wrapper condition is notified */
+        void wait() {
+            owner.condition.wait(lock);
+        }
+
+        /*
+         * As wait, but gives up at the deadline. Returns false on
+         * timeout.
+         */
+        bool timedWait(const boost::system_time& deadline) {
+            return owner.condition.timed_wait(lock, deadline);
+        }
+    };
+
+    explicit TSStaticWrapper(int priority = 0) :
+        wrapped(), mutex(), condition(),
+        adapter(mutex, priority) {}
+    explicit TSStaticWrapper(const Wrapped& other, int priority = 0) :
+        wrapped(other), mutex(), condition(),
+        adapter(mutex, priority) {}
+
+    /*
+     * Gives the condition variable for this wrapper without any
+     * lock or unlock calls.
+     */
+    Condition& getCondition() {
+        return condition;
+    }
+
+    /*
+     * Gets the lock for this wrapper.
+     */
+    LockType& getMutex() const {
+        return mutex;
+    }
+
+    /*
+     * Gets a Lockable which locks this wrapper, for use with lock
+     * management classes. The pointer doesn't own the adapter and
+     * must not outlive the wrapper.
+     */
+    LockablePtr getLockablePtr() const {
+        return LockablePtr(&adapter, boost::null_deleter());
+    }
+};
+
+/*
+ * The read/write counterpart of TSStaticWrapper. The Mutex may be any
+ * boost SharedLockable, such as a boost::shared_mutex or a
+ * SharedSpinMutex. A ReadLockedWrapper gives shared, const access to
+ * the wrapped object.
+ */
+template<typename Wrapped, typename Mutex = boost::shared_mutex>
+class TSStaticReadWriteWrapper : private boost::noncopyable {
+public:
+    // For public use in identifying the underlying wrapped class
+    typedef Wrapped WrapperType;
+    typedef Mutex LockType;
+    typedef boost::condition_variable_any Condition;
+    typedef boost::interprocess::scoped_lock<LockType> ScopedLock;
+    typedef boost::shared_lock<LockType> SharedScopedLock;
+    typedef SharedMutexLockableAdapter<LockType> Adapter;
+
+protected:
+    Wrapped wrapped;
+    mutable LockType mutex;
+    Condition condition;
+    mutable Adapter adapter;
+
+public:
+    /*
+     * Scope write locks the wrapper and gives access to the wrapped
+     * object until it goes out of scope.
+     */
+    class LockedWrapper : private boost::noncopyable {
+    private:
+        TSStaticReadWriteWrapper& owner;
+        ScopedLock lock;
+
+    public:
+        explicit LockedWrapper(TSStaticReadWriteWrapper& wrapper) :
+            owner(wrapper), lock(wrapper.mutex) {}
+
+        Wrapped& operator *() const {
+            return owner.wrapped;
+        }
+
+        Wrapped *operator ->() const {
+            return &owner.wrapped;
+        }
+
+        Wrapped *get() const {
+            return &owner.wrapped;
+        }
+
+        /* Releases the lock until the wrapper condition is notified */
+        void wait() {
+            owner.condition.wait(lock);
+        }
+
+        /*
+         * As wait, but gives up at the deadline. Returns false on
+         * timeout.
+         */
+        bool timedWait(const boost::system_time& deadline) {
+            return owner.condition.timed_wait(lock, deadline);
+        }
+    };
+
+    /*
+     * Scope read locks the wrapper and gives const access to the
+     * wrapped object until it goes out of scope.
+     */
+    class ReadLockedWrapper : private boost::noncopyable {
+    private:
+        const TSStaticReadWriteWrapper& owner;
+        SharedScopedLock lock;
+
+    public:
+        explicit ReadLockedWrapper(const TSStaticReadWriteWrapper& wrapper) :
+            owner(wrapper), lock(wrapper.mutex) {}
+
+        const Wrapped& operator *() const {
+            return owner.wrapped;
+        }
+
+        const Wrapped *operator ->() const {
+            return &owner.wrapped;
+        }
+
+        const Wrapped *get() const {
+            return &owner.wrapped;
+        }
+    };
+
+    explicit TSStaticReadWriteWrapper(int priority = 0) :
+        wrapped(), mutex(), condition(),
+        adapter(mutex, priority) {}
+    explicit TSStaticReadWriteWrapper(const Wrapped& other, int priority = 0) :
+        wrapped(other), mutex(), condition(),
+        adapter(mutex, priority) {}
+
+    /*
+     * Gives the condition variable for this wrapper without any
+     * lock or unlock calls.
+     */
+    Condition& getCondition() {
+        return condition;
+    }
+
+    /*
+     * Gets the lock for this wrapper.
+     */
+    LockType& getMutex() const {
+        return mutex;
+    }
+
+    /*
+     * Gets a ReadWriteLockable which locks this wrapper, for use
+     * with lock management classes. The pointer doesn't own the
+     * adapter and must not outlive the wrapper.
+     */
+    ReadWriteLockablePtr getLockablePtr() const {
+        return ReadWriteLockablePtr(&adapter, boost::null_deleter());
+    }
+};
+
 }}}
 
 #endif /* TSWRAPPER_H_ */
@@ -0,0 +1,255 @@
+/**
+ * @file distributed_lock.h
+ *
+ * Defines a "big reader" reader/writer mutex, whose readers each
+ * mark their own cache line so that read locking scales across
+ * cores, and its ReadWriteLockable wrapper.
+ */
+
+#ifndef DISTRIBUTED_LOCK_H_
+#define DISTRIBUTED_LOCK_H_
+
+#include <cstddef>
+#include "lockable.hpp"
+#include "atomics.hpp"
+#include "spin_lock.hpp"
+
+// Don't listen to warnings about boost on msvc
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(push, 0)
+#endif
+#include <boost/noncopyable.hpp>
+#include <boost/cstdint.hpp>
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(pop)
+#endif
+
+namespace core { namespace threading {
+
+/*
+ * The number of reader slots in each distributed mutex. Threads are
+ * spread over the slots by id, so this should be around the number
+ * of cores that read concurrently. Each slot takes a cache line.
+ */
+#ifndef CORE_DISTRIBUTED_LOCK_SLOTS
+#   define CORE_DISTRIBUTED_LOCK_SLOTS 16
+#endif
+
+/*
+ * Selects who waits when readers and a writer arrive together.
+ * PREFER_WRITERS stops new readers while a writer waits, so writers
+ * can't be starved. PREFER_READERS lets readers keep entering, and
+ * the writer only gets in once it sees no readers at all.
+ */
+enum LockPreference {
+    PREFER_WRITERS,
+    PREFER_READERS
+};
+
+/*
+ * A reader/writer mutex which keeps a reader count per slot rather
+ * than one shared count. A reader only writes to its own slot's
+ * cache line, so read locking from many cores doesn't bounce a
+ * line between them. The cost moves to writers, which have to scan
+ * every slot, so this suits data which is read far more often than
+ * it is written.
+ *
+ * Waiting threads spin briefly, then park like SharedSpinMutex.
+ * Readers and the writer park separately, so a reader backing off
+ * only wakes the writer.
+ *
+ * A read lock may be released on a different thread than took it.
+ * The slots then drift apart, one counting up and one down, but the
+ * writer only checks that they sum to zero.
+ *
+ * Meets the boost SharedLockable concept.
+ */
+class DistributedSharedMutex : private boost::noncopyable {
+private:
+    static const boost::uint32_t WRITER = 1;
+    static const boost::uint32_t WRITER_WAITING = 2;
+    static const std::size_t SLOTS = CORE_DISTRIBUTED_LOCK_SLOTS;
+
+    typedef CacheLinePadded<boost::atomic<boost::uint32_t> > ReaderSlot;
+
+    struct ReadersDrained {
+        const DistributedSharedMutex& owner;
+        explicit ReadersDrained(const DistributedSharedMutex& mutex) : owner(mutex) {}
+        bool operator()() const {
+            return owner.readersDrained();
+        }
+    };
+
+    ReaderSlot slots[SLOTS];
+    // Readers only read this word until a writer arrives
+    CacheLinePadded<boost::atomic<boost::uint32_t> > state;
+    // Serializes writers, so only one at a time touches state
+    SpinMutex writerMutex;
+    const LockPreference preference;
+    hidden::SpinEstimate spinEstimate;
+    hidden::SpinParker readerParker;
+    hidden::SpinParker writerParker;
+
+    /* Returns this thread's reader slot */
+    ReaderSlot& readerSlot() {
+        return slots[threadHash() % SLOTS];
+    }
+
+    /*
+     * Sums the slots with wrapping arithmetic, so a reader which
+     * entered on one slot and left on another still cancels out. Any
+     * reader inside entered before the writer's flag went up, so the
+     * scan can't miss its count.
+     */
+    bool readersDrained() const {
+        boost::uint32_t readers = 0;
+        for (std::size_t index = 0; index < SLOTS; index++) {
+            readers += slots[index].value.load(boost::memory_order_seq_cst);
+        }
+        return readers == 0;
+    }
+
+    /* Blocks until a scan of the slots finds no readers */
+    void waitForReaders() {
+        boost::uint32_t limit = spinEstimate.limit();
+        for (boost::uint32_t spins = 0; spins < limit; spins++) {
+            if (readersDrained()) {
+                spinEstimate.update(spins);
+                return;
+            }
+            cpuRelax();
+        }
+        spinEstimate.update(limit);
+        writerParker.parkUntil(ReadersDrained(*this));
+    }
+
+    /*
+     * Marks a reader in the slot, then backs it out again if a writer
+     * holds or is taking the lock. Both sides are sequentially
+     * consistent, so either the writer's scan sees the reader or the
+     * reader sees the writer.
+     */
+    bool tryEnter(ReaderSlot& slot) {
+        slot.value.fetch_add(1, boost::memory_order_seq_cst);
+        if ((state.value.load(boost::memory_order_seq_cst) & WRITER) == 0) {
+            return true;
+        }
+        slot.value.fetch_sub(1, boost::memory_order_seq_cst);
+        // The writer may be parked on the count we just raised
+        writerParker.wakeAll();
+        return false;
+    }
+
+    void release() {
+        state.value.store(0, boost::memory_order_seq_cst);
+        writerMutex.unlock();
+        readerParker.wakeAll();
+    }
+
+public:
+    explicit DistributedSharedMutex(LockPreference lockPreference = PREFER_WRITERS) :
+        writerMutex(), preference(lockPreference), spinEstimate(),
+        readerParker(), writerParker() {
+        for (std::size_t index = 0; index < SLOTS; index++) {
+            slots[index].value.store(0, boost::memory_order_relaxed);
+        }
+        state.value.store(0, boost::memory_order_release);
+    }
+
+    LockPreference getPreference() const {
+        return preference;
+    }
+
+    bool try_lock() {
+        if (!writerMutex.try_lock()) {
+            return false;
+        }
+        state.value.store(WRITER, boost::memory_order_seq_cst);
+        if (readersDrained()) {
+            return true;
+        }
+        release();
+        return false;
+    }
+
+    void lock() {
+        writerMutex.lock();
+        if (preference == PREFER_WRITERS) {
+            // New readers back off from here on
+            state.value.store(WRITER, boost::memory_order_seq_cst);
+            waitForReaders();
+            return;
+        }
+        for (;;) {
+            // Readers keep entering until a scan finds none of them
+            state.value.store(WRITER_WAITING, boost::memory_order_seq_cst);
+            waitForReaders();
+            state.value.store(WRITER, boost::memory_order_seq_cst);
+            if (readersDrained()) {
+                return;
+            }
+            // A reader slipped in between the scan and the flag
+            state.value.store(WRITER_WAITING, boost::memory_order_seq_cst);
+            readerParker.wakeAll();
+        }
+    }
+
+    void unlock() {
+        release();
+    }
+
+    bool try_lock_shared() {
+        return tryEnter(readerSlot());
+    }
+
+    void lock_shared() {
+        ReaderSlot& slot = readerSlot();
+        for (;;) {
+            boost::uint32_t limit = spinEstimate.limit();
+            for (boost::uint32_t spins = 0; spins < limit; spins++) {
+                if (tryEnter(slot)) {
+                    return;
+                }
+                cpuRelax();
+            }
+            readerParker.parkWhile(state.value, WRITER);
+        }
+    }
+
+    void unlock_shared() {
+        readerSlot().value.fetch_sub(1, boost::memory_order_seq_cst);
+        if (state.value.load(boost::memory_order_seq_cst) != 0) {
+            // A writer is waiting for the readers to drain
+            writerParker.wakeAll();
+        }
+    }
+};
+
+/**
+ * Read/Write lock with per-slot reader counts
+ */
+class DistributedReadWriteLock : public ReadWriteLockable {
+private:
+    DistributedSharedMutex mutex;
+    explicit DistributedReadWriteLock(const DistributedReadWriteLock&) :
+        ReadWriteLockable(), mutex() {}
+
+public:
+    explicit DistributedReadWriteLock(int priority = 0,
+            LockPreference preference = PREFER_WRITERS) :
+        ReadWriteLockable(priority), mutex(preference) {}
+    virtual ~DistributedReadWriteLock() {}
+
+    LockPreference getPreference() const { return mutex.getPreference(); }
+
+    void lock() { mutex.lock(); }
+    bool tryLock() { return mutex.try_lock(); }
+    void unlock() { mutex.unlock(); }
+
+    void lockShared() { mutex.lock_shared(); }
+    bool tryLockShared() { return mutex.try_lock_shared(); }
+    void unlockShared() { mutex.unlock_shared(); }
+};
+
+}}
+#endif /* DISTRIBUTED_LOCK_H_ */
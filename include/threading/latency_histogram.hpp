@@ -0,0 +1,103 @@
+/*
+ * latency_histogram.hpp
+ * Defines a lock-free histogram of durations, used by the lock and
+ * container profiling policies.
+ */
+
+#ifndef LATENCY_HISTOGRAM_H_
+#define LATENCY_HISTOGRAM_H_
+
+#include <cstddef>
+#include "threading/atomics.hpp"
+
+// Don't listen to warnings about boost on msvc
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(push, 0)
+#endif
+#include <boost/noncopyable.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(pop)
+#endif
+
+namespace core { namespace threading {
+
+/*
+ * A histogram of durations with power of two microsecond buckets.
+ * Bucket 0 counts durations under 1us and bucket i durations in
+ * [2^(i-1), 2^i) microseconds, with the last bucket catching all
+ * longer durations. Counts can be read at any time without locking.
+ */
+class LatencyHistogram : private boost::noncopyable {
+public:
+    static const std::size_t numBuckets = 32;
+
+private:
+    boost::atomic<boost::uint64_t> buckets[numBuckets];
+
+public:
+    LatencyHistogram() {
+        for (std::size_t i = 0; i < numBuckets; i++) {
+            buckets[i].store(0, boost::memory_order_relaxed);
+        }
+    }
+
+    /* Returns the bucket which a duration falls in */
+    static std::size_t bucketFor(boost::uint64_t micros) {
+        std::size_t bucket = 0;
+        while (micros > 0 && bucket < numBuckets - 1) {
+            micros >>= 1;
+            bucket++;
+        }
+        return bucket;
+    }
+
+    /* Returns the exclusive upper bound of a bucket in microseconds */
+    static boost::uint64_t bucketUpperBound(std::size_t bucket) {
+        return (boost::uint64_t)1 << bucket;
+    }
+
+    void record(const boost::posix_time::time_duration& duration) {
+        boost::int64_t micros = duration.total_microseconds();
+        buckets[bucketFor(micros > 0 ? (boost::uint64_t)micros : 0)].fetch_add(1, boost::memory_order_relaxed);
+    }
+
+    /* Returns the number of durations recorded in a bucket */
+    boost::uint64_t count(std::size_t bucket) const {
+        return buckets[bucket].load(boost::memory_order_relaxed);
+    }
+
+    /* Returns the number of durations recorded in all buckets */
+    boost::uint64_t totalCount() const {
+        boost::uint64_t total = 0;
+        for (std::size_t i = 0; i < numBuckets; i++) {
+            total += count(i);
+        }
+        return total;
+    }
+
+    /*
+     * Returns the upper bound in microseconds of the bucket holding
+     * the given percentile (0 to 100), or 0 if nothing was recorded.
+     */
+    boost::uint64_t percentileUpperBound(double percentile) const {
+        boost::uint64_t total = totalCount();
+        if (total == 0) {
+            return 0;
+        }
+        boost::uint64_t wanted = (boost::uint64_t)(total * percentile / 100.0);
+        boost::uint64_t seen = 0;
+        for (std::size_t i = 0; i < numBuckets; i++) {
+            seen += count(i);
+            if (seen > wanted || seen == total) {
+                return bucketUpperBound(i);
+            }
+        }
+        return bucketUpperBound(numBuckets - 1);
+    }
+};
+
+}}
+
+#endif /* LATENCY_HISTOGRAM_H_ */
@@ -0,0 +1,289 @@
+/**
+ * @file lock_profiler.h
+ *
+ * Defines an opt-in contention profiler for Lockable objects, which
+ * records how often each lock is taken, how often callers had to wait
+ * for it and for how long.
+ */
+
+#ifndef LOCK_PROFILER_H_
+#define LOCK_PROFILER_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <set>
+#include <ostream>
+#include "threading/atomics.hpp"
+#include "threading/latency_histogram.hpp"
+
+// Don't listen to warnings about boost on msvc
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(push, 0)
+#endif
+#include <boost/noncopyable.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread_time.hpp>
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(pop)
+#endif
+
+/*
+ * Defining CORE_LOCK_PROFILING makes the default locks of the thread
+ * safe wrappers (and so every container built on them) profiled. Locks
+ * can also be profiled individually by using ProfiledLock or
+ * ProfiledReadWriteLock directly.
+ */
+#ifdef CORE_LOCK_PROFILING
+#   define CORE_PROFILED_LOCK(LockType) core::threading::ProfiledLock<LockType>
+#   define CORE_PROFILED_READ_WRITE_LOCK(LockType) core::threading::ProfiledReadWriteLock<LockType>
+#else
+#   define CORE_PROFILED_LOCK(LockType) LockType
+#   define CORE_PROFILED_READ_WRITE_LOCK(LockType) LockType
+#endif
+
+namespace core { namespace threading {
+
+/*
+ * The statistics gathered for a single profiled lock. Every record
+ * call is a relaxed atomic update, so readouts never block the lock
+ * and may be slightly out of step with each other.
+ */
+class LockProfile : private boost::noncopyable {
+private:
+    std::string name;
+    const int priority;
+    boost::atomic<boost::uint64_t> acquired;
+    boost::atomic<boost::uint64_t> contended;
+    LatencyHistogram waits;
+    LatencyHistogram holds;
+
+public:
+    LockProfile(const std::string& lockName, int lockPriority) :
+        name(lockName), priority(lockPriority) {
+        acquired.store(0, boost::memory_order_relaxed);
+        contended.store(0, boost::memory_order_relaxed);
+    }
+
+    /* Called when the lock was taken without waiting */
+    void recordAcquire() {
+        acquired.fetch_add(1, boost::memory_order_relaxed);
+    }
+
+    /* Called when the lock was taken after waiting for it */
+    void recordContended(const boost::posix_time::time_duration& wait) {
+        acquired.fetch_add(1, boost::memory_order_relaxed);
+        contended.fetch_add(1, boost::memory_order_relaxed);
+        waits.record(wait);
+    }
+
+    /* Called when an exclusive hold of the lock ends */
+    void recordHold(const boost::posix_time::time_duration& hold) {
+        holds.record(hold);
+    }
+
+    /*
+     * Labels the profile in reports. Must be called before the lock
+     * is shared between threads.
+     */
+    void setName(const std::string& lockName) {
+        name = lockName;
+    }
+
+    const std::string& getName() const {
+        return name;
+    }
+
+    int getPriority() const {
+        return priority;
+    }
+
+    /* Returns the number of times the lock was taken */
+    boost::uint64_t acquisitions() const {
+        return acquired.load(boost::memory_order_relaxed);
+    }
+
+    /* Returns the number of times the lock was taken after waiting */
+    boost::uint64_t contendedAcquisitions() const {
+        return contended.load(boost::memory_order_relaxed);
+    }
+
+    /* Returns how long contended acquisitions waited */
+    const LatencyHistogram& waitTimes() const {
+        return waits;
+    }
+
+    /* Returns how long the lock was held exclusively */
+    const LatencyHistogram& holdTimes() const {
+        return holds;
+    }
+};
+
+/*
+ * A copy of the headline figures of a LockProfile, as returned by
+ * LockProfiler reports. Times are bucket upper bounds in microseconds.
+ */
+struct LockReport {
+    std::string name;
+    int priority;
+    const void *profile;
+    boost::uint64_t acquisitions;
+    boost::uint64_t contended;
+    boost::uint64_t medianWait;
+    boost::uint64_t p99Wait;
+    boost::uint64_t medianHold;
+    boost::uint64_t p99Hold;
+};
+
+/*
+ * The registry of every live LockProfile. Profiled locks register
+ * themselves on construction and unregister on destruction, so a
+ * report only ever covers locks which still exist.
+ */
+class LockProfiler : private boost::noncopyable {
+private:
+    boost::mutex registryMutex;
+    std::set<const LockProfile *> profiles;
+
+    LockProfiler() : registryMutex(), profiles() {}
+
+public:
+    /*
+     * Returns the process wide profiler. It is created on first use
+     * and never destroyed, so locks with static storage may register
+     * and unregister at any point of the program's lifetime.
+     */
+    static LockProfiler& instance();
+
+    void registerProfile(const LockProfile& profile);
+    void unregisterProfile(const LockProfile& profile);
+
+    /* Returns the number of registered profiles */
+    std::size_t profileCount();
+
+    /*
+     * Returns reports for up to count locks, most contended first.
+     * Locks which were never contended are left out.
+     */
+    std::vector<LockReport> topContended(std::size_t count);
+
+    /* Writes the topContended reports to out, one lock per line */
+    void writeReport(std::ostream& out, std::size_t count);
+};
+
+/*
+ * Profiles any Lockable lock type, such as a WriteLock, ConditionLock
+ * or SpinLock. Each acquisition first tries the lock, and only times
+ * the wait if that fails, so uncontended locking costs one extra clock
+ * read to start the hold time. Condition waits are profiled too, either
+ * through the unlock and lock calls or, for native condition waits,
+ * through the Condition wait hooks.
+ */
+template<typename LockType>
+class ProfiledLock : public LockType {
+protected:
+    LockProfile profile;
+    // Start of the current exclusive hold (guarded by the lock itself)
+    boost::system_time holdStart;
+
+    void acquire() {
+        if (LockType::tryLock()) {
+            profile.recordAcquire();
+        } else {
+            const boost::system_time start = boost::get_system_time();
+            LockType::lock();
+            profile.recordContended(boost::get_system_time() - start);
+        }
+    }
+
+    /*
+     * Overrides the Condition hooks when LockType is a condition lock
+     * with a native wait. Waking from a wait can't tell whether it had
+     * to queue for the lock, so it always counts as uncontended.
+     */
+    void waitReleased() {
+        profile.recordHold(boost::get_system_time() - holdStart);
+    }
+    void waitReacquired() {
+        profile.recordAcquire();
+        holdStart = boost::get_system_time();
+    }
+
+public:
+    explicit ProfiledLock(int priority = 0) :
+        LockType(priority), profile(std::string(), priority), holdStart() {
+        LockProfiler::instance().registerProfile(profile);
+    }
+    explicit ProfiledLock(const std::string& name, int priority = 0) :
+        LockType(priority), profile(name, priority), holdStart() {
+        LockProfiler::instance().registerProfile(profile);
+    }
+
+    virtual ~ProfiledLock() {
+        LockProfiler::instance().unregisterProfile(profile);
+    }
+
+    void lock() {
+        acquire();
+        holdStart = boost::get_system_time();
+    }
+    bool tryLock() {
+        if (!LockType::tryLock()) {
+            return false;
+        }
+        profile.recordAcquire();
+        holdStart = boost::get_system_time();
+        return true;
+    }
+    void unlock() {
+        profile.recordHold(boost::get_system_time() - holdStart);
+        LockType::unlock();
+    }
+
+    LockProfile& getProfile() {
+        return profile;
+    }
+    const LockProfile& getProfile() const {
+        return profile;
+    }
+};
+
+/*
+ * Profiles any ReadWriteLockable lock type. Shared acquisitions are
+ * counted and their waits timed, but shared holds overlap so only
+ * exclusive holds are timed.
+ */
+template<typename LockType>
+class ProfiledReadWriteLock : public ProfiledLock<LockType> {
+public:
+    explicit ProfiledReadWriteLock(int priority = 0) :
+        ProfiledLock<LockType>(priority) {}
+    explicit ProfiledReadWriteLock(const std::string& name, int priority = 0) :
+        ProfiledLock<LockType>(name, priority) {}
+
+    virtual ~ProfiledReadWriteLock() {}
+
+    void lockShared() {
+        if (LockType::tryLockShared()) {
+            this->profile.recordAcquire();
+        } else {
+            const boost::system_time start = boost::get_system_time();
+            LockType::lockShared();
+            this->profile.recordContended(boost::get_system_time() - start);
+        }
+    }
+    bool tryLockShared() {
+        if (!LockType::tryLockShared()) {
+            return false;
+        }
+        this->profile.recordAcquire();
+        return true;
+    }
+    void unlockShared() {
+        LockType::unlockShared();
+    }
+};
+
+}}
+#endif /* LOCK_PROFILER_H_ */
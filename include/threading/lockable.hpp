@@ -17,6 +17,7 @@
 #include <boost/noncopyable.hpp>
 #include <boost/enable_shared_from_this.hpp>
 #include <boost/function.hpp>
+#include <boost/move/move.hpp>
 #if defined(_MSC_VER) && (_MSC_VER >= 1500)
 #   pragma warning(pop)
 #endif
@@ -231,6 +232,142 @@ public:
     }
 };
 
+/**
+ * A stack resident alternative to LockedReferencePtr. The lock is
+ * held from construction until the reference goes out of scope, with
+ * no heap allocation or reference counting. The reference can be
+ * moved (which transfers the lock) but not copied.
+ *
+ * The referenced object and the lock must outlive the reference.
+ */
+template<typename Ref, typename LockType = Lockable>
+class ScopedLockedReference {
+    BOOST_MOVABLE_BUT_NOT_COPYABLE(ScopedLockedReference)
+
+private:
+    Ref *lockedRef;
+    LockType *lockable;
+
+    void release() {
+        if (lockable) {
+            lockable->unlock();
+            lockable = NULL;
+        }
+    }
+
+public:
+    ScopedLockedReference(Ref& reference, LockType& lock) :
+        lockedRef(&reference), lockable(&lock) {
+        lockable->lock();
+    }
+
+    ScopedLockedReference(BOOST_RV_REF(ScopedLockedReference) other) :
+        lockedRef(other.lockedRef), lockable(other.lockable) {
+        other.lockable = NULL;
+    }
+
+    ScopedLockedReference& operator =(BOOST_RV_REF(ScopedLockedReference) other) {
+        if (this != &other) {
+            release();
+            lockedRef = other.lockedRef;
+            lockable = other.lockable;
+            other.lockable = NULL;
+        }
+        return *this;
+    }
+
+    ~ScopedLockedReference() {
+        release();
+    }
+
+    Ref& operator *() const {
+        return *lockedRef;
+    }
+
+    Ref *operator ->() const {
+        return lockedRef;
+    }
+
+    Ref *get() const {
+        return lockedRef;
+    }
+
+    /* Returns false once the lock has been moved to another reference */
+    bool ownsLock() const {
+        return lockable != NULL;
+    }
+
+    LockType& getLock() const {
+        return *lockable;
+    }
+};
+
+/**
+ * The shared (read) locked counterpart of ScopedLockedReference,
+ * which gives const access to the referenced object.
+ */
+template<typename Ref, typename LockType = ReadWriteLockable>
+class ScopedReadLockedReference {
+    BOOST_MOVABLE_BUT_NOT_COPYABLE(ScopedReadLockedReference)
+
+private:
+    const Ref *lockedRef;
+    LockType *lockable;
+
+    void release() {
+        if (lockable) {
+            lockable->unlockShared();
+            lockable = NULL;
+        }
+    }
+
+public:
+    ScopedReadLockedReference(const Ref& reference, LockType& lock) :
+        lockedRef(&reference), lockable(&lock) {
+        lockable->lockShared();
+    }
+
+    ScopedReadLockedReference(BOOST_RV_REF(ScopedReadLockedReference) other) :
+        lockedRef(other.lockedRef), lockable(other.lockable) {
+        other.lockable = NULL;
+    }
+
+    ScopedReadLockedReference& operator =(BOOST_RV_REF(ScopedReadLockedReference) other) {
+        if (this != &other) {
+            release();
+            lockedRef = other.lockedRef;
+            lockable = other.lockable;
+            other.lockable = NULL;
+        }
+        return *this;
+    }
+
+    ~ScopedReadLockedReference() {
+        release();
+    }
+
+    const Ref& operator *() const {
+        return *lockedRef;
+    }
+
+    const Ref *operator ->() const {
+        return lockedRef;
+    }
+
+    const Ref *get() const {
+        return lockedRef;
+    }
+
+    /* Returns false once the lock has been moved to another reference */
+    bool ownsLock() const {
+        return lockable != NULL;
+    }
+
+    LockType& getLock() const {
+        return *lockable;
+    }
+};
+
 /**
  * An abstract class for lockable objects, this provides
  * certain interfacing guarantees for lock management classes.
@@ -458,6 +595,14 @@ public:
     virtual bool tryLockSharedIfPossible() { return tryLockShared(); }
     virtual void unlockSharedIfPossible() { unlockShared(); }
 
+    /**
+     * Names from the boost SharedLockable concept, so that read/write
+     * lockables work with boost::shared_lock.
+     */
+    void lock_shared() { lockShared(); }
+    bool try_lock_shared() { return tryLockShared(); }
+    void unlock_shared() { unlockShared(); }
+
     virtual ~ReadWriteLockable() {}
 };
 
@@ -566,6 +711,78 @@ public:
     }
 };
 
+/**
+ * Presents a concrete boost Lockable mutex (lock, try_lock and
+ * unlock) as a Lockable, so that objects which lock their mutex
+ * directly can still take part in a ResourceLocker. The adapter
+ * does not own the mutex and must not outlive it.
+ */
+template<typename Mutex>
+class MutexLockableAdapter : public Lockable {
+private:
+    Mutex& mutex;
+
+public:
+    explicit MutexLockableAdapter(Mutex& adapted, int priority = 0) :
+        Lockable(priority), mutex(adapted) {}
+
+    virtual ~MutexLockableAdapter() {}
+
+    virtual void lock() {
+        mutex.lock();
+    }
+    virtual bool tryLock() {
+        return mutex.try_lock();
+    }
+    virtual void unlock() {
+        mutex.unlock();
+    }
+
+    virtual void *getAddress() const {
+        return (void *)&mutex;
+    }
+};
+
+/**
+ * Acts much like MutexLockableAdapter, except it adapts a boost
+ * SharedLockable mutex into a ReadWriteLockable.
+ */
+template<typename Mutex>
+class SharedMutexLockableAdapter : public ReadWriteLockable {
+private:
+    Mutex& mutex;
+
+public:
+    explicit SharedMutexLockableAdapter(Mutex& adapted, int priority = 0) :
+        ReadWriteLockable(priority), mutex(adapted) {}
+
+    virtual ~SharedMutexLockableAdapter() {}
+
+    virtual void lock() {
+        mutex.lock();
+    }
+    virtual bool tryLock() {
+        return mutex.try_lock();
+    }
+    virtual void unlock() {
+        mutex.unlock();
+    }
+
+    virtual void lockShared() {
+        mutex.lock_shared();
+    }
+    virtual bool tryLockShared() {
+        return mutex.try_lock_shared();
+    }
+    virtual void unlockShared() {
+        mutex.unlock_shared();
+    }
+
+    virtual void *getAddress() const {
+        return (void *)&mutex;
+    }
+};
+
 /**
  * Compares two mutexes and returns an indicator for which
  * mutex should be locked first.
@@ -733,6 +950,16 @@ class WriteLock : public Lockable {
 private:
     boost::mutex mutex;
     explicit WriteLock(const WriteLock& mutex) : Lockable(), mutex() {}
+
+protected:
+    /*
+     * Gives subclasses the raw mutex, so that they can wait on a
+     * native condition variable with it.
+     */
+    boost::mutex& getMutex() {
+        return mutex;
+    }
+
 public:
     explicit WriteLock(int priority = 0) : Lockable(priority), mutex() {}
     virtual ~WriteLock() {}
@@ -0,0 +1,153 @@
+/**
+ * @file queue_lock.h
+ *
+ * Defines a fair MCS queue mutex, which hands the lock to waiters in
+ * strict arrival order, and its Lockable wrapper.
+ */
+
+#ifndef QUEUE_LOCK_H_
+#define QUEUE_LOCK_H_
+
+#include <cstddef>
+#include "lockable.hpp"
+#include "atomics.hpp"
+#include "spin_lock.hpp"
+
+// Don't listen to warnings about boost on msvc
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(push, 0)
+#endif
+#include <boost/noncopyable.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/thread/thread.hpp>
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(pop)
+#endif
+
+namespace core { namespace threading {
+
+namespace hidden {
+/*
+ * A waiter's place in a QueueMutex queue. Each node sits on its own
+ * cache line, and only its owner spins on it.
+ */
+struct QueueNode {
+    boost::atomic<QueueNode *> next;
+    boost::atomic<bool> waiting;
+
+    QueueNode() {
+        next.store(NULL, boost::memory_order_relaxed);
+        waiting.store(false, boost::memory_order_relaxed);
+    }
+};
+typedef CacheLinePadded<QueueNode> PaddedQueueNode;
+
+/*
+ * Hands out queue nodes from a per-thread pool, since a thread may
+ * hold any number of queue mutexes at once. A node may be released
+ * as soon as the mutex it queued on has been unlocked.
+ */
+PaddedQueueNode *acquireQueueNode();
+void releaseQueueNode(PaddedQueueNode *node);
+}
+
+/*
+ * An MCS queue mutex. Each locker appends its own node to the queue
+ * and spins on that node only, so a release touches one waiter's
+ * cache line rather than every waiter's, and the lock passes to
+ * waiters in strict FIFO order without any barging.
+ *
+ * A waiter which spins for CORE_MAX_SPIN_COUNT polls yields its time
+ * slice between polls from then on. Strict handoff means a preempted
+ * waiter holds up everyone queued behind it, so this is best kept
+ * to locks with no more contending threads than cores.
+ *
+ * Meets the boost Lockable concept, so it can be used with the
+ * boost lock types and condition_variable_any.
+ */
+class QueueMutex : private boost::noncopyable {
+private:
+    CacheLinePadded<boost::atomic<hidden::QueueNode *> > tail;
+    // The node of the current holder, only touched by the holder
+    hidden::PaddedQueueNode *holder;
+
+public:
+    QueueMutex() : holder(NULL) {
+        tail.value.store(NULL, boost::memory_order_release);
+    }
+
+    bool try_lock() {
+        if (tail.value.load(boost::memory_order_relaxed) != NULL) {
+            return false;
+        }
+        hidden::PaddedQueueNode *node = hidden::acquireQueueNode();
+        node->value.next.store(NULL, boost::memory_order_relaxed);
+        hidden::QueueNode *expected = NULL;
+        if (tail.value.compare_exchange_strong(expected, &node->value, boost::memory_order_acquire)) {
+            holder = node;
+            return true;
+        }
+        hidden::releaseQueueNode(node);
+        return false;
+    }
+
+    void lock() {
+        hidden::PaddedQueueNode *node = hidden::acquireQueueNode();
+        hidden::QueueNode& mine = node->value;
+        mine.next.store(NULL, boost::memory_order_relaxed);
+        mine.waiting.store(true, boost::memory_order_relaxed);
+        hidden::QueueNode *predecessor = tail.value.exchange(&mine, boost::memory_order_acq_rel);
+        if (predecessor != NULL) {
+            predecessor->next.store(&mine, boost::memory_order_release);
+            boost::uint32_t spins = 0;
+            while (mine.waiting.load(boost::memory_order_acquire)) {
+                if (spins < CORE_MAX_SPIN_COUNT) {
+                    spins++;
+                    cpuRelax();
+                } else {
+                    boost::this_thread::yield();
+                }
+            }
+        }
+        holder = node;
+    }
+
+    void unlock() {
+        hidden::PaddedQueueNode *node = holder;
+        hidden::QueueNode& mine = node->value;
+        hidden::QueueNode *successor = mine.next.load(boost::memory_order_acquire);
+        if (successor == NULL) {
+            hidden::QueueNode *expected = &mine;
+            if (tail.value.compare_exchange_strong(expected, NULL, boost::memory_order_release,
+                                                   boost::memory_order_relaxed)) {
+                hidden::releaseQueueNode(node);
+                return;
+            }
+            // A waiter has swapped in as the tail but not linked yet
+            while ((successor = mine.next.load(boost::memory_order_acquire)) == NULL) {
+                cpuRelax();
+            }
+        }
+        successor->waiting.store(false, boost::memory_order_release);
+        hidden::releaseQueueNode(node);
+    }
+};
+
+/**
+ * Write only fair queue lock
+ */
+class QueueLock : public Lockable {
+private:
+    QueueMutex mutex;
+    explicit QueueLock(const QueueLock&) : Lockable(), mutex() {}
+public:
+    explicit QueueLock(int priority = 0) : Lockable(priority), mutex() {}
+    virtual ~QueueLock() {}
+
+    void lock() { mutex.lock(); }
+    bool tryLock() { return mutex.try_lock(); }
+    void unlock() { mutex.unlock(); }
+};
+
+}}
+#endif /* QUEUE_LOCK_H_ */
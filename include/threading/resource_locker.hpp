@@ -10,6 +10,7 @@
 #define RESOURCELOCKER_H_
 
 #include <vector>
+#include <algorithm>
 #include "lockable.hpp"
 
 // Don't listen to warnings about boost on msvc
@@ -20,6 +21,9 @@
 #include <boost/smart_ptr.hpp>
 #include <boost/noncopyable.hpp>
 #include <boost/logic/tribool.hpp>
+#include <boost/thread/thread_time.hpp>
+#include <boost/container/small_vector.hpp>
+#include <boost/unordered_map.hpp>
 #if defined(_MSC_VER) && (_MSC_VER >= 1500)
 #   pragma warning(pop)
 #endif
@@ -65,7 +69,10 @@ private:
 
         bool setReadLockDefault(tribool readLockByDefault) {
             bool set = true;
-            if (readLockByDefault && !lockable->isReadLockable()) {
+            if (boost::logic::indeterminate(readLockByDefault)) {
+                // Unspecified, so read lock whenever the lock allows it
+                readLockByDefault = lockable->isReadLockable();
+            } else if (readLockByDefault && !lockable->isReadLockable()) {
                 readLockByDefault = false;
                 set = false;
             }
@@ -117,7 +124,17 @@ private:
         }
     };
 
-    std::vector<LockableReference> locks;
+    /*
+     * Most resources only juggle a handful of locks, so those are kept
+     * inline. Larger lock sets also maintain an index from lock address
+     * to position, as a linear scan stops being cheap.
+     */
+    static const std::size_t INLINE_LOCKS = 8;
+    typedef boost::container::small_vector<LockableReference, INLINE_LOCKS> LockVector;
+    typedef boost::unordered_map<const Lockable *, long> PositionIndex;
+
+    LockVector locks;
+    PositionIndex positions;
     long nextLockIndex;
 
     /**
@@ -150,8 +167,8 @@ private:
      * the mutex's default lock setting.
      */
     void lockMutex(LockableReference& mutref,
-            tribool asReadLockIfPossible = tribool::indeterminate_value) {
-        if (asReadLockIfPossible == tribool::indeterminate_value) {
+            tribool asReadLockIfPossible = boost::logic::indeterminate) {
+        if (boost::logic::indeterminate(asReadLockIfPossible)) {
             asReadLockIfPossible = mutref.readLockByDefault;
         }
 
@@ -173,6 +190,102 @@ private:
         // Otherwise do nothing
     }
 
+    /**
+     * Resolves whether the mutex should be read locked, falling back
+     * to the mutex's default lock setting when unspecified.
+     */
+    static bool readLockRequested(const LockableReference& mutref, tribool asReadLockIfPossible) {
+        if (boost::logic::indeterminate(asReadLockIfPossible)) {
+            asReadLockIfPossible = mutref.readLockByDefault;
+        }
+        return bool(asReadLockIfPossible && mutref.lockable->isReadLockable());
+    }
+
+    /**
+     * Attempts to lock the mutex without blocking, with the same read
+     * lock selection as lockMutex. Returns true if the lock was taken.
+     */
+    bool tryLockMutex(LockableReference& mutref, tribool asReadLockIfPossible) {
+        if (readLockRequested(mutref, asReadLockIfPossible)) {
+            if (((ReadWriteLockable *)mutref.lockable.get())->tryLockShared()) {
+                mutref.setting = READ_LOCKED;
+                return true;
+            }
+        } else if (mutref.lockable->tryLock()) {
+            mutref.setting = WRITE_LOCKED;
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * Locks the mutex, polling with a growing back-off until the
+     * deadline passes. Returns false on timeout.
+     */
+    bool lockMutexUntil(LockableReference& mutref, tribool asReadLockIfPossible,
+            const boost::system_time& deadline) {
+        long backoffMicros = 1;
+        while (!tryLockMutex(mutref, asReadLockIfPossible)) {
+            boost::system_time now = boost::get_system_time();
+            if (now >= deadline) {
+                return false;
+            }
+            boost::system_time wake = now + boost::posix_time::microseconds(backoffMicros);
+            boost::this_thread::sleep(wake < deadline ? wake : deadline);
+            if (backoffMicros < 1000) {
+                backoffMicros *= 2;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Tries to lock every lock other than the one at position, which
+     * must already be held. Returns -1 on success. Otherwise releases
+     * every lock (including the one at position) and returns the
+     * position of the lock which was busy.
+     */
+    long tryLockAllBut(long position, tribool asReadLockIfPossible) {
+        for (long index = 0; index < (long)locks.size(); index++) {
+            if (index != position && !tryLockMutex(locks[index], asReadLockIfPossible)) {
+                for (long held = 0; held < (long)locks.size(); held++) {
+                    unlockMutex(locks[held]);
+                }
+                return index;
+            }
+        }
+        return -1;
+    }
+
+    /**
+     * The acquisition loop shared by lockAllWithBackoff and
+     * tryLockAllUntil. Passing a NULL deadline waits forever.
+     */
+    bool lockAllWithBackoffUntil(tribool asReadLockIfPossible,
+            const boost::system_time *deadline) {
+        unlock();
+        if (locks.empty()) {
+            return true;
+        }
+        long blockOn = 0;
+        for (;;) {
+            if (deadline == NULL) {
+                lockMutex(locks[blockOn], readLockRequested(locks[blockOn], asReadLockIfPossible));
+            } else if (!lockMutexUntil(locks[blockOn], asReadLockIfPossible, *deadline)) {
+                return false;
+            }
+            long busy = tryLockAllBut(blockOn, asReadLockIfPossible);
+            if (busy < 0) {
+                nextLockIndex = locks.size();
+                return true;
+            }
+            // Let the holder of the busy lock make progress before
+            // blocking on it
+            blockOn = busy;
+            boost::this_thread::yield();
+        }
+    }
+
     /**
      * Locks the next sequentially significant lock.
      * If asReadLockIfPossible is set to true, then the lock will try to
@@ -180,7 +293,7 @@ private:
      * write lock. If asReadLockIfPossible is not set, it will default to
      * the mutex's default lock setting.
      */
-    void lockNext(tribool asReadLockIfPossible = tribool::indeterminate_value) {
+    void lockNext(tribool asReadLockIfPossible = boost::logic::indeterminate) {
         if (nextLockIndex < (long)locks.size()) {
             lockMutex(locks[nextLockIndex], asReadLockIfPossible);
             nextLockIndex++;
@@ -198,10 +311,64 @@ private:
     }
 
     /**
-     * Sorts the locks such that they lock in the correct ordering
+     * Inserts the lock at its sorted position, so that the locks
+     * always lock in the correct ordering. Locks of equal order keep
+     * the order they were added in.
+     */
+    void insertLock(const LockableReference& lockRef) {
+        LockVector::iterator position = locks.insert(std::upper_bound(
+                locks.begin(), locks.end(), lockRef, lockableLargestFirstCompare), lockRef);
+        indexInsertedLock(position - locks.begin());
+    }
+
+    /**
+     * Updates the address index for a lock just inserted at position,
+     * shifting the locks after it rather than rebuilding the index.
+     */
+    void indexInsertedLock(long position) {
+        if (locks.size() <= INLINE_LOCKS) {
+            return;
+        }
+        if (locks.size() == INLINE_LOCKS + 1) {
+            // This lock set has just outgrown scanning
+            reindexLocks();
+            return;
+        }
+        for (PositionIndex::iterator iter = positions.begin(); iter != positions.end(); ++iter) {
+            if (iter->second >= position) {
+                iter->second++;
+            }
+        }
+        // Duplicates map to their first position
+        const Lockable *lockable = locks[position].lockable.get();
+        PositionIndex::iterator found = positions.find(lockable);
+        if (found == positions.end() || found->second > position) {
+            positions[lockable] = position;
+        }
+    }
+
+    /**
+     * Sorts locks appended in bulk into locking order and rebuilds the
+     * index once, instead of inserting each lock in turn. Locks of
+     * equal order keep the order they were added in.
      */
     void sortLocks() {
-        std::sort(locks.begin(), locks.end(), lockableLargestFirstCompare);
+        std::stable_sort(locks.begin(), locks.end(), lockableLargestFirstCompare);
+        reindexLocks();
+    }
+
+    /**
+     * Rebuilds the address index after the lock positions change.
+     * Small lock sets are scanned instead, so they keep no index.
+     */
+    void reindexLocks() {
+        positions.clear();
+        if (locks.size() > INLINE_LOCKS) {
+            for (long index = (long)locks.size() - 1; index >= 0; index--) {
+                // Walk backwards so duplicates map to their first position
+                positions[locks[index].lockable.get()] = index;
+            }
+        }
     }
 
 public:
@@ -218,8 +385,11 @@ public:
      * resource.
      * Returns -1 if the lock is not among this resource's locks.
      */
-    long getLockPosition(boost::shared_ptr<Lockable> lock) {
-        // Could store hash entries for this, but it's probably not worth the trouble
+    long getLockPosition(const boost::shared_ptr<Lockable>& lock) const {
+        if (locks.size() > INLINE_LOCKS) {
+            PositionIndex::const_iterator found = positions.find(lock.get());
+            return found == positions.end() ? -1 : found->second;
+        }
         for (long index = 0; index < (long)locks.size(); index++) {
             if (locks[index].lockable == lock) {
                 return index;
@@ -231,7 +401,7 @@ public:
     /**
      * Checks if the lock is contained among the locks of this resource
      */
-    bool containsLock(boost::shared_ptr<Lockable> lock) {
+    bool containsLock(const boost::shared_ptr<Lockable>& lock) const {
         return (getLockPosition(lock) >= 0);
     }
 
@@ -270,8 +440,9 @@ public:
     bool isLocked(long position) {
         return position < nextLockIndex;
     }
-    bool isLocked(boost::shared_ptr<Lockable> lock) {
-        return isLocked(getLockPosition(lock));
+    bool isLocked(const boost::shared_ptr<Lockable>& lock) {
+        long lockPos = getLockPosition(lock);
+        return lockPos >= 0 && isLocked(lockPos);
     }
 
     /**
@@ -299,21 +470,54 @@ public:
      * write lock. If asReadLockIfPossible is not set, it will default to
      * the mutex's default lock setting.
      */
-    void lock(long position = -1, tribool asReadLockIfPossible = tribool::indeterminate_value) {
-        if (position < 0) position = getNumLocks();
+    void lock(long position = -1, tribool asReadLockIfPossible = boost::logic::indeterminate) {
+        if (position < 0) position = getNumLocks() - 1;
         if (position < (long)locks.size()) {
             while(!isLocked(position)) {
                 lockNext(asReadLockIfPossible);
             }
         }
     }
-    void lock(boost::shared_ptr<Lockable> lock, tribool asReadLockIfPossible = tribool::indeterminate_value) {
+    void lock(const boost::shared_ptr<Lockable>& lock, tribool asReadLockIfPossible = boost::logic::indeterminate) {
         long lockPos = getLockPosition(lock);
         if (lockPos >= 0 && !isLocked(lockPos)) {
             this->lock(lockPos, asReadLockIfPossible);
         }
     }
 
+    /**
+     * Locks all locks in the style of std::lock, rather than in
+     * sorted order. The thread blocks on one lock only, and tries the
+     * rest without blocking. If any of them is busy, everything is
+     * released and the thread blocks on the busy lock instead. A
+     * thread never waits while holding other locks, so a slow holder
+     * of one lock does not convoy the threads queued behind the
+     * locks this thread already took.
+     * Any locks already held by this resource are released first.
+     * Read locks are selected as they are for lock.
+     */
+    void lockAllWithBackoff(tribool asReadLockIfPossible = boost::logic::indeterminate) {
+        lockAllWithBackoffUntil(asReadLockIfPossible, NULL);
+    }
+
+    /**
+     * As lockAllWithBackoff, but gives up at the deadline. Returns
+     * false, with no locks held, if the deadline passed first.
+     */
+    bool tryLockAllUntil(const boost::system_time& deadline,
+            tribool asReadLockIfPossible = boost::logic::indeterminate) {
+        return lockAllWithBackoffUntil(asReadLockIfPossible, &deadline);
+    }
+
+    /**
+     * As tryLockAllUntil, with a deadline the given duration from now.
+     */
+    template<typename DurationType>
+    bool tryLockAllFor(const DurationType& duration,
+            tribool asReadLockIfPossible = boost::logic::indeterminate) {
+        return tryLockAllUntil(boost::get_system_time() + duration, asReadLockIfPossible);
+    }
+
     /**
      * Unlocks all locks through to the input lock/position.
      */
@@ -324,7 +528,7 @@ public:
             }
         }
     }
-    void unlock(boost::shared_ptr<Lockable> lock) {
+    void unlock(const boost::shared_ptr<Lockable>& lock) {
         long lockPos = getLockPosition(lock);
         if (lockPos >= 0 && isLocked(lockPos)) {
             unlock(lockPos);
@@ -372,7 +576,7 @@ public:
             locks[position].setReadLockDefault(readLockByDefault);
         }
     }
-    void setLockDefaultType(boost::shared_ptr<Lockable> lock,
+    void setLockDefaultType(const boost::shared_ptr<Lockable>& lock,
             tribool readLockByDefault = tribool::indeterminate_value) {
         setLockDefaultType(getLockPosition(lock));
     }
@@ -388,20 +592,12 @@ public:
      * Avoiding adding locks after resource begins locking.
      */
     void addLockable(const boost::shared_ptr<Lockable> lock,
-            tribool defaultAsReadLock = tribool::indeterminate_value) {
+            tribool defaultAsReadLock = boost::logic::indeterminate) {
         // Make sure we're given an actual lock and not an empty pointer
         if (lock) {
-            LockableReference lockRef(lock, defaultAsReadLock);
-            bool needSorting = false;
-            if (!locks.empty() && lockableLargestFirstCompare(lockRef, locks[locks.size()-1])) {
-                needSorting = true;
-            }
             // Unlock all locks
             unlock();
-            locks.push_back(lockRef);
-            if (needSorting) {
-                sortLocks();
-            }
+            insertLock(LockableReference(lock, defaultAsReadLock));
         }
     }
 
@@ -415,10 +611,12 @@ public:
      */
     void addResourceLockable(const ResourceLocker& other) {
         unlock();
+        locks.reserve(locks.size() + other.locks.size());
         for (long index = 0; index < (long)other.locks.size(); index++) {
-            locks.push_back(other.locks[index]);
+            LockableReference lockRef(other.locks[index]);
             // Our resource doesn't have any locks active yet
-            locks[locks.size()-1].setting = UNLOCKED;
+            lockRef.setting = UNLOCKED;
+            locks.push_back(lockRef);
         }
         sortLocks();
     }
@@ -432,8 +630,11 @@ public:
 
     explicit ResourceLocker(std::vector<boost::shared_ptr<Lockable> >& lockVect) {
         nextLockIndex = 0;
+        locks.reserve(lockVect.size());
         for (long index = 0; index < (long)lockVect.size(); index++) {
-            locks.push_back(LockableReference(lockVect[index]));
+            if (lockVect[index]) {
+                locks.push_back(LockableReference(lockVect[index]));
+            }
         }
         sortLocks();
     }
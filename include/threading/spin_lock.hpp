@@ -0,0 +1,312 @@
+/**
+ * @file spin_lock.h
+ *
+ * Defines adaptive spinning mutexes, which spin briefly before parking
+ * the thread, and their Lockable wrappers.
+ */
+
+#ifndef SPIN_LOCK_H_
+#define SPIN_LOCK_H_
+
+#include "lockable.hpp"
+#include "atomics.hpp"
+
+// Don't listen to warnings about boost on msvc
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(push, 0)
+#endif
+#include <boost/noncopyable.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(pop)
+#endif
+
+namespace core { namespace threading {
+
+/*
+ * The most times a spinning mutex polls the lock before parking.
+ */
+#ifndef CORE_MAX_SPIN_COUNT
+#   define CORE_MAX_SPIN_COUNT 1000
+#endif
+
+namespace hidden {
+/*
+ * Parks threads until some bits of a lock state clear. Unlockers
+ * only touch the kernel objects when a thread is actually parked.
+ */
+class SpinParker : private boost::noncopyable {
+private:
+    struct MaskClear {
+        const boost::atomic<boost::uint32_t>& state;
+        const boost::uint32_t mask;
+        MaskClear(const boost::atomic<boost::uint32_t>& lockState, boost::uint32_t lockMask) :
+            state(lockState), mask(lockMask) {}
+        bool operator()() const {
+            return (state.load(boost::memory_order_seq_cst) & mask) == 0;
+        }
+    };
+
+    boost::atomic<boost::uint32_t> parked;
+    boost::mutex parkMutex;
+    boost::condition_variable parkCondition;
+
+public:
+    SpinParker() : parkMutex(), parkCondition() {
+        parked.store(0, boost::memory_order_relaxed);
+    }
+
+    /* Blocks while any of the masked bits are set in state */
+    void parkWhile(const boost::atomic<boost::uint32_t>& state, boost::uint32_t mask) {
+        parkUntil(MaskClear(state, mask));
+    }
+
+    /*
+     * Blocks until done() returns true. done must read the lock state
+     * with sequentially consistent loads, and whoever changes that
+     * state must call wakeOne or wakeAll afterwards.
+     */
+    template<typename Predicate>
+    void parkUntil(Predicate done) {
+        // Sequentially consistent so that either we see the unlocker's
+        // state change or the unlocker sees us parked
+        parked.fetch_add(1, boost::memory_order_seq_cst);
+        {
+            boost::mutex::scoped_lock lock(parkMutex);
+            while (!done()) {
+                parkCondition.wait(lock);
+            }
+        }
+        parked.fetch_sub(1, boost::memory_order_relaxed);
+    }
+
+    /* Wakes one parked thread, if there is one */
+    void wakeOne() {
+        if (parked.load(boost::memory_order_seq_cst) > 0) {
+            boost::mutex::scoped_lock lock(parkMutex);
+            parkCondition.notify_one();
+        }
+    }
+
+    /* Wakes all parked threads, if there are any */
+    void wakeAll() {
+        if (parked.load(boost::memory_order_seq_cst) > 0) {
+            boost::mutex::scoped_lock lock(parkMutex);
+            parkCondition.notify_all();
+        }
+    }
+};
+
+/*
+ * Tracks how long a lock usually takes to come free, so spinners
+ * give up early on locks which are held for a long time.
+ */
+class SpinEstimate {
+private:
+    boost::atomic<boost::uint32_t> estimate;
+
+public:
+    SpinEstimate() {
+        estimate.store(CORE_MAX_SPIN_COUNT / 10, boost::memory_order_relaxed);
+    }
+
+    /* Returns how many times to poll before parking */
+    boost::uint32_t limit() const {
+        boost::uint32_t spins = estimate.load(boost::memory_order_relaxed) * 2 + 10;
+        return spins < CORE_MAX_SPIN_COUNT ? spins : CORE_MAX_SPIN_COUNT;
+    }
+
+    /* Folds in the number of polls the last acquisition took */
+    void update(boost::uint32_t spins) {
+        boost::uint32_t current = estimate.load(boost::memory_order_relaxed);
+        estimate.store(current + ((boost::int32_t)(spins - current) / 8), boost::memory_order_relaxed);
+    }
+};
+}
+
+/*
+ * An exclusive mutex which polls the lock a bounded, self-tuning
+ * number of times (pausing the processor between polls) before
+ * parking the thread. Short critical sections hand the lock over
+ * without a trip through the kernel.
+ *
+ * Meets the boost Lockable concept, so it can be used with the
+ * boost lock types and condition_variable_any.
+ */
+class SpinMutex : private boost::noncopyable {
+private:
+    static const boost::uint32_t UNLOCKED = 0;
+    static const boost::uint32_t LOCKED = 1;
+
+    boost::atomic<boost::uint32_t> state;
+    hidden::SpinEstimate spinEstimate;
+    hidden::SpinParker parker;
+
+public:
+    SpinMutex() : spinEstimate(), parker() {
+        state.store(UNLOCKED, boost::memory_order_release);
+    }
+
+    bool try_lock() {
+        boost::uint32_t expected = UNLOCKED;
+        return state.load(boost::memory_order_relaxed) == UNLOCKED &&
+               state.compare_exchange_strong(expected, LOCKED, boost::memory_order_acquire);
+    }
+
+    void lock() {
+        if (try_lock()) {
+            return;
+        }
+        for (;;) {
+            boost::uint32_t limit = spinEstimate.limit();
+            for (boost::uint32_t spins = 0; spins < limit; spins++) {
+                cpuRelax();
+                if (try_lock()) {
+                    spinEstimate.update(spins);
+                    return;
+                }
+            }
+            spinEstimate.update(limit);
+            parker.parkWhile(state, LOCKED);
+            if (try_lock()) {
+                return;
+            }
+        }
+    }
+
+    void unlock() {
+        state.store(UNLOCKED, boost::memory_order_seq_cst);
+        parker.wakeOne();
+    }
+};
+
+/*
+ * A reader/writer mutex with the same spin-then-park behaviour as
+ * SpinMutex. A waiting writer blocks new readers from entering, so
+ * writers are not starved by a stream of readers.
+ *
+ * Meets the boost SharedLockable concept.
+ */
+class SharedSpinMutex : private boost::noncopyable {
+private:
+    static const boost::uint32_t WRITER = 0x80000000u;
+    static const boost::uint32_t WRITER_WAITING = 0x40000000u;
+    static const boost::uint32_t READERS = 0x3FFFFFFFu;
+
+    boost::atomic<boost::uint32_t> state;
+    hidden::SpinEstimate spinEstimate;
+    hidden::SpinParker parker;
+
+public:
+    SharedSpinMutex() : spinEstimate(), parker() {
+        state.store(0, boost::memory_order_release);
+    }
+
+    bool try_lock() {
+        boost::uint32_t current = state.load(boost::memory_order_relaxed);
+        // Any waiting writer may take the lock, clearing the flag
+        return (current & (WRITER | READERS)) == 0 &&
+               state.compare_exchange_strong(current, WRITER, boost::memory_order_acquire);
+    }
+
+    void lock() {
+        if (try_lock()) {
+            return;
+        }
+        for (;;) {
+            boost::uint32_t limit = spinEstimate.limit();
+            for (boost::uint32_t spins = 0; spins < limit; spins++) {
+                boost::uint32_t current = state.load(boost::memory_order_relaxed);
+                if ((current & WRITER_WAITING) == 0) {
+                    state.fetch_or(WRITER_WAITING, boost::memory_order_relaxed);
+                }
+                cpuRelax();
+                if (try_lock()) {
+                    spinEstimate.update(spins);
+                    return;
+                }
+            }
+            spinEstimate.update(limit);
+            state.fetch_or(WRITER_WAITING, boost::memory_order_relaxed);
+            parker.parkWhile(state, WRITER | READERS);
+            if (try_lock()) {
+                return;
+            }
+        }
+    }
+
+    void unlock() {
+        // Keep any waiting flag another writer set while we held it
+        state.fetch_and(~WRITER, boost::memory_order_seq_cst);
+        parker.wakeAll();
+    }
+
+    bool try_lock_shared() {
+        boost::uint32_t current = state.load(boost::memory_order_relaxed);
+        return (current & (WRITER | WRITER_WAITING)) == 0 &&
+               state.compare_exchange_strong(current, current + 1, boost::memory_order_acquire);
+    }
+
+    void lock_shared() {
+        for (;;) {
+            boost::uint32_t limit = spinEstimate.limit();
+            for (boost::uint32_t spins = 0; spins < limit; spins++) {
+                if (try_lock_shared()) {
+                    return;
+                }
+                cpuRelax();
+            }
+            parker.parkWhile(state, WRITER | WRITER_WAITING);
+        }
+    }
+
+    void unlock_shared() {
+        boost::uint32_t previous = state.fetch_sub(1, boost::memory_order_seq_cst);
+        if ((previous & READERS) == 1) {
+            // Last reader out lets a waiting writer in
+            parker.wakeAll();
+        }
+    }
+};
+
+/**
+ * Write only adaptive spin lock
+ */
+class SpinLock : public Lockable {
+private:
+    SpinMutex mutex;
+    explicit SpinLock(const SpinLock&) : Lockable(), mutex() {}
+public:
+    explicit SpinLock(int priority = 0) : Lockable(priority), mutex() {}
+    virtual ~SpinLock() {}
+
+    void lock() { mutex.lock(); }
+    bool tryLock() { return mutex.try_lock(); }
+    void unlock() { mutex.unlock(); }
+};
+
+/**
+ * Read/Write adaptive spin lock
+ */
+class ReadWriteSpinLock : public ReadWriteLockable {
+private:
+    SharedSpinMutex mutex;
+    explicit ReadWriteSpinLock(const ReadWriteSpinLock&) : ReadWriteLockable(), mutex() {}
+
+public:
+    explicit ReadWriteSpinLock(int priority = 0) : ReadWriteLockable(priority), mutex() {}
+    virtual ~ReadWriteSpinLock() {}
+
+    void lock() { mutex.lock(); }
+    bool tryLock() { return mutex.try_lock(); }
+    void unlock() { mutex.unlock(); }
+
+    void lockShared() { mutex.lock_shared(); }
+    bool tryLockShared() { return mutex.try_lock_shared(); }
+    void unlockShared() { mutex.unlock_shared(); }
+};
+
+}}
+#endif /* SPIN_LOCK_H_ */
@@ -9,7 +9,8 @@
 #define THREAD_TRACKER_H_
 
 #include "threading/thread.hpp"
-#include "threading/container/tsvector.hpp"
+#include "threading/container/tscopyonwritewrapper.hpp"
+#include <vector>
 
 // Don't listen to warnings about boost on msvc
 #if defined(_MSC_VER) && (_MSC_VER >= 1500)
@@ -53,12 +54,11 @@ typedef boost::shared_ptr<ThreadTracker> ThreadTrackerPtr;
  */
 class ThreadManager {
 private:
-    // Yes, this will be expensive to operate on -- but we need shared semantics
-    typedef container::TSVector<ThreadTrackerPtr> ThreadVector;
-    typedef boost::shared_ptr<ThreadVector> ThreadVectorPtr;
+    // Lookups vastly outnumber thread starts and stops, so readers
+    // work on lock-free snapshots and writers copy the table
+    typedef container::TSCopyOnWriteWrapper<std::vector<ThreadTrackerPtr> > ThreadVector;
     typedef ThreadVector::WrapperType ThreadVectorType;
-    typedef ThreadVector::LockedWrapper LockedVectorPtr;
-    typedef ThreadVector::ReadLockedWrapper ReadLockedVectorPtr;
+    typedef ThreadVector::SnapshotPtr ThreadVectorSnapshot;
 
     ThreadVector threads;
     volatile boost::uint32_t curThreadCount;
@@ -1,8 +1,12 @@
 #include "logger.hpp"
 #include "application.hpp"
-#include "time.hpp"
 
 namespace core {
+// How long the sink worker waits for messages before checking if
+// the application is quitting
+const boost::posix_time::time_duration SINK_QUIT_CHECK_INTERVAL =
+        boost::posix_time::milliseconds(200);
+
 /*
  * Log Level Enum Definitions
  */
@@ -63,7 +67,9 @@ bool TSQueueSink::appLive() {
 void TSQueueSink::processQueue() {
     // Process all messages that are available
     while (!msgQueue.empty()) {
-        forEach(TimeLevelString& msg, *msgQueue.dequeueAll()) {
+        // Hold the list pointer so it outlives the loop
+        MessageQueue::QListPtr messages = msgQueue.dequeueAll();
+        forEach(TimeLevelString& msg, *messages) {
             processMessage(msg);
         }
     }
@@ -73,18 +79,20 @@ void TSQueueSink::processQueue() {
 /*
  * Performs all of the work required to process msgQueues
  * for incoming messages. Each such message is passed to
- * processMessage for final processing. Sink workers check
- * periodically to see if the app is still alive if no
- * messages have arrived.
+ * processMessage for final processing. Sink workers block
+ * on the queue and check periodically to see if the app is
+ * still alive if no messages have arrived.
  */
 void TSQueueSink::sinkWorker() {
     bool healthy = true;
     while(appLive() && healthy) {
         try {
-            processQueue();
-            // Sleep until our message queue is notified
-            // (or some time has passed)
-            condLock.timedWait(getFuture(200));
+            // Sleep until messages arrive (or some time has passed)
+            MessageQueue::QListPtr messages =
+                    msgQueue.dequeueAllWaitFor(SINK_QUIT_CHECK_INTERVAL);
+            forEach(TimeLevelString& msg, *messages) {
+                processMessage(msg);
+            }
         } catch (...) {
             healthy = false;
         }
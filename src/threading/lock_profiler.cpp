@@ -0,0 +1,99 @@
+#include "threading/lock_profiler.hpp"
+#include <algorithm>
+
+// Don't listen to warnings about boost on msvc
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(push, 0)
+#endif
+#include <boost/thread/locks.hpp>
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(pop)
+#endif
+
+namespace core { namespace threading {
+
+/*
+ * The profiler is deliberately leaked, so that locks destroyed during
+ * static destruction can still unregister from it.
+ */
+LockProfiler& LockProfiler::instance() {
+    static LockProfiler *profiler = new LockProfiler();
+    return *profiler;
+}
+
+void LockProfiler::registerProfile(const LockProfile& profile) {
+    boost::lock_guard<boost::mutex> lock(registryMutex);
+    profiles.insert(&profile);
+}
+
+void LockProfiler::unregisterProfile(const LockProfile& profile) {
+    boost::lock_guard<boost::mutex> lock(registryMutex);
+    profiles.erase(&profile);
+}
+
+std::size_t LockProfiler::profileCount() {
+    boost::lock_guard<boost::mutex> lock(registryMutex);
+    return profiles.size();
+}
+
+/*
+ * Helper function which orders reports from most to least contended.
+ */
+static bool moreContended(const LockReport& first, const LockReport& second) {
+    if (first.contended != second.contended) {
+        return first.contended > second.contended;
+    }
+    return first.acquisitions > second.acquisitions;
+}
+
+std::vector<LockReport> LockProfiler::topContended(std::size_t count) {
+    std::vector<LockReport> reports;
+    {
+        boost::lock_guard<boost::mutex> lock(registryMutex);
+        for (std::set<const LockProfile *>::const_iterator iter = profiles.begin();
+                iter != profiles.end(); ++iter) {
+            const LockProfile& profile = **iter;
+            if (profile.contendedAcquisitions() == 0) {
+                continue;
+            }
+            LockReport report;
+            report.name = profile.getName();
+            report.priority = profile.getPriority();
+            report.profile = &profile;
+            report.acquisitions = profile.acquisitions();
+            report.contended = profile.contendedAcquisitions();
+            report.medianWait = profile.waitTimes().percentileUpperBound(50.0);
+            report.p99Wait = profile.waitTimes().percentileUpperBound(99.0);
+            report.medianHold = profile.holdTimes().percentileUpperBound(50.0);
+            report.p99Hold = profile.holdTimes().percentileUpperBound(99.0);
+            reports.push_back(report);
+        }
+    }
+    std::sort(reports.begin(), reports.end(), moreContended);
+    if (reports.size() > count) {
+        reports.resize(count);
+    }
+    return reports;
+}
+
+void LockProfiler::writeReport(std::ostream& out, std::size_t count) {
+    std::vector<LockReport> reports = topContended(count);
+    out << "Most contended locks (times are upper bounds in us):" << std::endl;
+    for (std::size_t i = 0; i < reports.size(); i++) {
+        const LockReport& report = reports[i];
+        out << "  ";
+        if (report.name.empty()) {
+            out << "<unnamed " << report.profile << ">";
+        } else {
+            out << report.name;
+        }
+        out << " priority=" << report.priority
+            << " acquired=" << report.acquisitions
+            << " contended=" << report.contended
+            << " wait(p50/p99)=" << report.medianWait << "/" << report.p99Wait
+            << " hold(p50/p99)=" << report.medianHold << "/" << report.p99Hold
+            << std::endl;
+    }
+}
+
+}}
@@ -0,0 +1,73 @@
+#include "threading/queue_lock.hpp"
+#include <vector>
+
+// Don't listen to warnings about boost on msvc
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(push, 0)
+#endif
+#include <boost/thread/tss.hpp>
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(pop)
+#endif
+
+namespace core { namespace threading { namespace hidden {
+
+/*
+ * The free queue nodes of one thread, deleted when the thread exits.
+ */
+class QueueNodePool : private boost::noncopyable {
+private:
+    std::vector<PaddedQueueNode *> nodes;
+
+public:
+    QueueNodePool() : nodes() {}
+
+    ~QueueNodePool() {
+        for (std::size_t i = 0; i < nodes.size(); i++) {
+            delete nodes[i];
+        }
+    }
+
+    PaddedQueueNode *acquire() {
+        if (nodes.empty()) {
+            return new PaddedQueueNode();
+        }
+        PaddedQueueNode *node = nodes.back();
+        nodes.pop_back();
+        return node;
+    }
+
+    void release(PaddedQueueNode *node) {
+        nodes.push_back(node);
+    }
+};
+
+/*
+ * Leaked like the lock profiler, so nodes can still be released by
+ * locks unlocked during static destruction.
+ */
+static boost::thread_specific_ptr<QueueNodePool>& threadPools() {
+    static boost::thread_specific_ptr<QueueNodePool> *pools =
+        new boost::thread_specific_ptr<QueueNodePool>();
+    return *pools;
+}
+
+static QueueNodePool& threadPool() {
+    boost::thread_specific_ptr<QueueNodePool>& pools = threadPools();
+    QueueNodePool *pool = pools.get();
+    if (pool == NULL) {
+        pool = new QueueNodePool();
+        pools.reset(pool);
+    }
+    return *pool;
+}
+
+PaddedQueueNode *acquireQueueNode() {
+    return threadPool().acquire();
+}
+
+void releaseQueueNode(PaddedQueueNode *node) {
+    threadPool().release(node);
+}
+
+}}}
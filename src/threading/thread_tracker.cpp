@@ -25,7 +25,9 @@ ThreadTrackerPtr ThreadManager::trackThread(const std::string& name, ThreadPtr t
     ThreadTrackerPtr track = ThreadTrackerPtr
         (new ThreadTracker(name, atomic::atomic_inc32(&curThreadCount),
                            thrd, application));
-    threads.push_back(track);
+    ThreadVector::Writer writer(threads);
+    writer->push_back(track);
+    writer.publish();
     return track;
 }
 
@@ -42,26 +44,48 @@ ThreadTrackerPtr ThreadManager::spawnThread(const std::string& name, boost::func
 
 ThreadTrackerPtr ThreadManager::stopTrackingThreadImpl(
         boost::function1<bool, ThreadTrackerPtr> checkFound) {
-    bool found = false;
-    // This gives us a scope locked wrapper on our vector
-    LockedVectorPtr lockedThreads = threads.generateLockedReference();
-    // Need to expose the iterators so we can erase the item at the end
-    ThreadVectorType::iterator trackerIter = lockedThreads->begin();
+    // Holds the write lock on a private copy of the thread table
+    ThreadVector::Writer writer(threads);
     ThreadTrackerPtr thd;
-    while(trackerIter != lockedThreads->end()) {
+    for (ThreadVectorType::iterator trackerIter = writer->begin();
+            trackerIter != writer->end(); trackerIter++) {
         if (checkFound(*trackerIter)) {
-            found = true;
             thd = *trackerIter;
-            break;
+            writer->erase(trackerIter);
+            writer.publish();
+            return thd;
         }
-        trackerIter++;
-    }
-    if (found) {
-        lockedThreads->erase(trackerIter);
     }
+    // Nothing changed, so the copy is dropped unpublished
     return thd;
 }
 
+/*
+ * Functions that provide various ways of retrieving thread objects.
+ * Returns the first thread which matches, searching a snapshot of the
+ * thread table without taking any locks.
+ */
+ThreadTrackerPtr ThreadManager::getThread(const std::string& name) {
+    ThreadVectorSnapshot snapshot = threads.snapshot();
+    for (ThreadVectorType::const_iterator trackerIter = snapshot->begin();
+            trackerIter != snapshot->end(); trackerIter++) {
+        if (name.compare((*trackerIter)->name) == 0) {
+            return *trackerIter;
+        }
+    }
+    return ThreadTrackerPtr();
+}
+ThreadTrackerPtr ThreadManager::getThread(const boost::thread::id id) {
+    ThreadVectorSnapshot snapshot = threads.snapshot();
+    for (ThreadVectorType::const_iterator trackerIter = snapshot->begin();
+            trackerIter != snapshot->end(); trackerIter++) {
+        if ((*trackerIter)->thread->get_id() == id) {
+            return *trackerIter;
+        }
+    }
+    return ThreadTrackerPtr();
+}
+
 /*
  * Helper functions which define the comparison process for stopping by
  * name or id.
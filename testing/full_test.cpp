@@ -18,6 +18,24 @@
 #include "test_string_util.hpp"
 #include "test_exceptions.hpp"
 #include "test_ts_queue.hpp"
+#include "test_ts_vector.hpp"
+#include "test_ts_ring_queue.hpp"
+#include "test_ts_spsc_queue.hpp"
+#include "test_ts_priority_queue.hpp"
+#include "test_ts_sharded_queue.hpp"
+#include "test_ts_ring_buffer.hpp"
+#include "test_ts_hash_map.hpp"
+#include "test_ts_chunked_vector.hpp"
+#include "test_ts_skip_list_map.hpp"
+#include "test_spin_lock.hpp"
+#include "test_condition_lock.hpp"
+#include "test_distributed_lock.hpp"
+#include "test_queue_lock.hpp"
+#include "test_lock_profiler.hpp"
+#include "test_resource_locker.hpp"
+#include "test_ts_static_wrapper.hpp"
+#include "test_ts_seq_wrapper.hpp"
+#include "test_ts_copy_on_write_wrapper.hpp"
 #include "test_pp_types.hpp"
 #include "test_smart_pointer.hpp"
 #include "test_loops.hpp"
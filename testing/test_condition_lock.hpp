@@ -0,0 +1,107 @@
+/*
+ * Tests the functionality of the condition locks. If the class fails it
+ * will throw an exception, indicating where failure occured.
+ */
+
+#ifndef TEST_ENVIRONMENT_CONDITIONLOCK_HPP_
+#define TEST_ENVIRONMENT_CONDITIONLOCK_HPP_
+
+#include "threading/condition_lockable.hpp"
+#include "threading/thread.hpp"
+
+// Don't listen to warnings about boost on msvc
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(push, 0)
+#endif
+#include <boost/bind.hpp>
+#include <boost/ref.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/test/unit_test.hpp>
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(pop)
+#endif
+
+namespace core {
+BOOST_AUTO_TEST_SUITE(ConditionLockTests)
+
+using core::threading::Thread;
+using core::threading::Condition;
+using core::threading::ConditionLock;
+using core::threading::ConditionLockProxy;
+
+/* Sets the flag under the lock after a short delay, then notifies */
+void conditionSetter(Condition& cond, bool& flag, bool notifyAll) {
+    boost::this_thread::sleep(boost::posix_time::milliseconds(20));
+    cond.lock();
+    flag = true;
+    cond.unlock();
+    if (notifyAll) {
+        cond.notifyAll();
+    } else {
+        cond.notifyOne();
+    }
+}
+
+struct FlagSet {
+    bool *flag;
+    explicit FlagSet(bool& setFlag) : flag(&setFlag) {}
+    bool operator()() const {
+        return *flag;
+    }
+};
+
+/* Tests basic functionality */
+BOOST_AUTO_TEST_CASE(conditionLockBasicFunctions) {
+    ConditionLock cond;
+    // Notifying with nobody waiting is a no-op
+    cond.notifyOne();
+    cond.notifyAll();
+
+    cond.lock();
+    BOOST_REQUIRE(!cond.timedWait(boost::posix_time::milliseconds(5)));
+    BOOST_REQUIRE_MESSAGE(!cond.tryLock(), "Timed wait did not relock");
+    bool flag = false;
+    BOOST_REQUIRE(!cond.timedWait(boost::posix_time::milliseconds(5), FlagSet(flag)));
+    cond.unlock();
+
+    Thread setter(boost::bind(&conditionSetter, boost::ref(cond), boost::ref(flag), false));
+    cond.lock();
+    cond.wait(FlagSet(flag));
+    BOOST_REQUIRE(flag);
+    cond.unlock();
+    setter.join();
+
+    flag = false;
+    Thread allSetter(boost::bind(&conditionSetter, boost::ref(cond), boost::ref(flag), true));
+    cond.lock();
+    BOOST_REQUIRE(cond.timedWait(boost::posix_time::milliseconds(10000), FlagSet(flag)));
+    cond.unlock();
+    allSetter.join();
+}
+
+/* Tests that proxies and direct condition variable users are notified */
+BOOST_AUTO_TEST_CASE(conditionLockProxyAndDirect) {
+    boost::shared_ptr<ConditionLock> cond(new ConditionLock());
+    ConditionLockProxy proxy(cond);
+    bool flag = false;
+
+    Thread setter(boost::bind(&conditionSetter, boost::ref(*cond), boost::ref(flag), false));
+    proxy.lock();
+    proxy.wait(FlagSet(flag));
+    proxy.unlock();
+    setter.join();
+
+    flag = false;
+    Thread directSetter(boost::bind(&conditionSetter, boost::ref(*cond), boost::ref(flag), false));
+    cond->lock();
+    while (!flag) {
+        cond->getConditionVariable().wait(*cond);
+    }
+    cond->unlock();
+    directSetter.join();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}
+
+#endif
@@ -0,0 +1,156 @@
+/*
+ * Tests the functionality of the distributed reader/writer lock. If the
+ * class fails it will throw an exception, indicating where failure occured.
+ */
+
+#ifndef TEST_ENVIRONMENT_DISTRIBUTEDLOCK_HPP_
+#define TEST_ENVIRONMENT_DISTRIBUTEDLOCK_HPP_
+
+#include "threading/distributed_lock.hpp"
+#include "threading/container/tsvector.hpp"
+#include "threading/atomics.hpp"
+#include "threading/thread.hpp"
+#include "pointers.hpp"
+
+// Don't listen to warnings about boost on msvc
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(push, 0)
+#endif
+#include <boost/bind.hpp>
+#include <boost/ref.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/test/unit_test.hpp>
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(pop)
+#endif
+
+namespace core {
+BOOST_AUTO_TEST_SUITE(DistributedLockTests)
+
+using core::threading::Thread;
+using core::threading::DistributedReadWriteLock;
+using namespace core::threading::container;
+
+/* Tests basic functionality */
+BOOST_AUTO_TEST_CASE(distributedLockBasicFunctions) {
+    DistributedReadWriteLock lock;
+    BOOST_REQUIRE(lock.isReadLockable());
+    BOOST_REQUIRE_EQUAL(lock.getPreference(), threading::PREFER_WRITERS);
+
+    lock.lockShared();
+    BOOST_REQUIRE(lock.tryLockShared());
+    BOOST_REQUIRE_MESSAGE(!lock.tryLock(), "Write locked while read locked");
+    lock.unlockShared();
+    lock.unlockShared();
+
+    lock.lock();
+    BOOST_REQUIRE_MESSAGE(!lock.tryLockShared(), "Read locked while write locked");
+    BOOST_REQUIRE_MESSAGE(!lock.tryLock(), "Write locked twice");
+    lock.unlock();
+    BOOST_REQUIRE(lock.tryLock());
+    lock.unlock();
+}
+
+void distributedWriteLocker(DistributedReadWriteLock& lock, boost::atomic<bool>& locked) {
+    lock.lock();
+    locked = true;
+    lock.unlock();
+}
+
+/* Tests that a waiting writer holds back new readers only when preferred */
+void checkDistributedPreference(threading::LockPreference preference) {
+    DistributedReadWriteLock lock(0, preference);
+    boost::atomic<bool> locked(false);
+    lock.lockShared();
+    Thread writer(boost::bind(&distributedWriteLocker, boost::ref(lock), boost::ref(locked)));
+    boost::this_thread::sleep(boost::posix_time::milliseconds(20));
+    BOOST_REQUIRE(!locked);
+    if (preference == threading::PREFER_WRITERS) {
+        BOOST_REQUIRE_MESSAGE(!lock.tryLockShared(), "Reader passed a waiting writer");
+    } else {
+        BOOST_REQUIRE_MESSAGE(lock.tryLockShared(), "Reader waited for a writer");
+        lock.unlockShared();
+    }
+    lock.unlockShared();
+    writer.join();
+    BOOST_REQUIRE(locked);
+}
+
+BOOST_AUTO_TEST_CASE(distributedLockPreference) {
+    checkDistributedPreference(threading::PREFER_WRITERS);
+    checkDistributedPreference(threading::PREFER_READERS);
+}
+
+void distributedReadLocker(DistributedReadWriteLock& lock) {
+    lock.lockShared();
+}
+
+/* Tests read locks released on a different thread than took them */
+BOOST_AUTO_TEST_CASE(distributedLockCrossThreadRelease) {
+    DistributedReadWriteLock lock;
+    int numReaders = 8;
+    for (int i = 0; i < numReaders; i++) {
+        Thread reader(boost::bind(&distributedReadLocker, boost::ref(lock)));
+        reader.join();
+    }
+    BOOST_REQUIRE(!lock.tryLock());
+    for (int i = 0; i < numReaders; i++) {
+        lock.unlockShared();
+    }
+    BOOST_REQUIRE_MESSAGE(lock.tryLock(), "Readers released elsewhere never drained");
+    lock.unlock();
+}
+
+/* Concurrency Testing */
+typedef TSVector<long, std::allocator<long>, threading::DistributedReadWriteConditionLock> DistributedVector;
+
+void distributedVectorWriter(DistributedVector& vect) {
+    // Do NOT use BOOST_TEST_MESSAGE here, it's not thread safe
+    for (long i = 0; i < 2000; i++) {
+        DistributedVector::ScopedLockedWrapper locked(vect.generateScopedLockedReference());
+        // Keep every element equal to the vector's size
+        for (std::size_t j = 0; j < locked->size(); j++) {
+            (*locked)[j]++;
+        }
+        locked->push_back((long)locked->size() + 1);
+    }
+}
+
+void distributedVectorReader(DistributedVector& vect, boost::atomic<bool>& torn) {
+    for (int i = 0; i < 5000; i++) {
+        DistributedVector::ScopedReadLockedWrapper locked(vect.generateScopedReadLockedReference());
+        for (std::size_t j = 0; j < locked->size(); j++) {
+            if ((*locked)[j] != (long)locked->size()) {
+                torn = true;
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(distributedLockConcurrency) {
+    DistributedVector vect;
+    boost::atomic<bool> torn(false);
+    boost::posix_time::time_duration wait = boost::posix_time::milliseconds(20000);
+    pointers::lists<Thread>::PtrVector thrds;
+    int numWriters = 2;
+    for (int i = 0; i < numWriters; i++) {
+        thrds.push_back(new Thread(boost::bind(&distributedVectorWriter, boost::ref(vect))));
+    }
+    for (int i = 0; i < 6; i++) {
+        thrds.push_back(new Thread(boost::bind(&distributedVectorReader,
+                boost::ref(vect), boost::ref(torn))));
+    }
+    for (std::size_t j = 0; j < thrds.size(); j++) {
+        if (!thrds[j].timed_join(wait)) {
+            BOOST_FAIL("Thread timed out");
+        }
+    }
+    BOOST_REQUIRE_MESSAGE(!torn, "Reader saw a write in progress");
+    BOOST_REQUIRE_EQUAL(vect.size(), (std::size_t)numWriters * 2000);
+    BOOST_REQUIRE(!vect.empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}
+
+#endif
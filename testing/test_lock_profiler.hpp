@@ -0,0 +1,125 @@
+/*
+ * Tests the functionality of the lock profiler. If the class fails it
+ * will throw an exception, indicating where failure occured.
+ */
+
+#ifndef TEST_ENVIRONMENT_LOCKPROFILER_HPP_
+#define TEST_ENVIRONMENT_LOCKPROFILER_HPP_
+
+#include "threading/lock_profiler.hpp"
+#include "threading/lockable.hpp"
+#include "threading/container/tswrapper.hpp"
+#include "threading/thread.hpp"
+#include <vector>
+#include <sstream>
+
+// Don't listen to warnings about boost on msvc
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(push, 0)
+#endif
+#include <boost/bind.hpp>
+#include <boost/ref.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/test/unit_test.hpp>
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(pop)
+#endif
+
+namespace core {
+BOOST_AUTO_TEST_SUITE(LockProfilerTests)
+
+using core::threading::Thread;
+using core::threading::Lockable;
+using core::threading::LockProfiler;
+using core::threading::LockReport;
+
+typedef threading::ProfiledLock<threading::WriteLock> ProfiledWriteLock;
+typedef threading::ProfiledReadWriteLock<threading::ReadWriteLock> ProfiledRWLock;
+
+void profiledLockWorker(Lockable& lock) {
+    lock.lock();
+    lock.unlock();
+}
+
+/* Tests that profiles count acquisitions and contention */
+BOOST_AUTO_TEST_CASE(lockProfilerCounts) {
+    std::size_t registered = LockProfiler::instance().profileCount();
+    {
+        ProfiledWriteLock lock("hotLock", 3);
+        BOOST_REQUIRE_EQUAL(LockProfiler::instance().profileCount(), registered + 1);
+
+        lock.lock();
+        lock.unlock();
+        BOOST_REQUIRE(lock.tryLock());
+        lock.unlock();
+        BOOST_REQUIRE_EQUAL(lock.getProfile().acquisitions(), 2U);
+        BOOST_REQUIRE_EQUAL(lock.getProfile().contendedAcquisitions(), 0U);
+        BOOST_REQUIRE_EQUAL(lock.getProfile().holdTimes().totalCount(), 2U);
+
+        // Force one contended acquisition
+        lock.lock();
+        Thread waiter(boost::bind(&profiledLockWorker, boost::ref(lock)));
+        boost::this_thread::sleep(boost::posix_time::milliseconds(20));
+        lock.unlock();
+        waiter.join();
+        BOOST_REQUIRE_EQUAL(lock.getProfile().acquisitions(), 4U);
+        BOOST_REQUIRE_EQUAL(lock.getProfile().contendedAcquisitions(), 1U);
+        BOOST_REQUIRE_EQUAL(lock.getProfile().waitTimes().totalCount(), 1U);
+
+        ProfiledRWLock rwLock("readLock");
+        BOOST_REQUIRE(rwLock.tryLockShared());
+        rwLock.lockShared();
+        rwLock.unlockShared();
+        rwLock.unlockShared();
+        BOOST_REQUIRE_EQUAL(rwLock.getProfile().acquisitions(), 2U);
+
+        std::vector<LockReport> reports = LockProfiler::instance().topContended(10);
+        bool found = false;
+        for (std::size_t i = 0; i < reports.size(); i++) {
+            if (reports[i].name == "hotLock") {
+                found = true;
+                BOOST_REQUIRE_EQUAL(reports[i].priority, 3);
+                BOOST_REQUIRE_EQUAL(reports[i].contended, 1U);
+                BOOST_REQUIRE(reports[i].medianWait >= 1000U);
+            }
+            BOOST_REQUIRE_MESSAGE(reports[i].name != "readLock", "Reported an uncontended lock");
+        }
+        BOOST_REQUIRE_MESSAGE(found, "Contended lock missing from report");
+
+        std::ostringstream out;
+        LockProfiler::instance().writeReport(out, 10);
+        BOOST_REQUIRE(out.str().find("hotLock") != std::string::npos);
+    }
+    BOOST_REQUIRE_EQUAL(LockProfiler::instance().profileCount(), registered);
+}
+
+/* Tests that profiled condition locks still work inside wrappers */
+typedef threading::container::TSWrapper<std::vector<int>,
+        threading::ProfiledLock<threading::ConditionLock> > ProfiledWrappedVector;
+
+void profiledWrapperNotifyWorker(ProfiledWrappedVector& wrapped) {
+    boost::this_thread::sleep(boost::posix_time::milliseconds(20));
+    ProfiledWrappedVector::ScopedLockedWrapper locked(wrapped.generateScopedLockedReference());
+    locked->push_back(1);
+    locked.getCondition().notifyAll();
+}
+
+BOOST_AUTO_TEST_CASE(lockProfilerWrapper) {
+    ProfiledWrappedVector wrapped;
+    wrapped.getMutex().getProfile().setName("wrappedVector");
+    Thread notifier(boost::bind(&profiledWrapperNotifyWorker, boost::ref(wrapped)));
+    {
+        ProfiledWrappedVector::ScopedLockedWrapper locked(wrapped.generateScopedLockedReference());
+        while (locked->empty()) {
+            locked.getCondition().wait();
+        }
+        BOOST_REQUIRE_EQUAL(locked->front(), 1);
+    }
+    notifier.join();
+    BOOST_REQUIRE(wrapped.getMutex().getProfile().acquisitions() >= 3U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}
+
+#endif
@@ -0,0 +1,117 @@
+/*
+ * Tests the functionality of the fair queue lock. If the class fails it
+ * will throw an exception, indicating where failure occured.
+ */
+
+#ifndef TEST_ENVIRONMENT_QUEUELOCK_HPP_
+#define TEST_ENVIRONMENT_QUEUELOCK_HPP_
+
+#include "threading/queue_lock.hpp"
+#include "threading/container/tswrapper.hpp"
+#include "threading/thread.hpp"
+#include "pointers.hpp"
+#include <vector>
+
+// Don't listen to warnings about boost on msvc
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(push, 0)
+#endif
+#include <boost/bind.hpp>
+#include <boost/ref.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/test/unit_test.hpp>
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(pop)
+#endif
+
+namespace core {
+BOOST_AUTO_TEST_SUITE(QueueLockTests)
+
+using core::threading::Thread;
+using core::threading::QueueLock;
+
+/* Tests basic functionality */
+BOOST_AUTO_TEST_CASE(queueLockBasicFunctions) {
+    QueueLock first;
+    QueueLock second;
+    first.lock();
+    BOOST_REQUIRE_MESSAGE(!first.tryLock(), "Locked twice");
+    // Holding several queue locks at once takes a node for each
+    BOOST_REQUIRE(second.tryLock());
+    first.unlock();
+    BOOST_REQUIRE(first.tryLock());
+    second.unlock();
+    first.unlock();
+    BOOST_REQUIRE(second.tryLock());
+    second.unlock();
+}
+
+/* Records the order in which threads got the lock */
+void queueLockOrderWorker(QueueLock& lock, std::vector<int>& order, int id) {
+    lock.lock();
+    order.push_back(id);
+    lock.unlock();
+}
+
+BOOST_AUTO_TEST_CASE(queueLockFifoHandoff) {
+    QueueLock lock;
+    std::vector<int> order;
+    pointers::lists<Thread>::PtrVector thrds;
+    lock.lock();
+    for (int i = 0; i < 4; i++) {
+        thrds.push_back(new Thread(boost::bind(&queueLockOrderWorker,
+                boost::ref(lock), boost::ref(order), i)));
+        // Let each thread queue up before starting the next
+        boost::this_thread::sleep(boost::posix_time::milliseconds(20));
+    }
+    lock.unlock();
+    for (std::size_t j = 0; j < thrds.size(); j++) {
+        thrds[j].join();
+    }
+    BOOST_REQUIRE_EQUAL(order.size(), 4U);
+    for (int i = 0; i < 4; i++) {
+        BOOST_REQUIRE_EQUAL(order[i], i);
+    }
+}
+
+/* Concurrency Testing */
+typedef threading::container::TSWrapper<std::vector<int>, threading::QueueConditionLock> QueueWrappedVector;
+
+void queueLockWorker(QueueWrappedVector& wrapped) {
+    // Do NOT use BOOST_TEST_MESSAGE here, it's not thread safe
+    for (int i = 0; i < 10000; i++) {
+        QueueWrappedVector::ScopedLockedWrapper locked(wrapped.generateScopedLockedReference());
+        locked->push_back(i);
+        if (locked->size() % 100 == 0) {
+            locked.getCondition().notifyAll();
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(queueLockConcurrency) {
+    QueueWrappedVector wrapped;
+    boost::posix_time::time_duration wait = boost::posix_time::milliseconds(20000);
+    pointers::lists<Thread>::PtrVector thrds;
+    int numThreads = 4;
+    for (int i = 0; i < numThreads; i++) {
+        thrds.push_back(new Thread(boost::bind(&queueLockWorker, boost::ref(wrapped))));
+    }
+    {
+        QueueWrappedVector::ScopedLockedWrapper locked(wrapped.generateScopedLockedReference());
+        while (locked->size() < 100) {
+            locked.getCondition().wait();
+        }
+    }
+    for (std::size_t j = 0; j < thrds.size(); j++) {
+        if (!thrds[j].timed_join(wait)) {
+            BOOST_FAIL("Thread timed out");
+        }
+    }
+    QueueWrappedVector::ScopedLockedWrapper locked(wrapped.generateScopedLockedReference());
+    BOOST_REQUIRE_EQUAL(locked->size(), (std::size_t)numThreads * 10000);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}
+
+#endif
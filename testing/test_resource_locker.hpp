@@ -0,0 +1,217 @@
+/*
+ * Tests the functionality of the resource locker. If the class fails it
+ * will throw an exception, indicating where failure occured.
+ */
+
+#ifndef TEST_ENVIRONMENT_RESOURCELOCKER_HPP_
+#define TEST_ENVIRONMENT_RESOURCELOCKER_HPP_
+
+#include "threading/resource_locker.hpp"
+#include "threading/lockable.hpp"
+#include "threading/thread.hpp"
+#include "pointers.hpp"
+#include <vector>
+
+// Don't listen to warnings about boost on msvc
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(push, 0)
+#endif
+#include <boost/bind.hpp>
+#include <boost/ref.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/test/unit_test.hpp>
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(pop)
+#endif
+
+namespace core {
+BOOST_AUTO_TEST_SUITE(ResourceLockerTests)
+
+using core::threading::Thread;
+using core::threading::Lockable;
+using core::threading::LockablePtr;
+using core::threading::ResourceLocker;
+
+/* Tests basic functionality */
+BOOST_AUTO_TEST_CASE(resourceLockerBasicFunctions) {
+    LockablePtr first(new threading::WriteLock());
+    LockablePtr second(new threading::ReadWriteLock());
+    ResourceLocker locker;
+    locker.addLockable(first);
+    locker.addLockable(second, true);
+
+    locker.lock();
+    BOOST_REQUIRE(locker.allLocked());
+    BOOST_REQUIRE_MESSAGE(!first->tryLock(), "Resource did not lock");
+    locker.unlock();
+    BOOST_REQUIRE(locker.noneLocked());
+
+    locker.lockAllWithBackoff();
+    BOOST_REQUIRE(locker.allLocked());
+    BOOST_REQUIRE_MESSAGE(!first->tryLock(), "Resource did not lock");
+    BOOST_REQUIRE_MESSAGE(!second->tryLock(), "Resource did not read lock");
+    BOOST_REQUIRE_MESSAGE(second->tryLockSharedIfPossible(), "Resource write locked a read lock");
+    second->unlockSharedIfPossible();
+    locker.unlock();
+    BOOST_REQUIRE(first->tryLock());
+    first->unlock();
+}
+
+/* Tests that an explicit read request overrides a write lock default */
+BOOST_AUTO_TEST_CASE(resourceLockerExplicitReadLock) {
+    LockablePtr shared(new threading::ReadWriteLock());
+    ResourceLocker locker;
+    locker.addLockable(shared, false);
+
+    locker.lock(shared, true);
+    BOOST_REQUIRE_MESSAGE(shared->tryLockSharedIfPossible(), "Ignored the read lock request");
+    shared->unlockSharedIfPossible();
+    locker.unlock();
+
+    locker.lock();
+    BOOST_REQUIRE_MESSAGE(!shared->tryLockSharedIfPossible(), "Ignored the write lock default");
+    locker.unlock();
+}
+
+/* Tests that read/write locks added without a default are read locked */
+BOOST_AUTO_TEST_CASE(resourceLockerUnsetDefault) {
+    LockablePtr exclusive(new threading::WriteLock());
+    LockablePtr shared(new threading::ReadWriteLock());
+    ResourceLocker locker;
+    locker.addLockable(exclusive);
+    locker.addLockable(shared);
+
+    locker.lock();
+    BOOST_REQUIRE_MESSAGE(!exclusive->tryLock(), "Resource did not lock");
+    BOOST_REQUIRE_MESSAGE(shared->tryLockSharedIfPossible(), "Resource write locked a read lock");
+    shared->unlockSharedIfPossible();
+    locker.unlock();
+}
+
+/* Tests lock lookup for lock sets which outgrow the inline storage */
+BOOST_AUTO_TEST_CASE(resourceLockerLockPositions) {
+    std::vector<LockablePtr> locks;
+    for (int i = 0; i < 20; i++) {
+        locks.push_back(LockablePtr(new threading::WriteLock(i % 3)));
+    }
+    ResourceLocker locker;
+    LockablePtr stranger(new threading::WriteLock());
+    for (std::size_t i = 0; i < locks.size(); i++) {
+        locker.addLockable(locks[i]);
+        for (std::size_t j = 0; j <= i; j++) {
+            long pos = locker.getLockPosition(locks[j]);
+            BOOST_REQUIRE(pos >= 0);
+            BOOST_REQUIRE(locker.getLock(pos) == locks[j]);
+        }
+        BOOST_REQUIRE(!locker.containsLock(stranger));
+        BOOST_REQUIRE(!locker.isLocked(stranger));
+    }
+    BOOST_REQUIRE_EQUAL(locker.getNumLocks(), 20);
+    for (long pos = 1; pos < locker.getNumLocks(); pos++) {
+        BOOST_REQUIRE(*locker.getLock(pos - 1) >= *locker.getLock(pos));
+    }
+
+    ResourceLocker copy(locker);
+    BOOST_REQUIRE_EQUAL(copy.getNumLocks(), 20);
+    long middle = locker.getLockPosition(locks[10]);
+    BOOST_REQUIRE_EQUAL(copy.getLockPosition(locks[10]), middle);
+    ResourceLocker fromVector(locks);
+    for (std::size_t i = 0; i < locks.size(); i++) {
+        BOOST_REQUIRE_EQUAL(fromVector.getLockPosition(locks[i]), locker.getLockPosition(locks[i]));
+    }
+    // A duplicate lock reports the first of its positions
+    copy.addLockable(locks[5]);
+    long duplicate = copy.getLockPosition(locks[5]);
+    BOOST_REQUIRE(copy.getLock(duplicate) == locks[5]);
+    for (long pos = 0; pos < duplicate; pos++) {
+        BOOST_REQUIRE(copy.getLock(pos) != locks[5]);
+    }
+
+    locker.lock(locks[10]);
+    BOOST_REQUIRE(locker.isLocked(locks[10]));
+    BOOST_REQUIRE_EQUAL(locker.getCurrentLockPosition(), middle);
+    locker.unlock(locks[10]);
+    BOOST_REQUIRE(!locker.isLocked(locks[10]));
+    BOOST_REQUIRE_EQUAL(locker.getCurrentLockPosition(), middle - 1);
+    locker.unlock();
+    BOOST_REQUIRE(locker.noneLocked());
+}
+
+/* Holds a lock from another thread for a while */
+void resourceLockHolder(LockablePtr lock, boost::posix_time::time_duration hold) {
+    lock->lock();
+    boost::this_thread::sleep(hold);
+    lock->unlock();
+}
+
+BOOST_AUTO_TEST_CASE(resourceLockerTimedLock) {
+    LockablePtr first(new threading::WriteLock());
+    LockablePtr second(new threading::WriteLock());
+    ResourceLocker locker;
+    locker.addLockable(first);
+    locker.addLockable(second);
+
+    second->lock();
+    BOOST_REQUIRE_MESSAGE(!locker.tryLockAllFor(boost::posix_time::milliseconds(20)),
+                          "Locked a held lock");
+    BOOST_REQUIRE(locker.noneLocked());
+    BOOST_REQUIRE_MESSAGE(first->tryLock(), "Timed out without releasing its locks");
+    first->unlock();
+    second->unlock();
+
+    Thread holder(boost::bind(&resourceLockHolder, first, boost::posix_time::milliseconds(20)));
+    boost::this_thread::sleep(boost::posix_time::milliseconds(5));
+    BOOST_REQUIRE(locker.tryLockAllFor(boost::posix_time::milliseconds(5000)));
+    BOOST_REQUIRE(locker.allLocked());
+    locker.unlock();
+    holder.join();
+}
+
+/* Concurrency Testing */
+void resourceLockerWorker(ResourceLocker& locker, std::vector<int>& counters,
+                          std::size_t firstCounter, bool timed) {
+    // Do NOT use BOOST_TEST_MESSAGE here, it's not thread safe
+    for (int i = 0; i < 2000; i++) {
+        if (timed) {
+            while (!locker.tryLockAllFor(boost::posix_time::milliseconds(1))) {}
+        } else {
+            locker.lockAllWithBackoff();
+        }
+        counters[firstCounter]++;
+        counters[(firstCounter + 1) % counters.size()]++;
+        locker.unlock();
+    }
+}
+
+BOOST_AUTO_TEST_CASE(resourceLockerBackoffConcurrency) {
+    // Each worker locks a different overlapping pair of locks
+    std::size_t numLocks = 4;
+    std::vector<LockablePtr> locks;
+    for (std::size_t i = 0; i < numLocks; i++) {
+        locks.push_back(LockablePtr(new threading::WriteLock()));
+    }
+    std::vector<int> counters(numLocks, 0);
+    pointers::lists<ResourceLocker>::PtrVector lockers;
+    boost::posix_time::time_duration wait = boost::posix_time::milliseconds(10000);
+    pointers::lists<Thread>::PtrVector thrds;
+    for (std::size_t i = 0; i < numLocks; i++) {
+        lockers.push_back(new ResourceLocker());
+        lockers[i].addLockable(locks[i]);
+        lockers[i].addLockable(locks[(i + 1) % numLocks]);
+        thrds.push_back(new Thread(boost::bind(&resourceLockerWorker, boost::ref(lockers[i]),
+                boost::ref(counters), i, i % 2 == 0)));
+    }
+    for (std::size_t j = 0; j < thrds.size(); j++) {
+        if (!thrds[j].timed_join(wait)) {
+            BOOST_FAIL("Thread timed out");
+        }
+    }
+    for (std::size_t i = 0; i < numLocks; i++) {
+        BOOST_REQUIRE_EQUAL(counters[i], 2 * 2000);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}
+
+#endif
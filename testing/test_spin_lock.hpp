@@ -0,0 +1,151 @@
+/*
+ * Tests the performance of the spin lock classes. If the class fails it will
+ * throw an exception, indicating where failure occured.
+ */
+
+#ifndef TEST_ENVIRONMENT_SPINLOCK_HPP_
+#define TEST_ENVIRONMENT_SPINLOCK_HPP_
+
+#include "threading/spin_lock.hpp"
+#include "threading/container/tswrapper.hpp"
+#include "threading/atomics.hpp"
+#include "threading/thread.hpp"
+#include "pointers.hpp"
+#include <vector>
+
+// Don't listen to warnings about boost on msvc
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(push, 0)
+#endif
+#include <boost/bind.hpp>
+#include <boost/ref.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/test/unit_test.hpp>
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(pop)
+#endif
+
+namespace core {
+BOOST_AUTO_TEST_SUITE(SpinLockTests)
+
+using core::threading::Thread;
+using core::threading::Lockable;
+using core::threading::ReadWriteLockable;
+
+/* Tests basic functionality */
+BOOST_AUTO_TEST_CASE(spinLockBasicFunctions) {
+    threading::SpinLock lock;
+    BOOST_REQUIRE(lock.tryLock());
+    BOOST_REQUIRE_MESSAGE(!lock.tryLock(), "Locked a held spin lock");
+    lock.unlock();
+
+    threading::ReadWriteSpinLock rwLock;
+    BOOST_REQUIRE(rwLock.tryLockShared());
+    BOOST_REQUIRE(rwLock.tryLockShared());
+    BOOST_REQUIRE_MESSAGE(!rwLock.tryLock(), "Write locked a read held lock");
+    rwLock.unlockShared();
+    rwLock.unlockShared();
+    BOOST_REQUIRE(rwLock.tryLock());
+    BOOST_REQUIRE_MESSAGE(!rwLock.tryLockShared(), "Read locked a write held lock");
+    rwLock.unlock();
+}
+
+/* Concurrency Testing */
+void spinLockIncrementWorker(Lockable& lock, int& counter, bool longHold) {
+    // Do NOT use BOOST_TEST_MESSAGE here, it's not thread safe
+    for (int i = 0; i < 10000; i++) {
+        lock.lock();
+        counter++;
+        if (longHold && i % 1000 == 0) {
+            // Forces the other threads to park
+            boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+        }
+        lock.unlock();
+    }
+}
+
+void spinLockReadWorker(ReadWriteLockable& lock, int& counter, boost::atomic<bool>& torn) {
+    for (int i = 0; i < 10000; i++) {
+        lock.lockShared();
+        int first = counter;
+        int second = counter;
+        if (first != second) {
+            torn = true;
+        }
+        lock.unlockShared();
+    }
+}
+
+template<typename LockType>
+void testSpinLockConcurrency(bool longHold) {
+    LockType lock;
+    int counter = 0;
+    boost::posix_time::time_duration wait = boost::posix_time::milliseconds(10000);
+    pointers::lists<Thread>::PtrVector thrds;
+    int numWorkers = 8;
+    for (int i = 0; i < numWorkers; i++) {
+        thrds.push_back(new Thread(boost::bind(&spinLockIncrementWorker,
+                boost::ref(lock), boost::ref(counter), longHold)));
+    }
+    for (std::size_t j = 0; j < thrds.size(); j++) {
+        if (!thrds[j].timed_join(wait)) {
+            BOOST_FAIL("Thread timed out");
+        }
+    }
+    BOOST_REQUIRE_EQUAL(counter, numWorkers * 10000);
+}
+
+BOOST_AUTO_TEST_CASE(spinLockConcurrency) {
+    testSpinLockConcurrency<threading::SpinLock>(false);
+    testSpinLockConcurrency<threading::SpinLock>(true);
+}
+
+BOOST_AUTO_TEST_CASE(readWriteSpinLockConcurrency) {
+    threading::ReadWriteSpinLock lock;
+    int counter = 0;
+    boost::atomic<bool> torn(false);
+    boost::posix_time::time_duration wait = boost::posix_time::milliseconds(10000);
+    pointers::lists<Thread>::PtrVector thrds;
+    int numWorkers = 4;
+    for (int i = 0; i < numWorkers; i++) {
+        thrds.push_back(new Thread(boost::bind(&spinLockIncrementWorker,
+                boost::ref(lock), boost::ref(counter), i == 0)));
+        thrds.push_back(new Thread(boost::bind(&spinLockReadWorker,
+                boost::ref(lock), boost::ref(counter), boost::ref(torn))));
+    }
+    for (std::size_t j = 0; j < thrds.size(); j++) {
+        if (!thrds[j].timed_join(wait)) {
+            BOOST_FAIL("Thread timed out");
+        }
+    }
+    BOOST_REQUIRE_EQUAL(counter, numWorkers * 10000);
+    BOOST_REQUIRE_MESSAGE(!torn, "Reader saw a write in progress");
+}
+
+/* Wrapper Testing */
+typedef threading::container::TSWrapper<std::vector<int>, threading::SpinConditionLock> SpinWrappedVector;
+
+void spinWrapperNotifyWorker(pointers::smart<SpinWrappedVector>::SharedPtr wrapped) {
+    boost::this_thread::sleep(boost::posix_time::milliseconds(20));
+    SpinWrappedVector::LockedWrapper locked = wrapped->generateLockedConditionReference();
+    locked->push_back(1);
+    locked.getCondition().notifyAll();
+}
+
+BOOST_AUTO_TEST_CASE(spinLockWrapper) {
+    pointers::smart<SpinWrappedVector>::SharedPtr wrapped(new SpinWrappedVector());
+    Thread notifier(boost::bind(&spinWrapperNotifyWorker, wrapped));
+    {
+        SpinWrappedVector::LockedWrapper locked = wrapped->generateLockedConditionReference();
+        while (locked->empty()) {
+            locked.getCondition().wait();
+        }
+        BOOST_REQUIRE_EQUAL(locked->front(), 1);
+    }
+    notifier.join();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}
+
+#endif
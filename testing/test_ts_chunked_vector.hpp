@@ -0,0 +1,164 @@
+/*
+ * Tests the functionality of the append only chunked vector. If the class
+ * fails it will throw an exception, indicating where failure occured.
+ */
+
+#ifndef TEST_ENVIRONMENT_TSCHUNKEDVECTOR_HPP_
+#define TEST_ENVIRONMENT_TSCHUNKEDVECTOR_HPP_
+
+#include "threading/container/tschunkedvector.hpp"
+#include "threading/atomics.hpp"
+#include "threading/thread.hpp"
+#include "pointers.hpp"
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+// Don't listen to warnings about boost on msvc
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(push, 0)
+#endif
+#include <boost/bind.hpp>
+#include <boost/ref.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/test/unit_test.hpp>
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(pop)
+#endif
+
+namespace core {
+BOOST_AUTO_TEST_SUITE(TSChunkedVectorTests)
+
+using core::threading::Thread;
+using namespace core::threading::container;
+
+/* Tests basic functionality */
+BOOST_AUTO_TEST_CASE(tsChunkedVectorBasicFunctions) {
+    TSChunkedVector<std::string, 4> vect;
+    BOOST_REQUIRE(vect.empty());
+    std::string value;
+    BOOST_REQUIRE(!vect.get(0, value));
+
+    BOOST_REQUIRE_EQUAL(vect.push_back("zero"), 0U);
+    const std::string *first = &vect[0];
+    for (int i = 1; i < 1000; i++) {
+        BOOST_REQUIRE_EQUAL(vect.push_back(boost::lexical_cast<std::string>(i)), (std::size_t)i);
+    }
+    BOOST_REQUIRE_EQUAL(vect.size(), 1000U);
+    BOOST_REQUIRE_MESSAGE(&vect[0] == first, "Element moved when the vector grew");
+    BOOST_REQUIRE_EQUAL(vect[0], "zero");
+    for (int i = 1; i < 1000; i++) {
+        BOOST_REQUIRE_EQUAL(vect[i], boost::lexical_cast<std::string>(i));
+    }
+    BOOST_REQUIRE(vect.get(999, value));
+    BOOST_REQUIRE_EQUAL(value, "999");
+    BOOST_REQUIRE(!vect.get(1000, value));
+}
+
+/* Counts live ChunkedThrowingCopy objects to catch bad destroys */
+int& chunkedLiveCount() {
+    static int live = 0;
+    return live;
+}
+
+/* An element whose copy throws if asked to */
+struct ChunkedThrowingCopy {
+    bool throwOnCopy;
+    explicit ChunkedThrowingCopy(bool shouldThrow = false) : throwOnCopy(shouldThrow) {
+        chunkedLiveCount()++;
+    }
+    ChunkedThrowingCopy(const ChunkedThrowingCopy& other) : throwOnCopy(other.throwOnCopy) {
+        if (throwOnCopy) {
+            throw std::runtime_error("Copy failed");
+        }
+        chunkedLiveCount()++;
+    }
+    ~ChunkedThrowingCopy() {
+        chunkedLiveCount()--;
+    }
+    ChunkedThrowingCopy& operator =(const ChunkedThrowingCopy& other) {
+        throwOnCopy = other.throwOnCopy;
+        return *this;
+    }
+};
+
+/* Tests that a failed push_back stops publishing but destroys cleanly */
+BOOST_AUTO_TEST_CASE(tsChunkedVectorThrowingCopy) {
+    int baseline = chunkedLiveCount();
+    {
+        TSChunkedVector<ChunkedThrowingCopy, 2> vect;
+        ChunkedThrowingCopy good;
+        ChunkedThrowingCopy bad(true);
+        vect.push_back(good);
+        BOOST_REQUIRE_THROW(vect.push_back(bad), std::runtime_error);
+        vect.push_back(good);
+        vect.push_back(good);
+        BOOST_REQUIRE_EQUAL(vect.size(), 1U);
+        BOOST_REQUIRE_EQUAL(chunkedLiveCount(), baseline + 5);
+    }
+    // Only the built elements were destroyed
+    BOOST_REQUIRE_EQUAL(chunkedLiveCount(), baseline);
+}
+
+/* Concurrency Testing */
+typedef TSChunkedVector<std::vector<long> > ChunkedVector;
+
+void chunkedVectorWriter(ChunkedVector& vect, long id) {
+    // Do NOT use BOOST_TEST_MESSAGE here, it's not thread safe
+    for (long i = 0; i < 20000; i++) {
+        // Element contents tell readers if they saw a partial build
+        vect.push_back(std::vector<long>(3, id * 20000 + i));
+    }
+}
+
+void chunkedVectorReader(ChunkedVector& vect, boost::atomic<bool>& torn) {
+    std::size_t seen = 0;
+    while (seen < 80000) {
+        std::size_t size = vect.size();
+        if (size < seen) {
+            torn = true;
+        }
+        for (; seen < size; seen++) {
+            const std::vector<long>& elem = vect[seen];
+            if (elem.size() != 3 || elem[0] != elem[2]) {
+                torn = true;
+            }
+        }
+        boost::this_thread::yield();
+    }
+}
+
+BOOST_AUTO_TEST_CASE(tsChunkedVectorConcurrency) {
+    ChunkedVector vect;
+    boost::atomic<bool> torn(false);
+    boost::posix_time::time_duration wait = boost::posix_time::milliseconds(20000);
+    pointers::lists<Thread>::PtrVector thrds;
+    long numWriters = 4;
+    for (int i = 0; i < 2; i++) {
+        thrds.push_back(new Thread(boost::bind(&chunkedVectorReader,
+                boost::ref(vect), boost::ref(torn))));
+    }
+    for (long i = 0; i < numWriters; i++) {
+        thrds.push_back(new Thread(boost::bind(&chunkedVectorWriter, boost::ref(vect), i)));
+    }
+    for (std::size_t j = 0; j < thrds.size(); j++) {
+        if (!thrds[j].timed_join(wait)) {
+            BOOST_FAIL("Thread timed out");
+        }
+    }
+    BOOST_REQUIRE_MESSAGE(!torn, "Reader saw an unpublished element");
+    BOOST_REQUIRE_EQUAL(vect.size(), (std::size_t)numWriters * 20000);
+    std::vector<bool> found(numWriters * 20000, false);
+    for (std::size_t i = 0; i < vect.size(); i++) {
+        found[vect[i][1]] = true;
+    }
+    for (std::size_t i = 0; i < found.size(); i++) {
+        BOOST_REQUIRE(found[i]);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}
+
+#endif
@@ -0,0 +1,132 @@
+/*
+ * Tests the functionality of the copy-on-write wrapper. If the class
+ * fails it will throw an exception, indicating where failure occured.
+ */
+
+#ifndef TEST_ENVIRONMENT_TSCOPYONWRITEWRAPPER_HPP_
+#define TEST_ENVIRONMENT_TSCOPYONWRITEWRAPPER_HPP_
+
+#include "threading/container/tscopyonwritewrapper.hpp"
+#include "threading/atomics.hpp"
+#include "threading/thread.hpp"
+#include "pointers.hpp"
+#include <vector>
+#include <stdexcept>
+
+// Don't listen to warnings about boost on msvc
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(push, 0)
+#endif
+#include <boost/bind.hpp>
+#include <boost/ref.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/test/unit_test.hpp>
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(pop)
+#endif
+
+namespace core {
+BOOST_AUTO_TEST_SUITE(TSCopyOnWriteWrapperTests)
+
+using core::threading::Thread;
+using namespace core::threading::container;
+
+typedef TSCopyOnWriteWrapper<std::vector<int> > COWVector;
+
+void cowPushOne(std::vector<int>& vect) {
+    vect.push_back(1);
+}
+
+void cowClearAndThrow(std::vector<int>& vect) {
+    vect.clear();
+    throw std::runtime_error("Write failed");
+}
+
+/* Tests basic functionality */
+BOOST_AUTO_TEST_CASE(tsCopyOnWriteWrapperBasicFunctions) {
+    COWVector wrapped(std::vector<int>(1, 0));
+    COWVector::SnapshotPtr original = wrapped.snapshot();
+    BOOST_REQUIRE_EQUAL(wrapped.version(), 0U);
+
+    wrapped.write(&cowPushOne);
+    BOOST_REQUIRE_EQUAL(wrapped.version(), 1U);
+    BOOST_REQUIRE_EQUAL(wrapped.snapshot()->size(), 2U);
+    BOOST_REQUIRE_MESSAGE(original->size() == 1, "Held snapshot was modified");
+
+    // Batched writes publish a single snapshot
+    {
+        COWVector::Writer writer(wrapped);
+        writer->push_back(2);
+        writer->push_back(3);
+        BOOST_REQUIRE_EQUAL(wrapped.snapshot()->size(), 2U);
+        writer.publish();
+    }
+    BOOST_REQUIRE_EQUAL(wrapped.version(), 2U);
+    BOOST_REQUIRE_EQUAL(wrapped.snapshot()->back(), 3);
+
+    // Discarded writes publish nothing
+    {
+        COWVector::Writer writer(wrapped);
+        writer->clear();
+        writer.discard();
+    }
+    {
+        COWVector::Writer writer(wrapped);
+        writer->clear();
+    }
+    BOOST_REQUIRE_EQUAL(wrapped.version(), 2U);
+    BOOST_REQUIRE_EQUAL(wrapped.snapshot()->size(), 4U);
+
+    // A write which throws publishes nothing and releases the writer
+    BOOST_REQUIRE_THROW(wrapped.write(&cowClearAndThrow), std::runtime_error);
+    BOOST_REQUIRE_EQUAL(wrapped.version(), 2U);
+    BOOST_REQUIRE_EQUAL(wrapped.snapshot()->size(), 4U);
+
+    wrapped.store(std::vector<int>());
+    BOOST_REQUIRE(wrapped.snapshot()->empty());
+}
+
+/* Concurrency Testing */
+void cowWriteWorker(COWVector& wrapped) {
+    // Do NOT use BOOST_TEST_MESSAGE here, it's not thread safe
+    for (int i = 0; i < 1000; i++) {
+        wrapped.write(&cowPushOne);
+    }
+}
+
+void cowReadWorker(COWVector& wrapped, boost::atomic<bool>& shrunk) {
+    std::size_t last = 0;
+    for (int i = 0; i < 10000; i++) {
+        COWVector::SnapshotPtr snapshot = wrapped.snapshot();
+        if (snapshot->size() < last) {
+            shrunk = true;
+        }
+        last = snapshot->size();
+    }
+}
+
+BOOST_AUTO_TEST_CASE(tsCopyOnWriteWrapperConcurrency) {
+    COWVector wrapped;
+    boost::atomic<bool> shrunk(false);
+    boost::posix_time::time_duration wait = boost::posix_time::milliseconds(10000);
+    pointers::lists<Thread>::PtrVector thrds;
+    int numWriters = 4;
+    for (int i = 0; i < numWriters; i++) {
+        thrds.push_back(new Thread(boost::bind(&cowWriteWorker, boost::ref(wrapped))));
+        thrds.push_back(new Thread(boost::bind(&cowReadWorker,
+                boost::ref(wrapped), boost::ref(shrunk))));
+    }
+    for (std::size_t j = 0; j < thrds.size(); j++) {
+        if (!thrds[j].timed_join(wait)) {
+            BOOST_FAIL("Thread timed out");
+        }
+    }
+    BOOST_REQUIRE_MESSAGE(!shrunk, "Reader saw an older snapshot after a newer one");
+    BOOST_REQUIRE_EQUAL(wrapped.snapshot()->size(), (std::size_t)numWriters * 1000);
+    BOOST_REQUIRE_EQUAL(wrapped.version(), (COWVector::VersionType)numWriters * 1000);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}
+
+#endif
@@ -0,0 +1,216 @@
+/*
+ * Tests the functionality of the thread safe hash map. If the class
+ * fails it will throw an exception, indicating where failure occured.
+ */
+
+#ifndef TEST_ENVIRONMENT_TSHASHMAP_HPP_
+#define TEST_ENVIRONMENT_TSHASHMAP_HPP_
+
+#include "threading/container/tshashmap.hpp"
+#include "threading/thread.hpp"
+#include "pointers.hpp"
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+// Don't listen to warnings about boost on msvc
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(push, 0)
+#endif
+#include <boost/bind.hpp>
+#include <boost/ref.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/test/unit_test.hpp>
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(pop)
+#endif
+
+namespace core {
+BOOST_AUTO_TEST_SUITE(TSHashMapTests)
+
+using core::threading::Thread;
+using namespace core::threading::container;
+
+typedef TSHashMap<std::string, int> StringIntMap;
+typedef TSHashMap<long, long> LongMap;
+
+/* Builds values and counts how often it was asked to */
+struct CountingBuilder {
+    boost::atomic<int> *calls;
+    long value;
+    CountingBuilder(boost::atomic<int>& callCount, long buildValue) :
+        calls(&callCount), value(buildValue) {}
+    long operator()() const {
+        calls->fetch_add(1, boost::memory_order_relaxed);
+        return value;
+    }
+};
+
+void hashMapIncrement(long& value) {
+    value++;
+}
+
+/* Tests basic functionality */
+BOOST_AUTO_TEST_CASE(tsHashMapBasicFunctions) {
+    StringIntMap map(4);
+    BOOST_REQUIRE_EQUAL(map.stripeCount(), 4U);
+    BOOST_REQUIRE(map.empty());
+    BOOST_REQUIRE(map.insert("one", 1));
+    BOOST_REQUIRE_MESSAGE(!map.insert("one", 10), "Inserted a key twice");
+    BOOST_REQUIRE(map.insert("two", 2));
+    int value = 0;
+    BOOST_REQUIRE(map.find("one", value));
+    BOOST_REQUIRE_EQUAL(value, 1);
+    BOOST_REQUIRE(!map.find("three", value));
+    BOOST_REQUIRE(map.contains("two"));
+
+    BOOST_REQUIRE(!map.insertOrAssign("two", 22));
+    BOOST_REQUIRE(map.find("two", value));
+    BOOST_REQUIRE_EQUAL(value, 22);
+    BOOST_REQUIRE(map.insertOrAssign("three", 3));
+    BOOST_REQUIRE_EQUAL(map.size(), 3U);
+
+    BOOST_REQUIRE(map.erase("one"));
+    BOOST_REQUIRE(!map.erase("one"));
+    BOOST_REQUIRE(!map.contains("one"));
+    BOOST_REQUIRE_EQUAL(map.size(), 2U);
+    map.clear();
+    BOOST_REQUIRE(map.empty());
+
+    LongMap longs(1);
+    boost::atomic<int> calls(0);
+    BOOST_REQUIRE_EQUAL(longs.getOrInsert(5, CountingBuilder(calls, 50)), 50);
+    BOOST_REQUIRE_EQUAL(longs.getOrInsert(5, CountingBuilder(calls, 60)), 50);
+    BOOST_REQUIRE_EQUAL(calls.load(), 1);
+    BOOST_REQUIRE(longs.update(5, &hashMapIncrement));
+    BOOST_REQUIRE(!longs.update(6, &hashMapIncrement));
+    long longValue = 0;
+    BOOST_REQUIRE(longs.find(5, longValue));
+    BOOST_REQUIRE_EQUAL(longValue, 51);
+}
+
+/* Tests that entries survive incremental resizes and erased slots */
+BOOST_AUTO_TEST_CASE(tsHashMapResize) {
+    // One stripe, so every key goes through the same resizes
+    LongMap map(1);
+    std::vector<bool> erased(5000, false);
+    for (long i = 0; i < 5000; i++) {
+        BOOST_REQUIRE(map.insert(i, i * 2));
+        long value = 0;
+        BOOST_REQUIRE(map.find(i, value));
+        BOOST_REQUIRE_EQUAL(value, i * 2);
+        if (i % 3 == 0) {
+            BOOST_REQUIRE(map.erase(i / 2));
+            erased[i / 2] = true;
+        }
+    }
+    std::size_t expected = 0;
+    for (long i = 0; i < 5000; i++) {
+        BOOST_REQUIRE_EQUAL(map.contains(i), !erased[i]);
+        expected += erased[i] ? 0 : 1;
+    }
+    BOOST_REQUIRE_EQUAL(map.size(), expected);
+}
+
+/* Copies left before a HashThrowingValue copy throws, or -1 for never */
+int& hashCopiesLeft() {
+    static int left = -1;
+    return left;
+}
+
+/* A value whose copy throws once hashCopiesLeft runs out */
+struct HashThrowingValue {
+    long value;
+    explicit HashThrowingValue(long init = 0) : value(init) {}
+    HashThrowingValue(const HashThrowingValue& other) : value(other.value) {
+        if (hashCopiesLeft() == 0) {
+            throw std::runtime_error("Copy failed");
+        }
+        if (hashCopiesLeft() > 0) {
+            hashCopiesLeft()--;
+        }
+    }
+    HashThrowingValue& operator =(const HashThrowingValue& other) {
+        value = other.value;
+        return *this;
+    }
+};
+
+/* Tests that failed copies, including ones during a resize, lose nothing */
+BOOST_AUTO_TEST_CASE(tsHashMapThrowingCopy) {
+    TSHashMap<long, HashThrowingValue> map(1);
+    std::vector<long> inserted;
+    for (long i = 0; i < 300; i++) {
+        // Fail the first, second or third copy of each insert in turn
+        hashCopiesLeft() = (int)(i % 4) - 1;
+        try {
+            if (map.insert(i, HashThrowingValue(i))) {
+                inserted.push_back(i);
+            }
+        } catch (const std::runtime_error&) {
+            // Nothing was added
+        }
+    }
+    hashCopiesLeft() = -1;
+    BOOST_REQUIRE(inserted.size() < 300U);
+    BOOST_REQUIRE_EQUAL(map.size(), inserted.size());
+    for (std::size_t i = 0; i < inserted.size(); i++) {
+        HashThrowingValue found;
+        BOOST_REQUIRE_MESSAGE(map.find(inserted[i], found), "Lost key " << inserted[i]);
+        BOOST_REQUIRE_EQUAL(found.value, inserted[i]);
+    }
+    for (long i = 0; i < 300; i++) {
+        if (!map.contains(i)) {
+            BOOST_REQUIRE(map.insert(i, HashThrowingValue(i)));
+        }
+    }
+    BOOST_REQUIRE_EQUAL(map.size(), 300U);
+}
+
+/* Concurrency Testing */
+void hashMapWorker(LongMap& map, long first, boost::atomic<int>& calls) {
+    // Do NOT use BOOST_TEST_MESSAGE here, it's not thread safe
+    for (long i = first; i < first + 5000; i++) {
+        map.insert(i, i);
+        // Every thread asks for the same shared keys
+        map.getOrInsert(-(i % 500) - 1, CountingBuilder(calls, 7));
+        map.update(-(i % 500) - 1, &hashMapIncrement);
+        if (i % 2 == 0) {
+            map.erase(i);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(tsHashMapConcurrency) {
+    LongMap map;
+    boost::atomic<int> calls(0);
+    boost::posix_time::time_duration wait = boost::posix_time::milliseconds(20000);
+    pointers::lists<Thread>::PtrVector thrds;
+    long numThreads = 4;
+    for (long i = 0; i < numThreads; i++) {
+        thrds.push_back(new Thread(boost::bind(&hashMapWorker, boost::ref(map),
+                i * 5000, boost::ref(calls))));
+    }
+    for (std::size_t j = 0; j < thrds.size(); j++) {
+        if (!thrds[j].timed_join(wait)) {
+            BOOST_FAIL("Thread timed out");
+        }
+    }
+    BOOST_REQUIRE_EQUAL(calls.load(), 500);
+    BOOST_REQUIRE_EQUAL(map.size(), (std::size_t)(numThreads * 2500 + 500));
+    long total = 0;
+    for (long key = -500; key < 0; key++) {
+        long value = 0;
+        BOOST_REQUIRE(map.find(key, value));
+        total += value - 7;
+    }
+    BOOST_REQUIRE_EQUAL(total, numThreads * 5000);
+    for (long key = 1; key < numThreads * 5000; key += 2) {
+        BOOST_REQUIRE(map.contains(key));
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}
+
+#endif
@@ -0,0 +1,155 @@
+/*
+ * Tests the performance of TSPriorityQueue class. If the class fails it will
+ * throw an exception, indicating where failure occured.
+ */
+
+#ifndef TEST_ENVIRONMENT_TSPRIORITYQUEUE_HPP_
+#define TEST_ENVIRONMENT_TSPRIORITYQUEUE_HPP_
+
+#include "threading/container/tspriorityqueue.hpp"
+#include "threading/thread.hpp"
+#include "pointers.hpp"
+#include <vector>
+#include <iterator>
+#include <functional>
+
+// Don't listen to warnings about boost on msvc
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(push, 0)
+#endif
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/test/unit_test.hpp>
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(pop)
+#endif
+
+namespace core {
+BOOST_AUTO_TEST_SUITE(TSPriorityQueueTests)
+
+typedef core::threading::container::TSPriorityQueue<int> IntPriorityQueue;
+using core::threading::Thread;
+
+/* Tests basic functionality */
+BOOST_AUTO_TEST_CASE(tsPriorityQueueBasicFunctions) {
+    IntPriorityQueue intQ;
+    BOOST_REQUIRE(intQ.empty());
+    // Scramble the insertion order
+    for (int i = 0; i < 100; i++) {
+        intQ.enqueue((i * 37) % 100);
+    }
+    BOOST_REQUIRE_EQUAL(intQ.size(), 100U);
+
+    int j = -1;
+    for (int i = 99; i >= 0; i--) {
+        BOOST_REQUIRE_MESSAGE(intQ.dequeue(j), "No element dequeued");
+        BOOST_REQUIRE_MESSAGE(i == j,
+                "Failed to return " << i << ", instead returned " << j);
+    }
+    BOOST_REQUIRE(intQ.empty());
+    BOOST_REQUIRE_MESSAGE(!intQ.dequeue(j), "Dequeued from an empty queue");
+}
+
+/* Tests batch functionality */
+BOOST_AUTO_TEST_CASE(tsPriorityQueueBatchFunctions) {
+    threading::container::TSPriorityQueue<int, std::greater<int> > minQ;
+    std::vector<int> input;
+    for (int i = 0; i < 50; i++) {
+        input.push_back((i * 13) % 50);
+    }
+    minQ.enqueueN(input.begin(), input.end());
+
+    std::vector<int> output;
+    BOOST_REQUIRE_EQUAL(minQ.dequeueN(std::back_inserter(output), 10), 10U);
+    BOOST_REQUIRE_EQUAL(minQ.dequeueAll(std::back_inserter(output)), 40U);
+    BOOST_REQUIRE_EQUAL(output.size(), 50U);
+    for (int i = 0; i < 50; i++) {
+        BOOST_REQUIRE_EQUAL(output[i], i);
+    }
+    BOOST_REQUIRE(minQ.empty());
+}
+
+/* An element with no default constructor */
+struct PriorityOnlyValue {
+    int value;
+    explicit PriorityOnlyValue(int init) : value(init) {}
+    bool operator <(const PriorityOnlyValue& other) const {
+        return value < other.value;
+    }
+};
+
+/* Tests batch dequeues of elements which can't be default constructed */
+BOOST_AUTO_TEST_CASE(tsPriorityQueueNoDefaultConstructor) {
+    threading::container::TSPriorityQueue<PriorityOnlyValue> valueQ;
+    for (int i = 0; i < 20; i++) {
+        valueQ.enqueue(PriorityOnlyValue((i * 7) % 20));
+    }
+    std::vector<PriorityOnlyValue> output;
+    BOOST_REQUIRE_EQUAL(valueQ.dequeueN(std::back_inserter(output), 5), 5U);
+    BOOST_REQUIRE_EQUAL(valueQ.dequeueAll(std::back_inserter(output)), 15U);
+    for (int i = 0; i < 20; i++) {
+        BOOST_REQUIRE_EQUAL(output[i].value, 19 - i);
+    }
+}
+
+/* Blocking dequeue Testing */
+void tsPriorityQueueDelayedEnqueueWorker(pointers::smart<IntPriorityQueue>::SharedPtr testQInt) {
+    boost::this_thread::sleep(boost::posix_time::milliseconds(20));
+    testQInt->enqueue(7);
+}
+
+BOOST_AUTO_TEST_CASE(tsPriorityQueueDequeueWait) {
+    pointers::smart<IntPriorityQueue>::SharedPtr intQ(new IntPriorityQueue());
+    int deq = -1;
+    BOOST_REQUIRE_MESSAGE(!intQ->dequeueWaitFor(deq, boost::posix_time::milliseconds(10)),
+            "Dequeued from an empty queue");
+
+    Thread producer(boost::bind(&tsPriorityQueueDelayedEnqueueWorker, intQ));
+    intQ->dequeueWait(deq);
+    BOOST_REQUIRE_EQUAL(deq, 7);
+    producer.join();
+
+    intQ->enqueue(1);
+    intQ->enqueue(3);
+    std::vector<int> output;
+    BOOST_REQUIRE_EQUAL(intQ->dequeueNWait(std::back_inserter(output), 1), 1U);
+    BOOST_REQUIRE_EQUAL(output[0], 3);
+}
+
+/* Concurrency Testing */
+void tsPriorityQueueEnqueueWorker(pointers::smart<IntPriorityQueue>::SharedPtr testQInt) {
+    // Do NOT use BOOST_TEST_MESSAGE here, it's not thread safe
+    for (int i = 0; i < 1000; i++) {
+        testQInt->enqueue(i);
+    }
+}
+
+void tsPriorityQueueDequeueWorker(pointers::smart<IntPriorityQueue>::SharedPtr testQInt) {
+    int deq;
+    for (int i = 0; i < 1000; i++) {
+        testQInt->dequeueWait(deq);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(tsPriorityQueueConcurrency) {
+    pointers::smart<IntPriorityQueue>::SharedPtr intQ(new IntPriorityQueue());
+    boost::posix_time::time_duration wait = boost::posix_time::milliseconds(5000);
+    pointers::lists<Thread>::PtrVector thrds;
+    int numWorkers = 8;
+    for (int i = 0; i < numWorkers; i++) {
+        thrds.push_back(new Thread(boost::bind(&tsPriorityQueueEnqueueWorker, intQ)));
+        thrds.push_back(new Thread(boost::bind(&tsPriorityQueueDequeueWorker, intQ)));
+    }
+    for (std::size_t j = 0; j < thrds.size(); j++) {
+        if (!thrds[j].timed_join(wait)) {
+            BOOST_FAIL("Thread timed out");
+        }
+    }
+    BOOST_REQUIRE_MESSAGE(intQ->empty(),
+            "Dequeue did not reduce Queue size during concurrency test");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}
+
+#endif
@@ -16,6 +16,7 @@
 #   pragma warning(push, 0)
 #endif
 #include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/thread/thread_time.hpp>
 #include <boost/test/unit_test.hpp>
 #if defined(_MSC_VER) && (_MSC_VER >= 1500)
 #   pragma warning(pop)
@@ -208,6 +209,243 @@ BOOST_AUTO_TEST_CASE(tsQueueConcurrency) {
     BOOST_REQUIRE_MESSAGE(intQ->empty(), "Clear did not reduce Queue size");
 }
 
+/* Blocking dequeue Testing */
+void tsQueueDelayedEnqueueWorker(pointers::smart<IntQueue>::SharedPtr testQInt, int numEnqueue) {
+    boost::this_thread::sleep(boost::posix_time::milliseconds(20));
+    for (int i = 0; i < numEnqueue; i++) {
+        testQInt->enqueue(i);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(tsQueueDequeueWait) {
+    pointers::smart<IntQueue>::SharedPtr intQ(new IntQueue());
+    Thread producer(boost::bind(&tsQueueDelayedEnqueueWorker, intQ, 100));
+    for (int i = 0; i < 100; i++) {
+        IntQueue::PtrType deq(intQ->dequeueWait());
+        BOOST_REQUIRE_MESSAGE(deq, "No element dequeued");
+        BOOST_REQUIRE_EQUAL(*deq, i);
+    }
+    producer.join();
+    BOOST_REQUIRE(intQ->empty());
+}
+
+BOOST_AUTO_TEST_CASE(tsQueueDequeueWaitFor) {
+    IntQueue intQ;
+    const boost::system_time start = boost::get_system_time();
+    BOOST_REQUIRE_MESSAGE(!intQ.dequeueWaitFor(boost::posix_time::milliseconds(50)),
+            "Failed to return empty pointer after timeout");
+    BOOST_REQUIRE(boost::get_system_time() - start >= boost::posix_time::milliseconds(40));
+    BOOST_REQUIRE(intQ.dequeueAllWaitFor(boost::posix_time::milliseconds(10))->empty());
+
+    intQ.enqueue(5);
+    IntQueue::PtrType deq(intQ.dequeueWaitFor(boost::posix_time::milliseconds(50)));
+    BOOST_REQUIRE_MESSAGE(deq, "No element dequeued");
+    BOOST_REQUIRE_EQUAL(*deq, 5);
+}
+
+BOOST_AUTO_TEST_CASE(tsQueueDequeueAllWait) {
+    pointers::smart<IntQueue>::SharedPtr intQ(new IntQueue());
+    Thread producer(boost::bind(&tsQueueDelayedEnqueueWorker, intQ, 10));
+    std::size_t received = 0;
+    while (received < 10) {
+        IntQueue::QListPtr deq = intQ->dequeueAllWait();
+        BOOST_REQUIRE_MESSAGE(!deq->empty(), "Woke with no elements");
+        received += deq->size();
+    }
+    producer.join();
+    BOOST_REQUIRE_EQUAL(received, 10U);
+}
+
+/* Batch enqueue Testing */
+BOOST_AUTO_TEST_CASE(tsQueueBatchEnqueue) {
+    IntQueue intQ;
+    std::vector<int> input;
+    for (int i = 0; i < 10; i++) {
+        input.push_back(i);
+    }
+    intQ.enqueueN(input.begin(), input.end());
+    BOOST_REQUIRE_EQUAL(intQ.size(), 10U);
+
+    IntQueue::QListPtr batch(new IntQueue::QList());
+    batch->push_back(new int(10));
+    batch->push_back(new int(11));
+    intQ.enqueueAll(batch);
+    BOOST_REQUIRE(batch->empty());
+
+    IntQueue::QList owned;
+    owned.push_back(new int(12));
+    intQ.splice(owned);
+    BOOST_REQUIRE(owned.empty());
+    BOOST_REQUIRE_EQUAL(intQ.size(), 13U);
+
+    IntQueue::QListPtr deq = intQ.dequeueAll();
+    int i = 0;
+    for (IntQueue::QList::iterator iter = deq->begin(); iter != deq->end(); ++iter, ++i) {
+        BOOST_REQUIRE_EQUAL(*iter, i);
+    }
+    BOOST_REQUIRE_EQUAL(i, 13);
+}
+
+/* Pooled allocation Testing */
+typedef core::threading::container::pooled<int>::Queue PooledIntQueue;
+
+BOOST_AUTO_TEST_CASE(tsQueuePooledFunctions) {
+    PooledIntQueue intQ;
+    for (int i = 0; i < 100; i++) {
+        intQ.enqueue(i);
+    }
+    for (int i = 0; i < 50; i++) {
+        PooledIntQueue::PtrType deq(intQ.dequeue());
+        BOOST_REQUIRE_MESSAGE(deq, "No element dequeued");
+        BOOST_REQUIRE_EQUAL(*deq, i);
+    }
+    PooledIntQueue::QListPtr part = intQ.dequeueN(20);
+    BOOST_REQUIRE_EQUAL(part->size(), 20U);
+    BOOST_REQUIRE_EQUAL(part->front(), 50);
+    PooledIntQueue::QListPtr rest = intQ.dequeueAll();
+    BOOST_REQUIRE_EQUAL(rest->size(), 30U);
+    BOOST_REQUIRE_EQUAL(rest->front(), 70);
+    BOOST_REQUIRE(intQ.empty());
+}
+
+BOOST_AUTO_TEST_CASE(tsQueueRecyclesLists) {
+    IntQueue intQ;
+    intQ.enqueue(1);
+    const IntQueue::QList *firstList = intQ.dequeueAll().get();
+    // The released list is cleared, becomes the queue's storage and
+    // is then handed out again
+    bool reused = false;
+    for (int i = 2; i < 6 && !reused; i++) {
+        intQ.enqueue(i);
+        IntQueue::QListPtr deq = intQ.dequeueAll();
+        BOOST_REQUIRE_EQUAL(deq->size(), 1U);
+        BOOST_REQUIRE_EQUAL(deq->front(), i);
+        reused = deq.get() == firstList;
+    }
+    BOOST_REQUIRE_MESSAGE(reused, "Released list was not reused");
+}
+
+/* Bounded queue Testing */
+using core::threading::container::OverflowCounters;
+
+BOOST_AUTO_TEST_CASE(tsQueueBoundedReject) {
+    IntQueue intQ(4, threading::container::OVERFLOW_REJECT);
+    BOOST_REQUIRE_EQUAL(intQ.getMaxSize(), 4U);
+    for (int i = 0; i < 4; i++) {
+        BOOST_REQUIRE(intQ.enqueue(i));
+    }
+    BOOST_REQUIRE_MESSAGE(!intQ.enqueue(4), "Enqueued into a full queue");
+    BOOST_REQUIRE_MESSAGE(!intQ.enqueue(new int(5)), "Enqueued into a full queue");
+    BOOST_REQUIRE_EQUAL(intQ.size(), 4U);
+
+    IntQueue::QList batch;
+    batch.push_back(new int(6));
+    BOOST_REQUIRE(!intQ.splice(batch));
+    BOOST_REQUIRE_MESSAGE(batch.size() == 1U, "Refused element left the caller's list");
+    BOOST_REQUIRE_EQUAL(intQ.getOverflowCounters().rejected, 3U);
+
+    IntQueue::PtrType deq(intQ.dequeue());
+    BOOST_REQUIRE(intQ.splice(batch));
+    BOOST_REQUIRE(batch.empty());
+    BOOST_REQUIRE_EQUAL(intQ.dequeueAll()->back(), 6);
+}
+
+BOOST_AUTO_TEST_CASE(tsQueueBoundedDrop) {
+    IntQueue newestQ(3, threading::container::OVERFLOW_DROP_NEWEST);
+    IntQueue oldestQ(3, threading::container::OVERFLOW_DROP_OLDEST);
+    std::vector<int> input;
+    for (int i = 0; i < 5; i++) {
+        input.push_back(i);
+    }
+    BOOST_REQUIRE(newestQ.enqueueN(input.begin(), input.end()));
+    BOOST_REQUIRE(oldestQ.enqueueN(input.begin(), input.end()));
+    BOOST_REQUIRE_EQUAL(newestQ.size(), 3U);
+    BOOST_REQUIRE_EQUAL(oldestQ.size(), 3U);
+    BOOST_REQUIRE_EQUAL(newestQ.getOverflowCounters().droppedNewest, 2U);
+    BOOST_REQUIRE_EQUAL(oldestQ.getOverflowCounters().droppedOldest, 2U);
+    BOOST_REQUIRE_EQUAL(*newestQ.dequeue(), 0);
+    BOOST_REQUIRE_EQUAL(*oldestQ.dequeue(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(tsQueueBoundedBlockTimeout) {
+    IntQueue intQ(1, boost::posix_time::milliseconds(30));
+    BOOST_REQUIRE_EQUAL(intQ.getOverflowPolicy(), threading::container::OVERFLOW_BLOCK_TIMEOUT);
+    BOOST_REQUIRE(intQ.enqueue(1));
+    const boost::system_time start = boost::get_system_time();
+    BOOST_REQUIRE_MESSAGE(!intQ.enqueue(2), "Enqueued into a full queue");
+    BOOST_REQUIRE(boost::get_system_time() - start >= boost::posix_time::milliseconds(20));
+    OverflowCounters counters = intQ.getOverflowCounters();
+    BOOST_REQUIRE_EQUAL(counters.blocked, 1U);
+    BOOST_REQUIRE_EQUAL(counters.timedOut, 1U);
+
+    // The timeout policy can't be chosen without a timeout
+    BOOST_REQUIRE_THROW(IntQueue(1, threading::container::OVERFLOW_BLOCK_TIMEOUT),
+                        ParameterException);
+}
+
+void tsQueueBoundedEnqueueWorker(pointers::smart<IntQueue>::SharedPtr testQInt, int numEnqueue) {
+    for (int i = 0; i < numEnqueue; i++) {
+        testQInt->enqueue(i);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(tsQueueBoundedBlock) {
+    pointers::smart<IntQueue>::SharedPtr intQ(
+            new IntQueue(8, threading::container::OVERFLOW_BLOCK));
+    Thread producer(boost::bind(&tsQueueBoundedEnqueueWorker, intQ, 1000));
+    for (int i = 0; i < 1000; i++) {
+        BOOST_REQUIRE(intQ->size() <= 8U);
+        IntQueue::PtrType deq(intQ->dequeueWaitFor(boost::posix_time::milliseconds(5000)));
+        BOOST_REQUIRE_MESSAGE(deq, "No element dequeued");
+        BOOST_REQUIRE_EQUAL(*deq, i);
+    }
+    if (!producer.timed_join(boost::posix_time::milliseconds(5000))) {
+        BOOST_FAIL("Producer timed out");
+    }
+    BOOST_REQUIRE(intQ->empty());
+}
+
+/* Statistics Testing */
+typedef core::threading::container::instrumented<int>::Queue InstrumentedIntQueue;
+
+BOOST_AUTO_TEST_CASE(tsQueueInstrumented) {
+    InstrumentedIntQueue intQ;
+    for (int i = 0; i < 10; i++) {
+        intQ.enqueue(i);
+    }
+    boost::this_thread::sleep(boost::posix_time::milliseconds(5));
+    InstrumentedIntQueue::PtrType deq(intQ.dequeue());
+    BOOST_REQUIRE_EQUAL(*deq, 0);
+    BOOST_REQUIRE_EQUAL(intQ.dequeueN(4)->size(), 4U);
+    intQ.clear();
+
+    const core::threading::container::QueueStats& stats = intQ.getStats();
+    BOOST_REQUIRE_EQUAL(stats.enqueueCount(), 10U);
+    BOOST_REQUIRE_EQUAL(stats.dequeueCount(), 5U);
+    BOOST_REQUIRE_EQUAL(stats.discardCount(), 5U);
+    BOOST_REQUIRE_EQUAL(stats.highWaterDepth(), 10U);
+    BOOST_REQUIRE_EQUAL(stats.residencyTimes().totalCount(), 5U);
+    // Every dequeued element waited out the sleep
+    BOOST_REQUIRE(stats.residencyTimes().percentileUpperBound(0) > 4000U);
+    BOOST_REQUIRE_EQUAL(stats.lockWaitTimes().totalCount(), stats.contendedLocks());
+}
+
+/* Elements added through a locked reference bypass the stats hooks */
+BOOST_AUTO_TEST_CASE(tsQueueInstrumentedLockedReference) {
+    InstrumentedIntQueue intQ;
+    intQ.enqueue(0);
+    intQ.generateScopedLockedReference()->push_back(new int(1));
+    intQ.generateScopedLockedReference()->push_back(new int(2));
+    BOOST_REQUIRE_EQUAL(intQ.dequeueN(2)->size(), 2U);
+    intQ.clear();
+
+    const core::threading::container::QueueStats& stats = intQ.getStats();
+    BOOST_REQUIRE_EQUAL(stats.dequeueCount(), 2U);
+    BOOST_REQUIRE_EQUAL(stats.discardCount(), 1U);
+    // Only the element added through enqueue was timed
+    BOOST_REQUIRE_EQUAL(stats.residencyTimes().totalCount(), 1U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }
 
@@ -0,0 +1,188 @@
+/*
+ * Tests the performance of TSRingBuffer class. If the class fails it will
+ * throw an exception, indicating where failure occured.
+ */
+
+#ifndef TEST_ENVIRONMENT_TSRINGBUFFER_HPP_
+#define TEST_ENVIRONMENT_TSRINGBUFFER_HPP_
+
+#include "threading/container/tsringbuffer.hpp"
+#include "threading/thread.hpp"
+#include "pointers.hpp"
+#include <vector>
+#include <stdexcept>
+
+// Don't listen to warnings about boost on msvc
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(push, 0)
+#endif
+#include <boost/bind.hpp>
+#include <boost/ref.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/thread/thread_time.hpp>
+#include <boost/test/unit_test.hpp>
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(pop)
+#endif
+
+namespace core {
+BOOST_AUTO_TEST_SUITE(TSRingBufferTests)
+
+typedef core::threading::container::TSRingBuffer<int, 64> IntRingBuffer;
+using core::threading::container::RingSequence;
+using core::threading::Thread;
+
+/* Collects every event it is handed */
+struct CollectingHandler {
+    std::vector<int> *events;
+    std::size_t *batches;
+
+    CollectingHandler(std::vector<int>& evts, std::size_t& btchs) : events(&evts), batches(&btchs) {}
+
+    void operator()(const int& event, RingSequence::SequenceType, bool endOfBatch) {
+        events->push_back(event);
+        if (endOfBatch) {
+            (*batches)++;
+        }
+    }
+};
+
+/* Tests basic functionality */
+BOOST_AUTO_TEST_CASE(tsRingBufferBasicFunctions) {
+    IntRingBuffer ring;
+    RingSequence first;
+    RingSequence second;
+    ring.addGatingSequence(first);
+    ring.addGatingSequence(second);
+    IntRingBuffer::Barrier barrier = ring.newBarrier();
+
+    for (int i = 0; i < 10; i++) {
+        ring.publishEvent(i);
+    }
+    // Claim and publish a batch in place
+    IntRingBuffer::SequenceType highest = ring.claim(5);
+    for (IntRingBuffer::SequenceType seq = highest - 4; seq <= highest; seq++) {
+        ring.get(seq) = (int)seq;
+    }
+    ring.publish(highest - 4, highest);
+    BOOST_REQUIRE_EQUAL(ring.getCursor(), 14);
+
+    // Each consumer sees every event, in one batch
+    std::vector<int> firstEvents, secondEvents;
+    std::size_t firstBatches = 0, secondBatches = 0;
+    BOOST_REQUIRE_EQUAL(ring.consume(barrier, first, CollectingHandler(firstEvents, firstBatches)), 15U);
+    BOOST_REQUIRE_EQUAL(ring.consume(barrier, second, CollectingHandler(secondEvents, secondBatches)), 15U);
+    BOOST_REQUIRE_EQUAL(firstBatches, 1U);
+    BOOST_REQUIRE(firstEvents == secondEvents);
+    for (int i = 0; i < 15; i++) {
+        BOOST_REQUIRE_EQUAL(firstEvents[i], i);
+    }
+    BOOST_REQUIRE_EQUAL(ring.consume(barrier, first, CollectingHandler(firstEvents, firstBatches)), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(tsRingBufferGating) {
+    threading::container::TSRingBuffer<int, 4> ring;
+    RingSequence consumer;
+    ring.addGatingSequence(consumer);
+    IntRingBuffer::SequenceType highest;
+    BOOST_REQUIRE(ring.tryClaim(4, highest));
+    ring.publish(0, highest);
+    BOOST_REQUIRE_MESSAGE(!ring.tryClaim(1, highest), "Claimed over an unread event");
+
+    std::vector<int> events;
+    std::size_t batches = 0;
+    threading::container::TSRingBuffer<int, 4>::Barrier barrier = ring.newBarrier();
+    BOOST_REQUIRE_EQUAL(ring.consume(barrier, consumer, CollectingHandler(events, batches)), 4U);
+    BOOST_REQUIRE(ring.tryClaim(1, highest));
+    BOOST_REQUIRE_EQUAL(highest, 4);
+
+    // An unpublished claim holds back consumers until it is published
+    const boost::system_time deadline = boost::get_system_time() + boost::posix_time::milliseconds(10);
+    BOOST_REQUIRE_EQUAL(ring.consumeWait(barrier, consumer, CollectingHandler(events, batches), deadline), 0U);
+    ring.publish(highest);
+    BOOST_REQUIRE_EQUAL(ring.consume(barrier, consumer, CollectingHandler(events, batches)), 1U);
+}
+
+/* Concurrency Testing */
+void tsRingBufferProducerWorker(IntRingBuffer& ring, int workerNum) {
+    // Do NOT use BOOST_TEST_MESSAGE here, it's not thread safe
+    for (int i = 0; i < 1000; i += 4) {
+        IntRingBuffer::SequenceType highest = ring.claim(4);
+        for (int j = 0; j < 4; j++) {
+            ring.get(highest - 3 + j) = workerNum * 1000 + i + j;
+        }
+        ring.publish(highest - 3, highest);
+    }
+}
+
+/* Sums events and checks they were handled by the stages it depends on */
+struct SummingHandler {
+    long long *sum;
+    const std::vector<const RingSequence *> *upstream;
+
+    SummingHandler(long long& total, const std::vector<const RingSequence *>& deps) :
+        sum(&total), upstream(&deps) {}
+
+    void operator()(const int& event, RingSequence::SequenceType seq, bool) {
+        for (std::size_t i = 0; i < upstream->size(); i++) {
+            if ((*upstream)[i]->get() < seq) {
+                throw std::runtime_error("Stage ran ahead of its dependencies");
+            }
+        }
+        *sum += event;
+    }
+};
+
+void tsRingBufferConsumerWorker(IntRingBuffer& ring, IntRingBuffer::Barrier barrier,
+                                RingSequence& cursor,
+                                const std::vector<const RingSequence *>& upstream,
+                                long long& sum, int expected) {
+    const boost::system_time deadline = boost::get_system_time() + boost::posix_time::milliseconds(5000);
+    int received = 0;
+    while (received < expected && boost::get_system_time() < deadline) {
+        received += (int)ring.consumeWait(barrier, cursor, SummingHandler(sum, upstream), deadline);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(tsRingBufferConcurrency) {
+    IntRingBuffer ring;
+    const int numProducers = 4;
+    const int numEvents = numProducers * 1000;
+
+    // Two independent stages, then a final stage behind both
+    RingSequence stageA, stageB, stageC;
+    std::vector<const RingSequence *> noDeps;
+    std::vector<const RingSequence *> stageDeps;
+    stageDeps.push_back(&stageA);
+    stageDeps.push_back(&stageB);
+    ring.addGatingSequence(stageC);
+
+    long long sumA = 0, sumB = 0, sumC = 0;
+    boost::posix_time::time_duration wait = boost::posix_time::milliseconds(5000);
+    pointers::lists<Thread>::PtrVector thrds;
+    thrds.push_back(new Thread(boost::bind(&tsRingBufferConsumerWorker, boost::ref(ring), ring.newBarrier(),
+            boost::ref(stageA), boost::cref(noDeps), boost::ref(sumA), numEvents)));
+    thrds.push_back(new Thread(boost::bind(&tsRingBufferConsumerWorker, boost::ref(ring), ring.newBarrier(),
+            boost::ref(stageB), boost::cref(noDeps), boost::ref(sumB), numEvents)));
+    thrds.push_back(new Thread(boost::bind(&tsRingBufferConsumerWorker, boost::ref(ring), ring.newBarrier(stageDeps),
+            boost::ref(stageC), boost::cref(stageDeps), boost::ref(sumC), numEvents)));
+    for (int i = 0; i < numProducers; i++) {
+        thrds.push_back(new Thread(boost::bind(&tsRingBufferProducerWorker, boost::ref(ring), i)));
+    }
+    for (std::size_t j = 0; j < thrds.size(); j++) {
+        if (!thrds[j].timed_join(wait)) {
+            BOOST_FAIL("Thread timed out");
+        }
+    }
+
+    long long expected = (long long)numEvents * (numEvents - 1) / 2;
+    BOOST_REQUIRE_EQUAL(sumA, expected);
+    BOOST_REQUIRE_EQUAL(sumB, expected);
+    BOOST_REQUIRE_EQUAL(sumC, expected);
+    BOOST_REQUIRE_EQUAL(stageC.get(), numEvents - 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}
+
+#endif
@@ -0,0 +1,161 @@
+/*
+ * Tests the performance of TSRingQueue class. If the class fails it will
+ * throw an exception, indicating where failure occured.
+ */
+
+#ifndef TEST_ENVIRONMENT_TSRINGQUEUE_HPP_
+#define TEST_ENVIRONMENT_TSRINGQUEUE_HPP_
+
+#include "threading/container/tsringqueue.hpp"
+#include "threading/thread.hpp"
+#include "pointers.hpp"
+#include <vector>
+#include <iterator>
+#include <stdexcept>
+
+// Don't listen to warnings about boost on msvc
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(push, 0)
+#endif
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/test/unit_test.hpp>
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(pop)
+#endif
+
+namespace core {
+BOOST_AUTO_TEST_SUITE(TSRingQueueTests)
+
+typedef core::threading::container::TSRingQueue<int, 256> IntRingQueue;
+using core::threading::Thread;
+
+/* Tests basic functionality */
+BOOST_AUTO_TEST_CASE(tsRingQueueBasicFunctions) {
+    IntRingQueue intQ;
+    BOOST_REQUIRE(intQ.empty());
+    for (int i = 0; i < 256; i++) {
+        BOOST_REQUIRE_MESSAGE(intQ.enqueue(i), "Failed to enqueue " << i);
+    }
+    BOOST_REQUIRE(intQ.full());
+    BOOST_REQUIRE_MESSAGE(!intQ.enqueue(256), "Enqueued into a full queue");
+    BOOST_REQUIRE_EQUAL(intQ.size(), 256U);
+
+    int j = -1;
+    for (int i = 0; i < 256; i++) {
+        BOOST_REQUIRE_MESSAGE(intQ.dequeue(j), "No element dequeued");
+        BOOST_REQUIRE_MESSAGE(i == j,
+                "Failed to return " << i << ", instead returned " << j);
+    }
+    BOOST_REQUIRE(intQ.empty());
+    BOOST_REQUIRE_MESSAGE(!intQ.dequeue(j), "Dequeued from an empty queue");
+}
+
+/* Tests batch functionality */
+BOOST_AUTO_TEST_CASE(tsRingQueueBatchFunctions) {
+    IntRingQueue intQ;
+    std::vector<int> input;
+    for (int i = 0; i < 300; i++) {
+        input.push_back(i);
+    }
+    BOOST_REQUIRE_EQUAL(intQ.enqueueN(input.begin(), input.end()), 256U);
+
+    std::vector<int> output;
+    BOOST_REQUIRE_EQUAL(intQ.dequeueN(std::back_inserter(output), 10), 10U);
+    BOOST_REQUIRE_EQUAL(intQ.dequeueAll(std::back_inserter(output)), 246U);
+    BOOST_REQUIRE_EQUAL(output.size(), 256U);
+    for (int i = 0; i < 256; i++) {
+        BOOST_REQUIRE_EQUAL(output[i], i);
+    }
+    BOOST_REQUIRE(intQ.empty());
+}
+
+BOOST_AUTO_TEST_CASE(tsRingQueueString) {
+    BOOST_TEST_MESSAGE("Testing strings");
+    threading::container::TSRingQueue<std::string, 4> strQ;
+    BOOST_REQUIRE(strQ.enqueue(std::string("test")));
+    BOOST_REQUIRE(strQ.enqueue(std::string("leftover")));
+    std::string deq;
+    BOOST_REQUIRE(strQ.dequeue(deq));
+    BOOST_REQUIRE_EQUAL(deq, "test");
+    // Leftover string is destroyed by the queue destructor
+}
+
+/* An element whose copy throws if asked to */
+struct RingThrowingCopy {
+    int value;
+    bool throwOnCopy;
+    RingThrowingCopy() : value(0), throwOnCopy(false) {}
+    RingThrowingCopy(int init, bool shouldThrow) : value(init), throwOnCopy(shouldThrow) {}
+    RingThrowingCopy(const RingThrowingCopy& other) :
+        value(other.value), throwOnCopy(other.throwOnCopy) {
+        if (throwOnCopy) {
+            throw std::runtime_error("Copy failed");
+        }
+    }
+    RingThrowingCopy& operator =(const RingThrowingCopy& other) {
+        value = other.value;
+        throwOnCopy = other.throwOnCopy;
+        return *this;
+    }
+};
+
+/* Tests that a failed copy doesn't stall the ring */
+BOOST_AUTO_TEST_CASE(tsRingQueueThrowingCopy) {
+    threading::container::TSRingQueue<RingThrowingCopy, 4> throwQ;
+    RingThrowingCopy out;
+    // Lap the ring several times, failing every other enqueue
+    for (int i = 0; i < 20; i++) {
+        BOOST_REQUIRE_THROW(throwQ.enqueue(RingThrowingCopy(-1, true)), std::runtime_error);
+        BOOST_REQUIRE(throwQ.enqueue(RingThrowingCopy(i, false)));
+        BOOST_REQUIRE_MESSAGE(throwQ.dequeue(out), "Ring stalled on a failed copy");
+        BOOST_REQUIRE_EQUAL(out.value, i);
+    }
+    BOOST_REQUIRE(!throwQ.dequeue(out));
+}
+
+/* Concurrency Testing */
+void tsRingQueueEnqueueWorker(pointers::smart<IntRingQueue>::SharedPtr testQInt) {
+    // Do NOT use BOOST_TEST_MESSAGE here, it's not thread safe
+    for (int i = 0; i < 1000; i++) {
+        while (!testQInt->enqueue(i)) {
+            boost::this_thread::yield();
+        }
+    }
+}
+
+void tsRingQueueDequeueWorker(pointers::smart<IntRingQueue>::SharedPtr testQInt) {
+    int i = 0;
+    int deq;
+    while (i < 1000) {
+        // Do NOT use BOOST_TEST_MESSAGE here, it's not thread safe
+        if (testQInt->dequeue(deq)) {
+            i++;
+        } else {
+            boost::this_thread::yield();
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(tsRingQueueConcurrency) {
+    pointers::smart<IntRingQueue>::SharedPtr intQ(new IntRingQueue());
+    boost::posix_time::time_duration wait = boost::posix_time::milliseconds(5000);
+    pointers::lists<Thread>::PtrVector thrds;
+    int numWorkers = 8;
+    for (int i = 0; i < numWorkers; i++) {
+        thrds.push_back(new Thread(boost::bind(&tsRingQueueEnqueueWorker, intQ)));
+        thrds.push_back(new Thread(boost::bind(&tsRingQueueDequeueWorker, intQ)));
+    }
+    for (std::size_t j = 0; j < thrds.size(); j++) {
+        if (!thrds[j].timed_join(wait)) {
+            BOOST_FAIL("Thread timed out");
+        }
+    }
+    BOOST_REQUIRE_MESSAGE(intQ->empty(),
+            "Dequeue did not reduce Queue size during concurrency test");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}
+
+#endif
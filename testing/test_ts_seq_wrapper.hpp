@@ -0,0 +1,129 @@
+/*
+ * Tests the functionality of the sequence locked wrapper. If the class
+ * fails it will throw an exception, indicating where failure occured.
+ */
+
+#ifndef TEST_ENVIRONMENT_TSSEQWRAPPER_HPP_
+#define TEST_ENVIRONMENT_TSSEQWRAPPER_HPP_
+
+#include "threading/container/tsseqwrapper.hpp"
+#include "threading/atomics.hpp"
+#include "threading/thread.hpp"
+#include "pointers.hpp"
+#include <stdexcept>
+
+// Don't listen to warnings about boost on msvc
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(push, 0)
+#endif
+#include <boost/bind.hpp>
+#include <boost/ref.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/test/unit_test.hpp>
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(pop)
+#endif
+
+namespace core {
+BOOST_AUTO_TEST_SUITE(TSSeqWrapperTests)
+
+using core::threading::Thread;
+using namespace core::threading::container;
+
+/* A value which is torn if its fields ever differ */
+struct SeqPair {
+    long first;
+    long second;
+};
+typedef TSSeqWrapper<SeqPair> SeqPairWrapper;
+
+void seqPairIncrement(SeqPair& pair) {
+    pair.first++;
+    pair.second++;
+}
+
+void seqPairThrow(SeqPair&) {
+    throw std::runtime_error("Write failed");
+}
+
+struct SeqPairCopier {
+    SeqPair *out;
+    explicit SeqPairCopier(SeqPair& output) : out(&output) {}
+    void operator()(const SeqPair& pair) const {
+        *out = pair;
+    }
+};
+
+/* Tests basic functionality */
+BOOST_AUTO_TEST_CASE(tsSeqWrapperBasicFunctions) {
+    SeqPair init = { 1, 1 };
+    SeqPairWrapper wrapped(init);
+    BOOST_REQUIRE_EQUAL(wrapped.version(), 0U);
+    BOOST_REQUIRE_EQUAL(wrapped.read().first, 1);
+
+    wrapped.write(&seqPairIncrement);
+    BOOST_REQUIRE_EQUAL(wrapped.version(), 1U);
+    SeqPair copy = { 0, 0 };
+    wrapped.read(SeqPairCopier(copy));
+    BOOST_REQUIRE_EQUAL(copy.first, 2);
+    BOOST_REQUIRE_EQUAL(copy.second, 2);
+
+    SeqPair update = { 7, 7 };
+    wrapped.store(update);
+    BOOST_REQUIRE_EQUAL(wrapped.version(), 2U);
+    BOOST_REQUIRE(wrapped.tryRead(copy));
+    BOOST_REQUIRE_EQUAL(copy.second, 7);
+
+    // A throwing write still ends, so readers don't spin forever
+    BOOST_REQUIRE_THROW(wrapped.write(&seqPairThrow), std::runtime_error);
+    BOOST_REQUIRE_EQUAL(wrapped.version(), 3U);
+    BOOST_REQUIRE(wrapped.tryRead(copy));
+    BOOST_REQUIRE_EQUAL(wrapped.read().first, 7);
+}
+
+/* Concurrency Testing */
+void seqWriteWorker(SeqPairWrapper& wrapped) {
+    // Do NOT use BOOST_TEST_MESSAGE here, it's not thread safe
+    for (int i = 0; i < 10000; i++) {
+        wrapped.write(&seqPairIncrement);
+    }
+}
+
+void seqReadWorker(SeqPairWrapper& wrapped, boost::atomic<bool>& torn) {
+    long last = 0;
+    for (int i = 0; i < 100000; i++) {
+        SeqPair copy = wrapped.read();
+        if (copy.first != copy.second || copy.first < last) {
+            torn = true;
+        }
+        last = copy.first;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(tsSeqWrapperConcurrency) {
+    SeqPairWrapper wrapped;
+    boost::atomic<bool> torn(false);
+    boost::posix_time::time_duration wait = boost::posix_time::milliseconds(10000);
+    pointers::lists<Thread>::PtrVector thrds;
+    int numWriters = 2;
+    for (int i = 0; i < numWriters; i++) {
+        thrds.push_back(new Thread(boost::bind(&seqWriteWorker, boost::ref(wrapped))));
+    }
+    for (int i = 0; i < 4; i++) {
+        thrds.push_back(new Thread(boost::bind(&seqReadWorker,
+                boost::ref(wrapped), boost::ref(torn))));
+    }
+    for (std::size_t j = 0; j < thrds.size(); j++) {
+        if (!thrds[j].timed_join(wait)) {
+            BOOST_FAIL("Thread timed out");
+        }
+    }
+    BOOST_REQUIRE_MESSAGE(!torn, "Reader saw a write in progress");
+    BOOST_REQUIRE_EQUAL(wrapped.read().first, numWriters * 10000);
+    BOOST_REQUIRE_EQUAL(wrapped.version(), (SeqPairWrapper::VersionType)numWriters * 10000);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}
+
+#endif
@@ -0,0 +1,170 @@
+/*
+ * Tests the performance of TSShardedQueue class. If the class fails it will
+ * throw an exception, indicating where failure occured.
+ */
+
+#ifndef TEST_ENVIRONMENT_TSSHARDEDQUEUE_HPP_
+#define TEST_ENVIRONMENT_TSSHARDEDQUEUE_HPP_
+
+#include "threading/container/tsshardedqueue.hpp"
+#include "container/pool_allocators.hpp"
+#include "threading/thread.hpp"
+#include "pointers.hpp"
+#include <vector>
+
+// Don't listen to warnings about boost on msvc
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(push, 0)
+#endif
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/test/unit_test.hpp>
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(pop)
+#endif
+
+namespace core {
+BOOST_AUTO_TEST_SUITE(TSShardedQueueTests)
+
+typedef core::threading::container::TSShardedQueue<int> IntShardedQueue;
+using core::threading::Thread;
+using core::threading::container::ShardOrdering;
+using core::threading::container::PER_PRODUCER_FIFO;
+using core::threading::container::GLOBAL_FIFO;
+
+/* Tests basic functionality */
+BOOST_AUTO_TEST_CASE(tsShardedQueueBasicFunctions) {
+    IntShardedQueue intQ(4);
+    BOOST_REQUIRE_EQUAL(intQ.shardCount(), 4U);
+    BOOST_REQUIRE(intQ.empty());
+    for (int i = 0; i < 100; i++) {
+        intQ.enqueue(i);
+    }
+    BOOST_REQUIRE_EQUAL(intQ.size(), 100U);
+
+    // A single producer always lands on one shard
+    for (int i = 0; i < 50; i++) {
+        IntShardedQueue::PtrType deq(intQ.dequeue());
+        BOOST_REQUIRE_MESSAGE(deq, "No element dequeued");
+        BOOST_REQUIRE_EQUAL(*deq, i);
+    }
+    IntShardedQueue::QListPtr part = intQ.dequeueN(10);
+    BOOST_REQUIRE_EQUAL(part->size(), 10U);
+    BOOST_REQUIRE_EQUAL(part->front(), 50);
+    IntShardedQueue::QListPtr rest = intQ.dequeueAll();
+    BOOST_REQUIRE_EQUAL(rest->size(), 40U);
+    BOOST_REQUIRE_EQUAL(rest->front(), 60);
+    BOOST_REQUIRE(intQ.empty());
+    BOOST_REQUIRE_MESSAGE(!intQ.dequeue(), "Failed to return empty pointer");
+}
+
+/* Global ordering Testing */
+void tsShardedQueueRangeWorker(pointers::smart<IntShardedQueue>::SharedPtr testQInt,
+                               int first, int last) {
+    std::vector<int> batch;
+    for (int i = first; i < last; i++) {
+        if (i % 2 == 0) {
+            testQInt->enqueue(i);
+        } else {
+            batch.push_back(i);
+            testQInt->enqueueN(batch.begin(), batch.end());
+            batch.clear();
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(tsShardedQueueGlobalFifo) {
+    pointers::smart<IntShardedQueue>::SharedPtr intQ(new IntShardedQueue(8, GLOBAL_FIFO));
+    // Producers run one after another so the global order is known
+    for (int worker = 0; worker < 8; worker++) {
+        Thread producer(boost::bind(&tsShardedQueueRangeWorker, intQ, worker * 100, (worker + 1) * 100));
+        producer.join();
+    }
+    IntShardedQueue::PtrType first(intQ->dequeue());
+    BOOST_REQUIRE_MESSAGE(first, "No element dequeued");
+    BOOST_REQUIRE_EQUAL(*first, 0);
+    IntShardedQueue::QListPtr deq = intQ->dequeueAll();
+    BOOST_REQUIRE_EQUAL(deq->size(), 799U);
+    int i = 1;
+    for (IntShardedQueue::QList::iterator iter = deq->begin(); iter != deq->end(); ++iter, ++i) {
+        BOOST_REQUIRE_EQUAL(*iter, i);
+    }
+}
+
+/* Tests partial dequeues which span several shards */
+void tsShardedQueueBlockWorker(pointers::smart<IntShardedQueue>::SharedPtr testQInt, int first) {
+    for (int i = first; i < first + 10; i++) {
+        testQInt->enqueue(i);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(tsShardedQueueDequeueAcrossShards) {
+    ShardOrdering orderings[] = { PER_PRODUCER_FIFO, GLOBAL_FIFO };
+    for (int o = 0; o < 2; o++) {
+        pointers::smart<IntShardedQueue>::SharedPtr intQ(new IntShardedQueue(4, orderings[o]));
+        for (int worker = 0; worker < 8; worker++) {
+            Thread producer(boost::bind(&tsShardedQueueBlockWorker, intQ, worker * 10));
+            producer.join();
+        }
+        for (int i = 0; i < 5; i++) {
+            BOOST_REQUIRE_EQUAL(intQ->dequeueN(15)->size(), 15U);
+        }
+        BOOST_REQUIRE_EQUAL(intQ->dequeueN(15)->size(), 5U);
+        BOOST_REQUIRE(intQ->empty());
+    }
+}
+
+/* Pooled allocation Testing */
+BOOST_AUTO_TEST_CASE(tsShardedQueuePooled) {
+    threading::container::TSShardedQueue<int, ::core::container::PooledCloneAllocator,
+            ::core::container::PooledNodeAllocator> pooledQ(2);
+    for (int i = 0; i < 10; i++) {
+        pooledQ.enqueue(i);
+    }
+    BOOST_REQUIRE_EQUAL(pooledQ.dequeueAll()->size(), 10U);
+}
+
+/* Concurrency Testing */
+void tsShardedQueueEnqueueWorker(pointers::smart<IntShardedQueue>::SharedPtr testQInt, int workerNum) {
+    // Do NOT use BOOST_TEST_MESSAGE here, it's not thread safe
+    for (int i = 0; i < 1000; i++) {
+        testQInt->enqueue(workerNum * 1000 + i);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(tsShardedQueueConcurrency) {
+    pointers::smart<IntShardedQueue>::SharedPtr intQ(new IntShardedQueue());
+    boost::posix_time::time_duration wait = boost::posix_time::milliseconds(5000);
+    pointers::lists<Thread>::PtrVector thrds;
+    int numWorkers = 8;
+    for (int i = 0; i < numWorkers; i++) {
+        thrds.push_back(new Thread(boost::bind(&tsShardedQueueEnqueueWorker, intQ, i)));
+    }
+
+    // Every producer's elements must come out in the order it enqueued them
+    std::vector<int> lastSeen(numWorkers, -1);
+    int received = 0;
+    const boost::system_time deadline = boost::get_system_time() + wait;
+    while (received < numWorkers * 1000 && boost::get_system_time() < deadline) {
+        IntShardedQueue::QListPtr deq = intQ->dequeueAll();
+        for (IntShardedQueue::QList::iterator iter = deq->begin(); iter != deq->end(); ++iter) {
+            int worker = *iter / 1000;
+            BOOST_REQUIRE_MESSAGE(*iter % 1000 > lastSeen[worker],
+                    "Producer " << worker << " order broken at " << *iter);
+            lastSeen[worker] = *iter % 1000;
+            received++;
+        }
+    }
+    for (std::size_t j = 0; j < thrds.size(); j++) {
+        if (!thrds[j].timed_join(wait)) {
+            BOOST_FAIL("Thread timed out");
+        }
+    }
+    BOOST_REQUIRE_EQUAL(received, numWorkers * 1000);
+    BOOST_REQUIRE(intQ->empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}
+
+#endif
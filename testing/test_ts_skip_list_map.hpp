@@ -0,0 +1,161 @@
+/*
+ * Tests the functionality of the thread safe skip list map. If the class
+ * fails it will throw an exception, indicating where failure occured.
+ */
+
+#ifndef TEST_ENVIRONMENT_TSSKIPLISTMAP_HPP_
+#define TEST_ENVIRONMENT_TSSKIPLISTMAP_HPP_
+
+#include "threading/container/tsskiplistmap.hpp"
+#include "threading/atomics.hpp"
+#include "threading/thread.hpp"
+#include "pointers.hpp"
+#include <string>
+#include <vector>
+
+// Don't listen to warnings about boost on msvc
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(push, 0)
+#endif
+#include <boost/bind.hpp>
+#include <boost/ref.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/test/unit_test.hpp>
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(pop)
+#endif
+
+namespace core {
+BOOST_AUTO_TEST_SUITE(TSSkipListMapTests)
+
+using core::threading::Thread;
+using namespace core::threading::container;
+
+typedef TSSkipListMap<long, long> LongSkipMap;
+
+/* Records the keys it is given, and whether they came in order */
+struct KeyCollector {
+    std::vector<long> keys;
+    bool ordered;
+    KeyCollector() : ordered(true) {}
+    void operator()(const LongSkipMap::EntryType& entry) {
+        if (!keys.empty() && keys.back() >= entry.first) {
+            ordered = false;
+        }
+        keys.push_back(entry.first);
+    }
+};
+
+/* Tests basic functionality */
+BOOST_AUTO_TEST_CASE(tsSkipListMapBasicFunctions) {
+    TSSkipListMap<std::string, int> map;
+    BOOST_REQUIRE(map.empty());
+    BOOST_REQUIRE(map.insert("b", 2));
+    BOOST_REQUIRE_MESSAGE(!map.insert("b", 20), "Inserted a key twice");
+    BOOST_REQUIRE(map.insert("a", 1));
+    BOOST_REQUIRE(map.insert("d", 4));
+    BOOST_REQUIRE_EQUAL(map.size(), 3U);
+
+    int value = 0;
+    BOOST_REQUIRE(map.find("b", value));
+    BOOST_REQUIRE_EQUAL(value, 2);
+    BOOST_REQUIRE(!map.find("c", value));
+    BOOST_REQUIRE(map.contains("d"));
+
+    std::pair<std::string, int> entry;
+    BOOST_REQUIRE(map.lowerBound("c", entry));
+    BOOST_REQUIRE_EQUAL(entry.first, "d");
+    BOOST_REQUIRE(!map.lowerBound("e", entry));
+
+    BOOST_REQUIRE(map.erase("b"));
+    BOOST_REQUIRE(!map.erase("b"));
+    BOOST_REQUIRE(!map.contains("b"));
+    BOOST_REQUIRE(map.insert("b", 22));
+    BOOST_REQUIRE(map.find("b", value));
+    BOOST_REQUIRE_EQUAL(value, 22);
+    BOOST_REQUIRE_EQUAL(map.size(), 3U);
+}
+
+/* Tests ordered scans over ranges */
+BOOST_AUTO_TEST_CASE(tsSkipListMapRanges) {
+    LongSkipMap map;
+    // Insert out of order so the list has to sort them
+    for (long i = 0; i < 1000; i++) {
+        BOOST_REQUIRE(map.insert((i * 7919) % 1000, i));
+    }
+    for (long i = 0; i < 1000; i += 2) {
+        BOOST_REQUIRE(map.erase(i));
+    }
+    KeyCollector all = map.forEachEntry(KeyCollector());
+    BOOST_REQUIRE(all.ordered);
+    BOOST_REQUIRE_EQUAL(all.keys.size(), 500U);
+
+    KeyCollector range = map.forEachInRange(100, 200, KeyCollector());
+    BOOST_REQUIRE(range.ordered);
+    BOOST_REQUIRE_EQUAL(range.keys.size(), 50U);
+    BOOST_REQUIRE_EQUAL(range.keys.front(), 101);
+    BOOST_REQUIRE_EQUAL(range.keys.back(), 199);
+    BOOST_REQUIRE(map.forEachInRange(200, 200, KeyCollector()).keys.empty());
+
+    LongSkipMap::EntryType entry;
+    BOOST_REQUIRE(map.lowerBound(500, entry));
+    BOOST_REQUIRE_EQUAL(entry.first, 501);
+}
+
+/* Concurrency Testing */
+void skipListMapWriter(LongSkipMap& map, long first) {
+    // Do NOT use BOOST_TEST_MESSAGE here, it's not thread safe
+    for (long i = first; i < first + 5000; i++) {
+        map.insert(i, i);
+        if (i % 2 == 0) {
+            map.erase(i);
+        }
+    }
+}
+
+void skipListMapScanner(LongSkipMap& map, long numKeys, boost::atomic<bool>& torn) {
+    for (int i = 0; i < 200; i++) {
+        KeyCollector collected = map.forEachInRange(0, numKeys, KeyCollector());
+        if (!collected.ordered) {
+            torn = true;
+        }
+        // Odd keys are never erased, so must keep their values
+        long value = 0;
+        if (map.find(1, value) && value != 1) {
+            torn = true;
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(tsSkipListMapConcurrency) {
+    LongSkipMap map;
+    boost::atomic<bool> torn(false);
+    boost::posix_time::time_duration wait = boost::posix_time::milliseconds(20000);
+    pointers::lists<Thread>::PtrVector thrds;
+    long numWriters = 4;
+    for (long i = 0; i < numWriters; i++) {
+        thrds.push_back(new Thread(boost::bind(&skipListMapWriter, boost::ref(map), i * 5000)));
+    }
+    for (int i = 0; i < 2; i++) {
+        thrds.push_back(new Thread(boost::bind(&skipListMapScanner, boost::ref(map),
+                numWriters * 5000, boost::ref(torn))));
+    }
+    for (std::size_t j = 0; j < thrds.size(); j++) {
+        if (!thrds[j].timed_join(wait)) {
+            BOOST_FAIL("Thread timed out");
+        }
+    }
+    BOOST_REQUIRE_MESSAGE(!torn, "Scan saw entries out of order");
+    BOOST_REQUIRE_EQUAL(map.size(), (std::size_t)(numWriters * 2500));
+    KeyCollector all = map.forEachEntry(KeyCollector());
+    BOOST_REQUIRE(all.ordered);
+    BOOST_REQUIRE_EQUAL(all.keys.size(), (std::size_t)(numWriters * 2500));
+    for (std::size_t i = 0; i < all.keys.size(); i++) {
+        BOOST_REQUIRE_EQUAL(all.keys[i], (long)(i * 2 + 1));
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}
+
+#endif
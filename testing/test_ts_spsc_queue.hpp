@@ -0,0 +1,163 @@
+/*
+ * Tests the performance of TSSpscQueue class. If the class fails it will
+ * throw an exception, indicating where failure occured.
+ */
+
+#ifndef TEST_ENVIRONMENT_TSSPSCQUEUE_HPP_
+#define TEST_ENVIRONMENT_TSSPSCQUEUE_HPP_
+
+#include "threading/container/tsspscqueue.hpp"
+#include "threading/thread.hpp"
+#include "pointers.hpp"
+#include <vector>
+#include <iterator>
+#include <stdexcept>
+
+// Don't listen to warnings about boost on msvc
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(push, 0)
+#endif
+#include <boost/bind.hpp>
+#include <boost/test/unit_test.hpp>
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(pop)
+#endif
+
+namespace core {
+BOOST_AUTO_TEST_SUITE(TSSpscQueueTests)
+
+typedef core::threading::container::TSSpscQueue<int, 64> IntSpscQueue;
+using core::threading::Thread;
+
+/* Tests basic functionality */
+BOOST_AUTO_TEST_CASE(tsSpscQueueBasicFunctions) {
+    IntSpscQueue intQ;
+    BOOST_REQUIRE(intQ.empty());
+    for (int i = 0; i < 64; i++) {
+        BOOST_REQUIRE_MESSAGE(intQ.enqueue(i), "Failed to enqueue " << i);
+    }
+    BOOST_REQUIRE_MESSAGE(!intQ.enqueue(64), "Enqueued into a full queue");
+    BOOST_REQUIRE_EQUAL(intQ.size(), 64U);
+
+    int j = -1;
+    for (int i = 0; i < 64; i++) {
+        BOOST_REQUIRE_MESSAGE(intQ.dequeue(j), "No element dequeued");
+        BOOST_REQUIRE_EQUAL(i, j);
+    }
+    BOOST_REQUIRE(intQ.empty());
+    BOOST_REQUIRE_MESSAGE(!intQ.dequeue(j), "Dequeued from an empty queue");
+}
+
+/* Tests batch functionality, including wrapping around the ring */
+BOOST_AUTO_TEST_CASE(tsSpscQueueBatchFunctions) {
+    IntSpscQueue intQ;
+    std::vector<int> input;
+    for (int i = 0; i < 100; i++) {
+        input.push_back(i);
+    }
+    std::vector<int> output;
+    BOOST_REQUIRE_EQUAL(intQ.enqueueN(input.begin(), input.begin() + 40), 40U);
+    BOOST_REQUIRE_EQUAL(intQ.dequeueN(std::back_inserter(output), 30), 30U);
+    BOOST_REQUIRE_EQUAL(intQ.enqueueN(input.begin() + 40, input.end()), 54U);
+    BOOST_REQUIRE_EQUAL(intQ.dequeueAll(std::back_inserter(output)), 64U);
+    BOOST_REQUIRE_EQUAL(output.size(), 94U);
+    for (int i = 0; i < 94; i++) {
+        BOOST_REQUIRE_EQUAL(output[i], i);
+    }
+    BOOST_REQUIRE(intQ.empty());
+}
+
+/* Counts live SpscThrowingCopy objects to catch leaks and double destroys */
+int& spscLiveCount() {
+    static int live = 0;
+    return live;
+}
+
+/* An element whose copy or assignment throws if asked to */
+struct SpscThrowingCopy {
+    int value;
+    bool throwOnCopy;
+    bool throwOnAssign;
+    SpscThrowingCopy() : value(0), throwOnCopy(false), throwOnAssign(false) {
+        spscLiveCount()++;
+    }
+    SpscThrowingCopy(const SpscThrowingCopy& other) :
+        value(other.value), throwOnCopy(other.throwOnCopy), throwOnAssign(other.throwOnAssign) {
+        if (throwOnCopy) {
+            throw std::runtime_error("Copy failed");
+        }
+        spscLiveCount()++;
+    }
+    ~SpscThrowingCopy() {
+        spscLiveCount()--;
+    }
+    SpscThrowingCopy& operator =(const SpscThrowingCopy& other) {
+        if (other.throwOnAssign) {
+            throw std::runtime_error("Assign failed");
+        }
+        value = other.value;
+        throwOnCopy = other.throwOnCopy;
+        throwOnAssign = other.throwOnAssign;
+        return *this;
+    }
+};
+
+/* Tests that failed batch copies neither leak nor double destroy */
+BOOST_AUTO_TEST_CASE(tsSpscQueueThrowingCopy) {
+    SpscThrowingCopy input[4];
+    SpscThrowingCopy output[4];
+    int baseline = spscLiveCount();
+    {
+        threading::container::TSSpscQueue<SpscThrowingCopy, 8> throwQ;
+        for (int i = 0; i < 4; i++) {
+            input[i].value = i;
+        }
+        input[2].throwOnCopy = true;
+        BOOST_REQUIRE_THROW(throwQ.enqueueN(input, input + 4), std::runtime_error);
+        BOOST_REQUIRE_MESSAGE(throwQ.empty(), "Published a failed batch");
+        BOOST_REQUIRE_EQUAL(spscLiveCount(), baseline);
+
+        input[2].throwOnCopy = false;
+        input[2].throwOnAssign = true;
+        BOOST_REQUIRE_EQUAL(throwQ.enqueueN(input, input + 4), 4U);
+        BOOST_REQUIRE_THROW(throwQ.dequeueN(output, 4), std::runtime_error);
+        BOOST_REQUIRE_EQUAL(output[0].value, 0);
+        BOOST_REQUIRE_EQUAL(output[1].value, 1);
+        BOOST_REQUIRE_EQUAL(throwQ.size(), 2U);
+        BOOST_REQUIRE_EQUAL(spscLiveCount(), baseline + 2);
+        // The rest are destroyed once each by the queue destructor
+    }
+    BOOST_REQUIRE_EQUAL(spscLiveCount(), baseline);
+}
+
+/* Concurrency Testing */
+void tsSpscQueueProducer(pointers::smart<IntSpscQueue>::SharedPtr testQInt, int numEnqueue) {
+    // Do NOT use BOOST_TEST_MESSAGE here, it's not thread safe
+    for (int i = 0; i < numEnqueue; i++) {
+        while (!testQInt->enqueue(i)) {
+            boost::this_thread::yield();
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(tsSpscQueueConcurrency) {
+    pointers::smart<IntSpscQueue>::SharedPtr intQ(new IntSpscQueue());
+    const int numEnqueue = 100000;
+    Thread producer(boost::bind(&tsSpscQueueProducer, intQ, numEnqueue));
+    std::vector<int> output;
+    while ((int)output.size() < numEnqueue) {
+        if (intQ->dequeueAll(std::back_inserter(output)) == 0) {
+            boost::this_thread::yield();
+        }
+    }
+    producer.join();
+    for (int i = 0; i < numEnqueue; i++) {
+        BOOST_REQUIRE_EQUAL(output[i], i);
+    }
+    BOOST_REQUIRE(intQ->empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}
+
+#endif
@@ -0,0 +1,195 @@
+/*
+ * Tests the functionality of the statically locked wrapper classes and
+ * the scoped locked references. If the class fails it will throw an
+ * exception, indicating where failure occured.
+ */
+
+#ifndef TEST_ENVIRONMENT_TSSTATICWRAPPER_HPP_
+#define TEST_ENVIRONMENT_TSSTATICWRAPPER_HPP_
+
+#include "threading/container/tswrapper.hpp"
+#include "threading/resource_locker.hpp"
+#include "threading/spin_lock.hpp"
+#include "threading/thread.hpp"
+#include "pointers.hpp"
+#include <vector>
+
+// Don't listen to warnings about boost on msvc
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(push, 0)
+#endif
+#include <boost/bind.hpp>
+#include <boost/ref.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/test/unit_test.hpp>
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(pop)
+#endif
+
+namespace core {
+BOOST_AUTO_TEST_SUITE(TSStaticWrapperTests)
+
+using core::threading::Thread;
+using core::threading::ResourceLocker;
+using namespace core::threading::container;
+
+typedef TSStaticWrapper<std::vector<int> > StaticVector;
+typedef TSStaticWrapper<std::vector<int>, threading::SpinMutex> SpinStaticVector;
+typedef TSStaticReadWriteWrapper<std::vector<int> > StaticRWVector;
+typedef TSStaticReadWriteWrapper<std::vector<int>, threading::SharedSpinMutex> SpinStaticRWVector;
+
+/* Tests basic functionality */
+BOOST_AUTO_TEST_CASE(tsStaticWrapperBasicFunctions) {
+    StaticVector wrapped;
+    {
+        StaticVector::LockedWrapper locked(wrapped);
+        locked->push_back(1);
+        BOOST_REQUIRE_MESSAGE(!wrapped.getMutex().try_lock(), "Locked a held wrapper");
+    }
+    BOOST_REQUIRE(wrapped.getMutex().try_lock());
+    wrapped.getMutex().unlock();
+
+    SpinStaticRWVector rwWrapped;
+    {
+        SpinStaticRWVector::LockedWrapper locked(rwWrapped);
+        locked->push_back(2);
+    }
+    {
+        SpinStaticRWVector::ReadLockedWrapper first(rwWrapped);
+        SpinStaticRWVector::ReadLockedWrapper second(rwWrapped);
+        BOOST_REQUIRE_EQUAL(first->front(), 2);
+        BOOST_REQUIRE_EQUAL((*second).size(), 1U);
+        BOOST_REQUIRE_MESSAGE(!rwWrapped.getMutex().try_lock(), "Write locked a read held wrapper");
+    }
+}
+
+/* Tests that the Lockable adapters lock the wrapper mutex */
+BOOST_AUTO_TEST_CASE(tsStaticWrapperResourceLocker) {
+    StaticVector wrapped;
+    StaticRWVector rwWrapped;
+
+    ResourceLocker locker;
+    locker.addLockable(wrapped.getLockablePtr());
+    locker.addLockable(rwWrapped.getLockablePtr(), true);
+    BOOST_REQUIRE(rwWrapped.getLockablePtr()->isReadLockable());
+
+    locker.lock();
+    BOOST_REQUIRE(locker.allLocked());
+    BOOST_REQUIRE_MESSAGE(!wrapped.getMutex().try_lock(), "Adapter did not lock the wrapper");
+    BOOST_REQUIRE_MESSAGE(!rwWrapped.getMutex().try_lock(), "Adapter did not read lock the wrapper");
+    BOOST_REQUIRE(rwWrapped.getMutex().try_lock_shared());
+    rwWrapped.getMutex().unlock_shared();
+    locker.unlock();
+
+    BOOST_REQUIRE(locker.noneLocked());
+    BOOST_REQUIRE(wrapped.getMutex().try_lock());
+    wrapped.getMutex().unlock();
+}
+
+/* Concurrency Testing */
+template<typename Wrapper>
+void staticWrapperIncrementWorker(Wrapper& wrapped) {
+    // Do NOT use BOOST_TEST_MESSAGE here, it's not thread safe
+    for (int i = 0; i < 10000; i++) {
+        typename Wrapper::LockedWrapper locked(wrapped);
+        (*locked)[0]++;
+    }
+}
+
+template<typename Wrapper>
+void testStaticWrapperConcurrency() {
+    Wrapper wrapped(std::vector<int>(1, 0));
+    boost::posix_time::time_duration wait = boost::posix_time::milliseconds(10000);
+    pointers::lists<Thread>::PtrVector thrds;
+    int numWorkers = 8;
+    for (int i = 0; i < numWorkers; i++) {
+        thrds.push_back(new Thread(boost::bind(&staticWrapperIncrementWorker<Wrapper>,
+                boost::ref(wrapped))));
+    }
+    for (std::size_t j = 0; j < thrds.size(); j++) {
+        if (!thrds[j].timed_join(wait)) {
+            BOOST_FAIL("Thread timed out");
+        }
+    }
+    BOOST_REQUIRE_EQUAL(typename Wrapper::LockedWrapper(wrapped)->front(), numWorkers * 10000);
+}
+
+BOOST_AUTO_TEST_CASE(tsStaticWrapperConcurrency) {
+    testStaticWrapperConcurrency<StaticVector>();
+    testStaticWrapperConcurrency<SpinStaticVector>();
+    testStaticWrapperConcurrency<StaticRWVector>();
+    testStaticWrapperConcurrency<SpinStaticRWVector>();
+}
+
+void staticWrapperNotifyWorker(SpinStaticVector& wrapped) {
+    boost::this_thread::sleep(boost::posix_time::milliseconds(20));
+    SpinStaticVector::LockedWrapper locked(wrapped);
+    locked->push_back(1);
+    wrapped.getCondition().notify_all();
+}
+
+BOOST_AUTO_TEST_CASE(tsStaticWrapperCondition) {
+    SpinStaticVector wrapped;
+    {
+        SpinStaticVector::LockedWrapper locked(wrapped);
+        boost::system_time deadline = boost::get_system_time() + boost::posix_time::milliseconds(5);
+        // Returns with the lock held again, whether or not it timed out
+        locked.timedWait(deadline);
+        BOOST_REQUIRE(locked->empty());
+    }
+    Thread notifier(boost::bind(&staticWrapperNotifyWorker, boost::ref(wrapped)));
+    {
+        SpinStaticVector::LockedWrapper locked(wrapped);
+        while (locked->empty()) {
+            locked.wait();
+        }
+        BOOST_REQUIRE_EQUAL(locked->front(), 1);
+    }
+    notifier.join();
+}
+
+/* Tests the stack resident locked references of the Lockable wrappers */
+typedef TSWrapper<std::vector<int> > LockableVector;
+typedef TSReadWriteWrapper<std::vector<int> > ReadWriteLockableVector;
+
+LockableVector::ScopedLockedWrapper lockAndPush(LockableVector& wrapped, int value) {
+    LockableVector::ScopedLockedWrapper locked(wrapped.generateScopedLockedReference());
+    locked->push_back(value);
+    return boost::move(locked);
+}
+
+BOOST_AUTO_TEST_CASE(tsWrapperScopedLockedReference) {
+    LockableVector wrapped;
+    {
+        LockableVector::ScopedLockedWrapper locked(lockAndPush(wrapped, 1));
+        BOOST_REQUIRE(locked.ownsLock());
+        BOOST_REQUIRE_EQUAL(locked->front(), 1);
+        BOOST_REQUIRE_MESSAGE(!wrapped.tryLock(), "Locked a held wrapper");
+
+        LockableVector::ScopedLockedWrapper moved(boost::move(locked));
+        BOOST_REQUIRE(!locked.ownsLock());
+        BOOST_REQUIRE(moved.ownsLock());
+        BOOST_REQUIRE_EQUAL(&*moved, &*locked);
+        BOOST_REQUIRE_EQUAL(&moved.getCondition(), &wrapped.getCondition());
+        BOOST_REQUIRE_MESSAGE(!wrapped.tryLock(), "Move released the lock");
+    }
+    BOOST_REQUIRE_MESSAGE(wrapped.tryLock(), "Scoped reference did not unlock");
+    wrapped.unlock();
+
+    ReadWriteLockableVector rwWrapped;
+    rwWrapped.generateScopedLockedReference()->push_back(2);
+    {
+        ReadWriteLockableVector::ScopedReadLockedWrapper first(rwWrapped.generateScopedReadLockedReference());
+        ReadWriteLockableVector::ScopedReadLockedWrapper second(rwWrapped.generateScopedReadLockedReference());
+        BOOST_REQUIRE_EQUAL(first->front(), 2);
+        BOOST_REQUIRE_EQUAL((*second).size(), 1U);
+        BOOST_REQUIRE_MESSAGE(!rwWrapped.tryLock(), "Write locked a read held wrapper");
+    }
+    BOOST_REQUIRE(rwWrapped.tryLock());
+    rwWrapped.unlock();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}
+
+#endif
@@ -0,0 +1,145 @@
+/*
+ * Tests the functionality of the thread safe vector. If the class fails
+ * it will throw an exception, indicating where failure occured.
+ */
+
+#ifndef TEST_ENVIRONMENT_TSVECTOR_HPP_
+#define TEST_ENVIRONMENT_TSVECTOR_HPP_
+
+#include "threading/container/tsvector.hpp"
+#include "threading/atomics.hpp"
+#include "threading/thread.hpp"
+#include "pointers.hpp"
+#include <vector>
+#include <stdexcept>
+
+// Don't listen to warnings about boost on msvc
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(push, 0)
+#endif
+#include <boost/bind.hpp>
+#include <boost/ref.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/test/unit_test.hpp>
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#   pragma warning(pop)
+#endif
+
+namespace core {
+BOOST_AUTO_TEST_SUITE(TSVectorTests)
+
+using core::threading::Thread;
+using namespace core::threading::container;
+
+struct VectorSum {
+    long total;
+    VectorSum() : total(0) {}
+    void operator()(const long& value) {
+        total += value;
+    }
+};
+
+struct AtomicVectorSum {
+    boost::atomic<long> *total;
+    explicit AtomicVectorSum(boost::atomic<long>& sum) : total(&sum) {}
+    void operator()(const long& value) const {
+        total->fetch_add(value, boost::memory_order_relaxed);
+    }
+};
+
+void vectorDouble(long& value) {
+    value *= 2;
+}
+
+void vectorThrowOnFive(const long& value) {
+    if (value == 5) {
+        throw std::runtime_error("Found five");
+    }
+}
+
+/* Tests basic functionality */
+BOOST_AUTO_TEST_CASE(tsVectorBulkFunctions) {
+    TSVector<long> vect;
+    for (long i = 1; i <= 1000; i++) {
+        vect.push_back(i);
+    }
+    BOOST_REQUIRE_EQUAL(vect.size(), 1000U);
+    BOOST_REQUIRE_EQUAL(vect.forEachShared(VectorSum()).total, 500500);
+
+    std::vector<long> buffer(1, 0);
+    buffer.reserve(2000);
+    const long *storage = &buffer[0];
+    vect.snapshot(buffer);
+    BOOST_REQUIRE_EQUAL(buffer.size(), 1000U);
+    BOOST_REQUIRE_EQUAL(buffer[999], 1000);
+    BOOST_REQUIRE_MESSAGE(&buffer[0] == storage, "Snapshot reallocated the buffer");
+
+    vect.transformInPlace(&vectorDouble);
+    BOOST_REQUIRE_EQUAL(vect.forEachShared(VectorSum()).total, 1001000);
+
+    vect.transformInPlaceParallel(&vectorDouble, 4);
+    boost::atomic<long> total(0);
+    vect.forEachSharedParallel(AtomicVectorSum(total), 3);
+    BOOST_REQUIRE_EQUAL(total.load(), 2002000);
+
+    // More threads than elements falls back to fewer threads
+    TSVector<long> small;
+    small.push_back(5);
+    small.transformInPlaceParallel(&vectorDouble, 8);
+    total.store(0);
+    small.forEachSharedParallel(AtomicVectorSum(total));
+    BOOST_REQUIRE_EQUAL(total.load(), 10);
+
+    // Worker exceptions reach the caller, and the vector stays usable
+    TSVector<long> numbers;
+    for (long i = 0; i < 100; i++) {
+        numbers.push_back(i);
+    }
+    BOOST_REQUIRE_THROW(numbers.forEachSharedParallel(&vectorThrowOnFive, 4), std::runtime_error);
+    BOOST_REQUIRE_THROW(numbers.transformInPlaceParallel(&vectorThrowOnFive, 4), std::runtime_error);
+    numbers.transformInPlaceParallel(&vectorDouble, 4);
+    BOOST_REQUIRE_EQUAL(numbers.forEachShared(VectorSum()).total, 9900);
+}
+
+/* Concurrency Testing */
+void tsVectorWriter(TSVector<long>& vect) {
+    // Do NOT use BOOST_TEST_MESSAGE here, it's not thread safe
+    for (int i = 0; i < 5000; i++) {
+        vect.push_back(1);
+    }
+}
+
+void tsVectorReader(TSVector<long>& vect, boost::atomic<bool>& torn) {
+    std::vector<long> buffer;
+    for (int i = 0; i < 200; i++) {
+        std::size_t sum = vect.forEachShared(VectorSum()).total;
+        vect.snapshot(buffer);
+        if (buffer.size() < sum) {
+            torn = true;
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(tsVectorBulkConcurrency) {
+    TSVector<long> vect;
+    boost::atomic<bool> torn(false);
+    boost::posix_time::time_duration wait = boost::posix_time::milliseconds(20000);
+    pointers::lists<Thread>::PtrVector thrds;
+    for (int i = 0; i < 2; i++) {
+        thrds.push_back(new Thread(boost::bind(&tsVectorWriter, boost::ref(vect))));
+        thrds.push_back(new Thread(boost::bind(&tsVectorReader,
+                boost::ref(vect), boost::ref(torn))));
+    }
+    for (std::size_t j = 0; j < thrds.size(); j++) {
+        if (!thrds[j].timed_join(wait)) {
+            BOOST_FAIL("Thread timed out");
+        }
+    }
+    BOOST_REQUIRE_MESSAGE(!torn, "Snapshot lost elements");
+    BOOST_REQUIRE_EQUAL(vect.forEachShared(VectorSum()).total, 10000);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}
+
+#endif